@@ -0,0 +1,151 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#include <stdio.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <comma/base/exception.h>
+#include <comma/base/time.h>
+
+namespace comma {
+
+namespace impl {
+
+static const boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+
+// days since epoch for a proleptic gregorian date (see http://howardhinnant.github.io/date_algorithms.html)
+static comma::int64 days_from_civil( comma::int64 y, unsigned int m, unsigned int d )
+{
+    y -= m <= 2;
+    const comma::int64 era = ( y >= 0 ? y : y - 399 ) / 400;
+    const unsigned int yoe = static_cast< unsigned int >( y - era * 400 );
+    const unsigned int doy = ( 153 * ( m > 2 ? m - 3 : m + 9 ) + 2 ) / 5 + d - 1;
+    const unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast< comma::int64 >( doe ) - 719468;
+}
+
+static void civil_from_days( comma::int64 z, comma::int64& y, unsigned int& m, unsigned int& d )
+{
+    z += 719468;
+    const comma::int64 era = ( z >= 0 ? z : z - 146096 ) / 146097;
+    const unsigned int doe = static_cast< unsigned int >( z - era * 146097 );
+    const unsigned int yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+    const unsigned int doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+    const unsigned int mp = ( 5 * doy + 2 ) / 153;
+    d = doy - ( 153 * mp + 2 ) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast< comma::int64 >( yoe ) + era * 400 + ( m <= 2 );
+}
+
+static bool digits( const std::string& s, std::size_t begin, std::size_t end, unsigned int& value )
+{
+    value = 0;
+    for( std::size_t i = begin; i < end; ++i )
+    {
+        if( s[i] < '0' || s[i] > '9' ) { return false; }
+        value = value * 10 + ( s[i] - '0' );
+    }
+    return true;
+}
+
+static unsigned int days_in_month( unsigned int year, unsigned int month )
+{
+    static const unsigned int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = year % 4 == 0 && ( year % 100 != 0 || year % 400 == 0 );
+    return month == 2 && leap ? 29 : days[ month - 1 ];
+}
+
+static comma::int64 floor_div( comma::int64 a, comma::int64 b ) { return a / b - ( a % b < 0 ); }
+
+} // namespace impl {
+
+time::time( comma::int64 microseconds, comma::uint32 nanoseconds )
+    : microseconds_( microseconds )
+    , nanoseconds_( nanoseconds )
+{
+    if( nanoseconds_ >= 1000 ) { COMMA_THROW( comma::exception, "expected nanoseconds within microsecond, got " << nanoseconds ); }
+}
+
+time::time( const boost::posix_time::ptime& t )
+    : microseconds_( not_a_date_time_() )
+    , nanoseconds_( 0 )
+{
+    if( t.is_not_a_date_time() ) { return; }
+    if( t.is_special() ) { COMMA_THROW( comma::exception, "expected time, got " << boost::posix_time::to_simple_string( t ) ); }
+    microseconds_ = ( t - impl::epoch ).total_microseconds();
+}
+
+time time::from_seconds( comma::int64 seconds, comma::uint32 nanoseconds )
+{
+    if( nanoseconds >= 1000000000 ) { COMMA_THROW( comma::exception, "expected nanoseconds within second, got " << nanoseconds ); }
+    return time( seconds * 1000000 + nanoseconds / 1000, nanoseconds % 1000 );
+}
+
+comma::int64 time::seconds() const { return impl::floor_div( microseconds_, 1000000 ); }
+
+time time::from_iso_string( const std::string& s )
+{
+    if( s == "not-a-date-time" ) { return time(); }
+    unsigned int year, month, day, hours, minutes, seconds;
+    bool ok =    s.length() >= 15
+              && s[8] == 'T'
+              && impl::digits( s, 0, 4, year )
+              && impl::digits( s, 4, 6, month )
+              && impl::digits( s, 6, 8, day )
+              && impl::digits( s, 9, 11, hours )
+              && impl::digits( s, 11, 13, minutes )
+              && impl::digits( s, 13, 15, seconds )
+              && month >= 1 && month <= 12 && day >= 1 && day <= impl::days_in_month( year, month ) && hours < 24 && minutes < 60 && seconds < 60;
+    unsigned int fraction = 0;
+    if( ok && s.length() > 15 )
+    {
+        std::size_t n = s.length() - 16;
+        ok = s[15] == '.' && n > 0 && n <= 9 && impl::digits( s, 16, s.length(), fraction );
+        for( ; ok && n < 9; ++n ) { fraction *= 10; }
+    }
+    if( !ok ) { return time( boost::posix_time::from_iso_string( s ) ); } // unusual formats: let boost deal with them
+    comma::int64 t = impl::days_from_civil( year, month, day ) * 86400 + hours * 3600 + minutes * 60 + seconds;
+    return from_seconds( t, fraction );
+}
+
+std::string time::to_iso_string() const
+{
+    if( is_not_a_date_time() ) { return "not-a-date-time"; }
+    comma::int64 days = impl::floor_div( microseconds_, 86400000000LL );
+    comma::int64 microseconds = microseconds_ - days * 86400000000LL;
+    comma::int64 year;
+    unsigned int month, day;
+    impl::civil_from_days( days, year, month, day );
+    unsigned int seconds = static_cast< unsigned int >( microseconds / 1000000 );
+    unsigned int fraction = static_cast< unsigned int >( microseconds % 1000000 );
+    char buf[64];
+    int n = ::snprintf( buf, sizeof( buf ), "%04lld%02u%02uT%02u%02u%02u", static_cast< long long >( year ), month, day, seconds / 3600, ( seconds / 60 ) % 60, seconds % 60 );
+    if( nanoseconds_ != 0 ) { ::snprintf( buf + n, sizeof( buf ) - n, ".%06u%03u", fraction, nanoseconds_ ); }
+    else if( fraction != 0 ) { ::snprintf( buf + n, sizeof( buf ) - n, ".%06u", fraction ); }
+    return buf;
+}
+
+boost::posix_time::ptime time::to_ptime() const
+{
+    if( is_not_a_date_time() ) { return boost::posix_time::not_a_date_time; }
+    comma::int64 s = seconds(); // boost uses long for seconds, which is a bug for 32-bit, but for the dates we use seconds will never overflow
+    return impl::epoch + boost::posix_time::seconds( static_cast< long >( s ) ) + boost::posix_time::microseconds( static_cast< long >( microseconds_ - s * 1000000 ) );
+}
+
+} // namespace comma {
@@ -0,0 +1,111 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_BASE_TIME_H_
+#define COMMA_BASE_TIME_H_
+
+#include <iostream>
+#include <limits>
+#include <string>
+#include <boost/date_time/posix_time/ptime.hpp>
+#include <comma/base/types.h>
+
+namespace comma {
+
+/// lightweight timestamp: microseconds since epoch as 64-bit integer
+/// and optional nanoseconds within the microsecond
+///
+/// trivially copyable, so that comparison and arithmetic are plain
+/// integer operations; convert to boost::posix_time::ptime only when needed
+class time
+{
+    public:
+        /// default constructor: not a date time
+        time() : microseconds_( not_a_date_time_() ), nanoseconds_( 0 ) {}
+
+        /// constructor from microseconds since epoch and nanoseconds within the microsecond
+        explicit time( comma::int64 microseconds, comma::uint32 nanoseconds = 0 );
+
+        /// constructor from boost time
+        explicit time( const boost::posix_time::ptime& t );
+
+        /// return time from seconds since epoch and nanoseconds within the second
+        static time from_seconds( comma::int64 seconds, comma::uint32 nanoseconds = 0 );
+
+        /// return time from iso string, e.g. "20120101T010203.123456"
+        static time from_iso_string( const std::string& s );
+
+        /// return as iso string, same as boost::posix_time::to_iso_string(),
+        /// except that nanoseconds, if any, are output as 9 fractional digits
+        std::string to_iso_string() const;
+
+        /// return as boost time (nanoseconds get truncated)
+        boost::posix_time::ptime to_ptime() const;
+
+        /// return microseconds since epoch
+        comma::int64 microseconds() const { return microseconds_; }
+
+        /// return nanoseconds within the microsecond
+        comma::uint32 nanoseconds() const { return nanoseconds_; }
+
+        /// return whole seconds since epoch (rounded towards minus infinity)
+        comma::int64 seconds() const;
+
+        /// return true, if not a date time
+        bool is_not_a_date_time() const { return microseconds_ == not_a_date_time_(); }
+
+        /// shift by given number of microseconds
+        const time& operator+=( comma::int64 microseconds ) { microseconds_ += microseconds; return *this; }
+        const time& operator-=( comma::int64 microseconds ) { microseconds_ -= microseconds; return *this; }
+        time operator+( comma::int64 microseconds ) const { time t( *this ); t += microseconds; return t; }
+        time operator-( comma::int64 microseconds ) const { time t( *this ); t -= microseconds; return t; }
+
+        /// return difference in microseconds (nanoseconds ignored)
+        comma::int64 operator-( const time& rhs ) const { return microseconds_ - rhs.microseconds_; }
+
+        /// comparison
+        bool operator==( const time& rhs ) const { return microseconds_ == rhs.microseconds_ && nanoseconds_ == rhs.nanoseconds_; }
+        bool operator!=( const time& rhs ) const { return !operator==( rhs ); }
+        bool operator<( const time& rhs ) const { return microseconds_ < rhs.microseconds_ || ( microseconds_ == rhs.microseconds_ && nanoseconds_ < rhs.nanoseconds_ ); }
+        bool operator>( const time& rhs ) const { return rhs < *this; }
+        bool operator<=( const time& rhs ) const { return !( rhs < *this ); }
+        bool operator>=( const time& rhs ) const { return !( *this < rhs ); }
+
+    private:
+        comma::int64 microseconds_;
+        comma::uint32 nanoseconds_;
+        static comma::int64 not_a_date_time_() { return std::numeric_limits< comma::int64 >::min(); }
+};
+
+/// output as iso string
+inline std::ostream& operator<<( std::ostream& os, const time& t ) { return os << t.to_iso_string(); }
+
+/// input from iso string
+inline std::istream& operator>>( std::istream& is, time& t )
+{
+    std::string s;
+    is >> s;
+    t = time::from_iso_string( s );
+    return is;
+}
+
+} // namespace comma {
+
+#endif /*COMMA_BASE_TIME_H_*/
@@ -46,6 +46,7 @@ static void usage()
     std::cerr << "usage: cat blah.bin | csv-bin-cut <format> --fields=<fields>" << std::endl;
     std::cerr << "    <fields>: field numbers, starting from 1 (to keep" << std::endl;
     std::cerr << "              consistent with the standard cut utility)" << std::endl;
+    std::cerr << "              padding (e.g. \"x[16]\") is not a field and is skipped" << std::endl;
     std::cerr << std::endl;
     std::cerr << csv::format::usage() << std::endl;
     std::cerr << std::endl;
@@ -74,7 +75,7 @@ int main( int ac, char** av )
             offsets[i] = format.offset( boost::lexical_cast< std::size_t >( v[i] ) - 1 );
         }        
         std::vector< char > w( format.size() ); // stupid windows
-        char* buf = &w[0];
+        std::vector< comma::csv::format::element > fields;
         while( std::cin.good() && !std::cin.eof() )
         {
             if( shutdownFlag ) { std::cerr << "csv-bin-cut: interrupted by signal" << std::endl; return -1; }
@@ -82,12 +83,26 @@ int main( int ac, char** av )
             // one record every time, but absolutely don't make this read blocking!
             // see comma::csv::binary_input_stream::read() for reference - if you know
             // how to do it better, please tell everyone!
-            std::cin.read( buf, format.size() );
+            std::cin.read( &w[0], format.size() );
             if( std::cin.gcount() == 0 ) { continue; }
             if( std::cin.gcount() < int( format.size() ) ) { COMMA_THROW( comma::exception, "expected " << format.size() << " bytes, got only " << std::cin.gcount() ); }
-            for( unsigned int i = 0; i < offsets.size(); ++i )
+            if( !format.is_variable_size() )
             {
-                std::cout.write( buf + offsets[i].offset, offsets[i].size );
+                for( unsigned int i = 0; i < offsets.size(); ++i ) { std::cout.write( &w[0] + offsets[i].offset, offsets[i].size ); }
+                continue;
+            }
+            for( std::size_t size = format.size(), s = format.size( &w[0], size ); s > size; size = s, s = format.size( &w[0], size ) ) // read the rest of the record
+            {
+                if( w.size() < s ) { w.resize( s ); }
+                std::cin.read( &w[0] + size, s - size );
+                if( std::cin.gcount() < int( s - size ) ) { COMMA_THROW( comma::exception, "expected " << ( s - size ) << " more bytes, got only " << std::cin.gcount() ); }
+            }
+            format.offsets( &w[0], fields );
+            for( unsigned int i = 0; i < v.size(); ++i ) // variable size strings are output with their length
+            {
+                const comma::csv::format::element& f = fields[ boost::lexical_cast< std::size_t >( v[i] ) - 1 ];
+                std::size_t length = f.type == comma::csv::format::variable_string ? comma::csv::format::size_of( comma::csv::format::variable_string ) : 0;
+                std::cout.write( &w[0] + f.offset - length, f.size + length );
             }
         }
         return 0;
@@ -24,6 +24,9 @@
 #include <io.h>
 #endif
 
+#include <errno.h>
+#include <stdlib.h>
+#include <deque>
 #include <iostream>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
@@ -31,12 +34,23 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/type_traits.hpp>
 #include <boost/unordered_map.hpp>
 #include <comma/application/contact_info.h>
 #include <comma/application/signal_flag.h>
 #include <comma/base/exception.h>
+#include <comma/base/time.h>
 #include <comma/csv/format.h>
+#include <comma/csv/impl/byte_swap.h>
+#include <comma/csv/impl/half.h>
+#include <comma/csv/impl/scaled.h>
 #include <comma/csv/options.h>
+#include <comma/math/hyperloglog.h>
+#include <comma/math/quantile_sketch.h>
+#include <comma/math/space_saving.h>
 #include <comma/string/string.h>
 
 static void usage()
@@ -58,6 +72,22 @@ static void usage()
     std::cerr << "    var: variance" << std::endl;
     std::cerr << "    stddev: standard deviation" << std::endl;
     std::cerr << "    size: number of values" << std::endl;
+    std::cerr << "    for time fields: diameter, radius, iqr and stddev are output in seconds, var in seconds squared, all as d;" << std::endl;
+    std::cerr << "                     sum is not defined" << std::endl;
+    std::cerr << "    for string fields: min, max (lexicographic), size, distinct and top are defined" << std::endl;
+    std::cerr << "    percentile=<p>: value, such that at least fraction p of values are less or equal to it," << std::endl;
+    std::cerr << "                    0 <= p <= 1, e.g. percentile=0.95" << std::endl;
+    std::cerr << "    median: same as percentile=0.5" << std::endl;
+    std::cerr << "    iqr: interquartile range, percentile=0.75 minus percentile=0.25" << std::endl;
+    std::cerr << "    percentiles are computed in bounded memory using a streaming sketch (see --sketch-size)" << std::endl;
+    std::cerr << "    and thus are approximate, unless --exact is given" << std::endl;
+    std::cerr << "    distinct: approximate number of distinct values (hyperloglog), output as ui; see --distinct-precision" << std::endl;
+    std::cerr << "    top=<k>: approximate k most frequent values in descending order of frequency (space-saving)," << std::endl;
+    std::cerr << "             output for each field as k pairs of value and count (ui); count is an upper bound;" << std::endl;
+    std::cerr << "             10*k values are counted, thus any value occurring more often than in 1/(10*k) of records will be output;" << std::endl;
+    std::cerr << "             if there are less than k distinct values, the remaining pairs are zero; e.g. top=3" << std::endl;
+    std::cerr << "    histogram=<bins>: number of values in each of <bins> bins of equal width between min and max," << std::endl;
+    std::cerr << "                      output as <bins> ui per field; approximate, unless --exact is given (see percentiles)" << std::endl;
     std::cerr << std::endl;
     std::cerr << "<options>" << std::endl;
     std::cerr << "    --delimiter,-d <delimiter> : default ','" << std::endl;
@@ -66,8 +96,25 @@ static void usage()
     std::cerr << "                 if 'id' field present, calculate by id" << std::endl;
     std::cerr << "                 if 'block' and 'id' fields present, calculate by id in each block" << std::endl;
     std::cerr << "                 block and id fields will be appended to the output" << std::endl;
+    std::cerr << "                 results for each block are output in the order in which ids first appear in the block" << std::endl;
     std::cerr << "    --format: in ascii mode: format hint string containing the types of the csv data, default: double or time" << std::endl;
+    std::cerr << "              strings need to be given as fixed size strings, e.g. --format=s[16],d" << std::endl;
     std::cerr << "    --binary,-b: in binary mode: format string of the csv data types" << std::endl;
+    std::cerr << "    --exact: compute percentiles exactly; memory usage proportional to the number of values per block and id" << std::endl;
+    std::cerr << "    --threads=<n>: number of threads accumulating values; records are partitioned by id across threads," << std::endl;
+    std::cerr << "                   thus useful only with id field; output is the same as with one thread" << std::endl;
+    std::cerr << "                   default: 1; 0: number of cpu cores" << std::endl;
+    std::cerr << "    --window=<n>: rolling mode: for each record, output statistics of the last <n> records with the same id" << std::endl;
+    std::cerr << "                  followed by id and block, if present; block change resets all windows" << std::endl;
+    std::cerr << "    --span=<seconds>: rolling mode: same as --window, but the window is the records with t field" << std::endl;
+    std::cerr << "                      within the last <seconds>; record timestamp is output after the statistics" << std::endl;
+    std::cerr << "    --step=<n>: in rolling mode, output only every <n>-th record of each id; default: 1" << std::endl;
+    std::cerr << "        in rolling mode, statistics are updated in constant amortised time per record;" << std::endl;
+    std::cerr << "        only numeric fields and operations other than percentiles are supported;" << std::endl;
+    std::cerr << "        all statistics are output as doubles, except size as ui" << std::endl;
+    std::cerr << "    --distinct-precision=<p>: distinct count precision, 4 to 18; memory usage is 2^p bytes per field;" << std::endl;
+    std::cerr << "                              relative error is roughly 1.04/sqrt(2^p); default: 12, i.e. 4096 bytes and 1.6%" << std::endl;
+    std::cerr << "    --sketch-size=<k>: percentile sketch size; rank error is roughly 1.7/k, memory usage roughly 3*k values per field; default: 200" << std::endl;
     std::cerr << comma::csv::format::usage() << std::endl;
     std::cerr << std::endl;
     std::cerr << "examples" << std::endl;
@@ -81,9 +128,10 @@ static void usage()
 class Values
 {
     public:
-        Values( const comma::csv::options& csv, const comma::csv::format& input_format )
+        Values( const comma::csv::options& csv, const comma::csv::format& input_format, bool has_time = false )
             : csv_( csv )
             , input_format_( input_format )
+            , has_time_( has_time )
             , block_( 0 )
             , id_( 0 )
         {
@@ -91,8 +139,9 @@ class Values
             init_format_();
         }
         
-        Values( const comma::csv::options& csv, const std::string& hint )
+        Values( const comma::csv::options& csv, const std::string& hint, bool has_time = false )
             : csv_( csv )
+            , has_time_( has_time )
             , block_( 0 )
             , id_( 0 )
         {
@@ -101,6 +150,7 @@ class Values
             for( unsigned int i = 0; i < v.size(); ++i )
             {
                 if( ( block_index_ && *block_index_ == i ) || ( id_index_ && *id_index_ == i ) ) { input_format_ += "ui"; continue; }
+                if( t_index_ && *t_index_ == i ) { input_format_ += "t"; continue; }
                 try { boost::posix_time::from_iso_string( v[i] ); input_format_ += "t"; }
                 catch( ... ) { input_format_ += "d"; }
             }
@@ -112,26 +162,43 @@ class Values
         {
             for( unsigned int i = 0; i < indices_.size(); ++i )
             {
-                ::memcpy( &buffer_[0] + elements_[i].offset, buf + input_elements_[i].offset, elements_[i].size );
+                const comma::csv::format::element& e = input_elements_[i];
+                if( e.scaled() || e.type == comma::csv::format::half_t ) // decoded to double
+                {
+                    double d = e.scaled() ? comma::csv::impl::scaled_from_bin( swapped_( buf, e ), e ) : comma::csv::impl::half_to_float( comma::csv::format::traits< comma::uint16 >::from_bin( swapped_( buf, e ) ) );
+                    ::memcpy( &buffer_[0] + elements_[i].offset, &d, sizeof( double ) );
+                    continue;
+                }
+                ::memcpy( &buffer_[0] + elements_[i].offset, buf + e.offset, elements_[i].size );
+                if( e.swapped() ) { comma::csv::impl::byte_swap( &buffer_[0] + elements_[i].offset, elements_[i].type ); }
             }
-            if( block_index_ ) { block_ = block_from_bin_( buf + block_element_.offset ); }
-            if( id_index_ ) { id_ = id_from_bin_( buf + id_element_.offset ); }
+            if( block_index_ ) { block_ = block_from_bin_( swapped_( buf, block_element_ ) ); }
+            if( id_index_ ) { id_ = id_from_bin_( swapped_( buf, id_element_ ) ); }
+            if( t_index_ ) { t_ = t_element_.type == comma::csv::format::long_time ? comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::from_bin( swapped_( buf, t_element_ ) ) : comma::csv::format::traits< boost::posix_time::ptime >::from_bin( swapped_( buf, t_element_ ) ); }
         }
         
-        void set( const std::string& line ) // quick and dirty, probably very slow
+        void set( const std::string& line ) // find field boundaries once and parse the selected fields in place, without temporary strings
         {
-            std::vector< std::string > v = comma::split( line, csv_.delimiter );
-            std::vector< std::string > w( indices_.size() );
-            for( unsigned int i = 0; i < indices_.size(); ++i ) { w[i] = v[indices_[i]]; }
-            const std::string& s = format_.csv_to_bin( w );
-            ::memcpy( &buffer_[0], &s[0], buffer_.size() );
-            if( block_index_ ) { block_ = boost::lexical_cast< unsigned int >( v[ *block_index_ ] ); }
-            if( id_index_ ) { id_ = boost::lexical_cast< unsigned int >( v[ *id_index_ ] ); }
+            columns_.clear();
+            const char* begin = line.c_str();
+            const char* end = begin + line.size();
+            for( const char* p = begin; ; ++p )
+            {
+                if( p != end && *p != csv_.delimiter ) { continue; }
+                columns_.push_back( std::make_pair( begin, p ) );
+                if( p == end ) { break; }
+                begin = p + 1;
+            }
+            for( unsigned int i = 0; i < indices_.size(); ++i ) { parse_( column_( indices_[i], line ), elements_[i], &buffer_[0] + elements_[i].offset ); }
+            if( block_index_ ) { block_ = parse_integer_< comma::uint32 >( column_( *block_index_, line ) ); }
+            if( id_index_ ) { id_ = parse_integer_< comma::uint32 >( column_( *id_index_, line ) ); }
+            if( t_index_ ) { const std::pair< const char*, const char* >& c = column_( *t_index_, line ); t_ = comma::time::from_iso_string( std::string( c.first, c.second ) ).to_ptime(); }
         }
         
         const comma::csv::format& format() const { return format_; }
         unsigned int block() const { return block_; }
         unsigned int id() const { return id_; }
+        const boost::posix_time::ptime& time() const { return t_; }
         const char* buffer() const { return &buffer_[0]; }
         
     private:
@@ -144,13 +211,92 @@ class Values
         std::vector< char > buffer_;
         boost::optional< unsigned int > block_index_;
         boost::optional< unsigned int > id_index_;
+        boost::optional< unsigned int > t_index_;
+        bool has_time_;
         comma::csv::format::element block_element_;
         comma::csv::format::element id_element_;
+        comma::csv::format::element t_element_;
         unsigned int block_;
         unsigned int id_;
+        boost::posix_time::ptime t_;
         boost::function< comma::uint32( const char* ) > block_from_bin_;
         boost::function< comma::uint32( const char* ) > id_from_bin_;
         template < typename T > static comma::uint32 from_bin_( const char* buf ) { return comma::csv::format::traits< T >::from_bin( buf ); }
+        char swapped_buffer_[16];
+        std::vector< std::pair< const char*, const char* > > columns_;
+        
+        const std::pair< const char*, const char* >& column_( unsigned int i, const std::string& line ) const
+        {
+            if( i >= columns_.size() ) { COMMA_THROW( comma::exception, "expected at least " << ( i + 1 ) << " fields, got " << columns_.size() << " in line: \"" << line << "\"" ); }
+            return columns_[i];
+        }
+        
+        template < typename T > static T parse_integer_( const std::pair< const char*, const char* >& c )
+        {
+            char* e;
+            T t;
+            errno = 0;
+            if( boost::is_signed< T >::value )
+            {
+                long long v = ::strtoll( c.first, &e, 10 );
+                t = static_cast< T >( v );
+                if( static_cast< long long >( t ) != v ) { e = NULL; }
+            }
+            else
+            {
+                const char* p = c.first;
+                while( p != c.second && ( *p == ' ' || *p == '\t' ) ) { ++p; }
+                unsigned long long v = ::strtoull( c.first, &e, 10 );
+                t = static_cast< T >( v );
+                if( p == c.second || *p == '-' || static_cast< unsigned long long >( t ) != v ) { e = NULL; }
+            }
+            if( e != c.second || c.first == c.second || errno == ERANGE ) { COMMA_THROW( comma::exception, "expected integer, got \"" << std::string( c.first, c.second ) << "\"" ); }
+            return t;
+        }
+        
+        template < typename T > static T parse_floating_point_( const std::pair< const char*, const char* >& c )
+        {
+            char* e;
+            double d = ::strtod( c.first, &e );
+            if( e != c.second || c.first == c.second ) { COMMA_THROW( comma::exception, "expected floating point number, got \"" << std::string( c.first, c.second ) << "\"" ); }
+            return static_cast< T >( d );
+        }
+        
+        static void parse_( const std::pair< const char*, const char* >& c, const comma::csv::format::element& e, char* buf )
+        {
+            switch( e.type )
+            {
+                case comma::csv::format::char_t:
+                    if( c.second - c.first != 1 ) { COMMA_THROW( comma::exception, "expected character, got \"" << std::string( c.first, c.second ) << "\"" ); }
+                    *buf = *c.first;
+                    break;
+                case comma::csv::format::int8: comma::csv::format::traits< char >::to_bin( parse_integer_< char >( c ), buf ); break;
+                case comma::csv::format::uint8: comma::csv::format::traits< unsigned char >::to_bin( parse_integer_< unsigned char >( c ), buf ); break;
+                case comma::csv::format::int16: comma::csv::format::traits< comma::int16 >::to_bin( parse_integer_< comma::int16 >( c ), buf ); break;
+                case comma::csv::format::uint16: comma::csv::format::traits< comma::uint16 >::to_bin( parse_integer_< comma::uint16 >( c ), buf ); break;
+                case comma::csv::format::int32: comma::csv::format::traits< comma::int32 >::to_bin( parse_integer_< comma::int32 >( c ), buf ); break;
+                case comma::csv::format::uint32: comma::csv::format::traits< comma::uint32 >::to_bin( parse_integer_< comma::uint32 >( c ), buf ); break;
+                case comma::csv::format::int64: comma::csv::format::traits< comma::int64 >::to_bin( parse_integer_< comma::int64 >( c ), buf ); break;
+                case comma::csv::format::uint64: comma::csv::format::traits< comma::uint64 >::to_bin( parse_integer_< comma::uint64 >( c ), buf ); break;
+                case comma::csv::format::float_t: comma::csv::format::traits< float >::to_bin( parse_floating_point_< float >( c ), buf ); break;
+                case comma::csv::format::double_t: comma::csv::format::traits< double >::to_bin( parse_floating_point_< double >( c ), buf ); break;
+                case comma::csv::format::time: comma::csv::format::traits< comma::time, comma::csv::format::time >::to_bin( comma::time::from_iso_string( std::string( c.first, c.second ) ), buf ); break;
+                case comma::csv::format::long_time: comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::to_bin( boost::posix_time::from_iso_string( std::string( c.first, c.second ) ), buf ); break;
+                case comma::csv::format::fixed_string:
+                    if( std::size_t( c.second - c.first ) > e.size ) { COMMA_THROW( comma::exception, "expected string not longer than " << e.size << "; got \"" << std::string( c.first, c.second ) << "\"" ); }
+                    ::memset( buf, 0, e.size );
+                    ::memcpy( buf, c.first, c.second - c.first );
+                    break;
+                default: COMMA_THROW( comma::exception, "type " << comma::csv::format::to_format( e.type ) << " not supported" );
+            }
+        }
+        const char* swapped_( const char* buf, const comma::csv::format::element& e )
+        {
+            if( !e.swapped() ) { return buf + e.offset; }
+            ::memcpy( swapped_buffer_, buf + e.offset, e.size );
+            comma::csv::impl::byte_swap( swapped_buffer_, e.type );
+            return swapped_buffer_;
+        }
         
         void init_indices_()
         {
@@ -159,6 +305,7 @@ class Values
             {
                 if( v[i] == "block" ) { block_index_ = i; }
                 else if( v[i] == "id" ) { id_index_ = i; }
+                else if( has_time_ && v[i] == "t" ) { t_index_ = i; }
                 else if( v[i] != "" ) { indices_.push_back( i ); }
             }
         }
@@ -170,12 +317,14 @@ class Values
                 {
                     if( block_index_ && *block_index_ == i ) { continue; }
                     if( id_index_ && *id_index_ == i ) { continue; }
+                    if( t_index_ && *t_index_ == i ) { continue; }
                     indices_.push_back( i );
                 }
             }
             for( unsigned int i = 0; i < indices_.size(); ++i )
             {
-                format_ += comma::csv::format::to_format( input_format_.offset( indices_[i] ).type );
+                const comma::csv::format::element& e = input_format_.offset( indices_[i] );
+                format_ += e.scaled() || e.type == comma::csv::format::half_t ? "d" : comma::csv::format::to_format( e.type, e.size );
             }
             for( unsigned int i = 0; i < indices_.size(); ++i )
             {
@@ -200,6 +349,12 @@ class Values
                     default: COMMA_THROW( comma::exception, "expected integer for block id, got format " << input_format_.string() );
                 }
             }
+            if( has_time_ && !t_index_ ) { COMMA_THROW( comma::exception, "expected t field" ); }
+            if( t_index_ )
+            {
+                t_element_ = input_format_.offset( *t_index_ );
+                if( t_element_.type != comma::csv::format::time && t_element_.type != comma::csv::format::long_time ) { COMMA_THROW( comma::exception, "expected time for t field, got format " << input_format_.string() ); }
+            }
             if( id_index_ )
             {
                 id_element_ = input_format_.offset( *id_index_ );
@@ -223,9 +378,9 @@ class Values
 class asciiInput
 {
     public:
-        asciiInput( const comma::csv::options& csv, const boost::optional< comma::csv::format >& format ) : csv_( csv )
+        asciiInput( const comma::csv::options& csv, const boost::optional< comma::csv::format >& format, bool has_time = false ) : csv_( csv ), has_time_( has_time )
         {
-            if( format ) { values_.reset( new Values( csv, *format ) ); }
+            if( format ) { values_.reset( new Values( csv, *format, has_time ) ); }
         }
         
         const Values* read()
@@ -233,22 +388,23 @@ class asciiInput
             std::string line;
             std::getline( std::cin, line );
             if( line == "" ) { return NULL; }
-            if( !values_ ) { values_.reset( new Values( csv_, line ) ); }
+            if( !values_ ) { values_.reset( new Values( csv_, line, has_time_ ) ); }
             values_->set( line );
             return values_.get();
         }
         
     private:
         comma::csv::options csv_;
+        bool has_time_;
         boost::scoped_ptr< Values > values_;
 };
 
 class binaryInput
 {
     public:
-        binaryInput( const comma::csv::options& csv )
+        binaryInput( const comma::csv::options& csv, bool has_time = false )
             : csv_( csv )
-            , values_( csv, csv.format() )
+            , values_( csv, csv.format(), has_time )
             , buffer_( csv.format().size() > 65536 ? csv.format().size() : 65536 / csv.format().size() * csv.format().size() )
             , cur_( &buffer_[0] )
             , end_( &buffer_[0] + buffer_.size() )
@@ -285,156 +441,127 @@ class binaryInput
 
 namespace Operations
 {
-    struct base
-    {
-        virtual ~base() {}
-        virtual void push( const char* ) = 0;
-        virtual void calculate( char* ) = 0;
-        virtual base* clone() const = 0;
-    };
-
-    template < typename T, comma::csv::format::types_enum F > class Centre;
-    template < typename T, comma::csv::format::types_enum F > class Radius;
-    template < typename T, comma::csv::format::types_enum F > class Diameter;
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Min : public base
-    {
-        public:
-            void push( const char* buf )
-            {
-                const T& t = comma::csv::format::traits< T, F >::from_bin( buf );
-                if( !min_ || t < *min_ ) { min_ = t; }
-            }
-            void calculate( char* buf ) { if( min_ ) { comma::csv::format::traits< T, F >::to_bin( *min_, buf ); } }
-            base* clone() const { return new Min< T, F >( *this ); }
-        private:
-            friend class Centre< T, F >;
-            friend class Diameter< T, F >;
-            friend class Radius< T, F >;
-            boost::optional< T > min_;
-    };
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Max : public base
-    {
-        public:
-            void push( const char* buf )
-            {
-                T t = comma::csv::format::traits< T, F >::from_bin( buf );
-                if( !max_ || t > *max_ ) { max_ = t; }
-            }
-            void calculate( char* buf ) { if( max_ ) { comma::csv::format::traits< T, F >::to_bin( *max_, buf ); } }
-            base* clone() const { return new Max< T, F >( *this ); }
-        private:
-            friend class Centre< T, F >;
-            friend class Diameter< T, F >;
-            friend class Radius< T, F >;
-            boost::optional< T > max_;
-    };
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Sum : public base
-    {
-        public:
-            void push( const char* buf )
-            {
-                T t = comma::csv::format::traits< T, F >::from_bin( buf );
-                sum_ = sum_ ? *sum_ + t : t; 
-            }
-            void calculate( char* buf ) { if( sum_ ) { comma::csv::format::traits< T, F >::to_bin( *sum_, buf ); } }
-            base* clone() const { return new Sum< T, F >( *this ); }
-        private:
-            boost::optional< T > sum_;
-    };
+    struct Enum { enum Values { min, max, centre, mean, sum, size, radius, diameter, variance, stddev, percentile, iqr, distinct, top, histogram }; };
     
-    template < comma::csv::format::types_enum F >
-    class Sum< boost::posix_time::ptime, F > : public base
-    {
-        void push( const char* ) { COMMA_THROW( comma::exception, "sum not defined for time" ); }
-        void calculate( char* ) { COMMA_THROW( comma::exception, "sum not defined for time" ); }
-        base* clone() const { COMMA_THROW( comma::exception, "sum not defined for time" ); }
-    };
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Centre : public base
+    static Enum::Values from_name( const std::string& name )
     {
-        public:
-            void push( const char* buf ) { min_.push( buf ); max_.push( buf ); }
-            void calculate( char* buf ) { if( min_.min_ ) { comma::csv::format::traits< T, F >::to_bin( *min_.min_ + ( *max_.max_ - *min_.min_ ) / 2, buf ); } }
-            base* clone() const { return new Centre< T, F >( *this ); }
-        private:
-            Min< T, F > min_;
-            Max< T, F > max_;
-    };
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Mean : public base
+        if( name == "min" ) { return Enum::min; }
+        else if( name == "max" ) { return Enum::max; }
+        else if( name == "centre" ) { return Enum::centre; }
+        else if( name == "mean" ) { return Enum::mean; }
+        else if( name == "sum" ) { return Enum::sum; }
+        else if( name == "radius" ) { return Enum::radius; }
+        else if( name == "diameter" ) { return Enum::diameter; }
+        else if( name == "var" ) { return Enum::variance; }
+        else if( name == "stddev" ) { return Enum::stddev; }
+        else if( name == "size" ) { return Enum::size; }
+        else if( name == "percentile" || name == "median" ) { return Enum::percentile; }
+        else if( name == "iqr" ) { return Enum::iqr; }
+        else if( name == "distinct" ) { return Enum::distinct; }
+        else if( name == "top" ) { return Enum::top; }
+        else if( name == "histogram" ) { return Enum::histogram; }
+        else { COMMA_THROW( comma::exception, "expected operation name, got " << name ); }
+    }
+    
+    /// operation parameters
+    struct Parameters
     {
-        public:
-            Mean() : count_( 0 ) {}
-            void push( const char* buf )
-            {
-                T t = comma::csv::format::traits< T, F >::from_bin( buf );
-                ++count_;
-                mean_ = mean_ ? *mean_ + ( t - *mean_ ) / count_ : t ;
-            }
-            void calculate( char* buf ) { if( count_ > 0 ) { comma::csv::format::traits< T, F >::to_bin( *mean_, buf ); } }
-            base* clone() const { return new Mean< T, F >( *this ); }
-        private:
-            boost::optional< T > mean_;
-            std::size_t count_;
+        double percentile;
+        std::size_t sketch_size; // 0: exact
+        unsigned int precision; // distinct count precision
+        std::size_t top;
+        std::size_t bins;
+        Parameters() : percentile( 0.5 ), sketch_size( 0 ), precision( 12 ), top( 10 ), bins( 10 ) {}
     };
     
-    template < typename T, comma::csv::format::types_enum F > class Stddev;
+    /// statistics a field accumulator has to keep track of
+    struct Needs { enum Values { min = 1, max = 2, sum = 4, mean = 8, variance = 16, sketch = 32, distinct = 64, top = 128 }; };
     
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Variance : public base // todo: generalise for kth moment
+    static unsigned int needs( Enum::Values operation )
     {
-        public:
-            Variance() : count_( 0 ) {}
-            void push( const char* buf )
-            {
-                T t = comma::csv::format::traits< T, F >::from_bin( buf );
-                ++count_;
-                mean_ = mean_ ? *mean_ + ( t - *mean_ ) / count_ : t;
-                squares_ = squares_ ? *squares_ + ( t * t - *squares_ ) / count_ : t * t;
-            }
-            void calculate( char* buf ) { if( count_ > 0 ) { comma::csv::format::traits< T, F >::to_bin( *squares_ - *mean_ * *mean_, buf ); } }
-            base* clone() const { return new Variance< T, F >( *this ); }
-        private:
-            friend class Stddev< T, F >;
-            boost::optional< T > mean_;
-            boost::optional< T > squares_;
-            std::size_t count_;
-    };
+        switch( operation )
+        {
+            case Enum::min: return Needs::min;
+            case Enum::max: return Needs::max;
+            case Enum::centre: case Enum::radius: case Enum::diameter: return Needs::min | Needs::max;
+            case Enum::sum: return Needs::sum;
+            case Enum::mean: return Needs::mean;
+            case Enum::variance: case Enum::stddev: return Needs::mean | Needs::variance;
+            case Enum::percentile: case Enum::iqr: return Needs::sketch;
+            case Enum::distinct: return Needs::distinct;
+            case Enum::top: return Needs::top;
+            case Enum::histogram: return Needs::min | Needs::max | Needs::sketch;
+            case Enum::size: return 0;
+        }
+        return 0;
+    }
     
-    template < comma::csv::format::types_enum F >
-    class Variance< boost::posix_time::ptime, F > : public base
-    {
-        void push( const char* ) { COMMA_THROW( comma::exception, "variance not implemented for time, todo" ); }
-        void calculate( char* ) { COMMA_THROW( comma::exception, "variance not implemented for time, todo" ); }
-        base* clone() const { COMMA_THROW( comma::exception, "variance not implemented for time, todo" ); }
-    };
+    /// maximum number of values pushed at once
+    enum { batch_size = 128 };
     
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Stddev : public base
+    /// statistics of a single field; all requested operations are derived
+    /// from the same accumulated values, thus each value gets decoded once
+    /// and, e.g., min and max for min,max,centre,radius are computed once
+    ///
+    /// the accumulated values for each id live in state memory owned by the caller,
+    /// so that the state of all ids can be allocated from an arena
+    struct base
     {
-        public:
-            void push( const char* buf ) { variance_.push( buf ); }
-            void calculate( char* buf ) { if( variance_.count_ > 0 ) { comma::csv::format::traits< T, F >::to_bin( static_cast< T >( std::sqrt( static_cast< long double >( *variance_.squares_ - *variance_.mean_ * *variance_.mean_ ) ) ), buf ); } }
-            base* clone() const { return new Stddev< T, F >( *this ); }
-        private:
-            Variance< T, F > variance_;
+        virtual ~base() {}
+        /// size of state in bytes
+        virtual std::size_t size() const = 0;
+        /// construct state in given memory
+        virtual void init( char* state ) const = 0;
+        /// destroy state
+        virtual void destroy( char* state ) const = 0;
+        /// true, if destroy() does nothing and thus can be skipped
+        virtual bool trivial() const = 0;
+        /// push count values, stride bytes apart, count <= batch_size
+        virtual void push( char* state, const char* buf, std::size_t count, std::size_t stride ) const = 0;
+        /// write result of given operation to buf
+        virtual void calculate( const char* state, Enum::Values operation, const Parameters& parameters, char* buf ) const = 0;
     };
     
-    template < comma::csv::format::types_enum F >
-    class Stddev< boost::posix_time::ptime, F > : public base
+    /// reduction kernels over contiguous columns; 4 independent accumulators
+    /// break the dependency chain, so that the loops pipeline and vectorise
+    namespace Kernels
     {
-        void push( const char* ) { COMMA_THROW( comma::exception, "standard deviation not implemented for time, todo" ); }
-        void calculate( char* ) { COMMA_THROW( comma::exception, "standard deviation not implemented for time, todo" ); }
-        base* clone() const { COMMA_THROW( comma::exception, "standard deviation not implemented for time, todo" ); }
-    };
+        template < typename T > static T min( const T* v, std::size_t n )
+        {
+            T m[4] = { v[0], v[0], v[0], v[0] };
+            std::size_t i = 0;
+            for( ; i + 4 <= n; i += 4 ) { for( unsigned int j = 0; j < 4; ++j ) { if( v[ i + j ] < m[j] ) { m[j] = v[ i + j ]; } } }
+            for( ; i < n; ++i ) { if( v[i] < m[0] ) { m[0] = v[i]; } }
+            return std::min( std::min( m[0], m[1] ), std::min( m[2], m[3] ) );
+        }
+        
+        template < typename T > static T max( const T* v, std::size_t n )
+        {
+            T m[4] = { v[0], v[0], v[0], v[0] };
+            std::size_t i = 0;
+            for( ; i + 4 <= n; i += 4 ) { for( unsigned int j = 0; j < 4; ++j ) { if( m[j] < v[ i + j ] ) { m[j] = v[ i + j ]; } } }
+            for( ; i < n; ++i ) { if( m[0] < v[i] ) { m[0] = v[i]; } }
+            return std::max( std::max( m[0], m[1] ), std::max( m[2], m[3] ) );
+        }
+        
+        template < typename T > static T sum( const T* v, std::size_t n )
+        {
+            T s[4] = { 0, 0, 0, 0 };
+            std::size_t i = 0;
+            for( ; i + 4 <= n; i += 4 ) { for( unsigned int j = 0; j < 4; ++j ) { s[j] += v[ i + j ]; } }
+            for( ; i < n; ++i ) { s[0] += v[i]; }
+            return ( s[0] + s[1] ) + ( s[2] + s[3] );
+        }
+        
+        template < typename T > static T sum_of_squares( const T* v, std::size_t n )
+        {
+            T s[4] = { 0, 0, 0, 0 };
+            std::size_t i = 0;
+            for( ; i + 4 <= n; i += 4 ) { for( unsigned int j = 0; j < 4; ++j ) { s[j] += v[ i + j ] * v[ i + j ]; } }
+            for( ; i < n; ++i ) { s[0] += v[i] * v[i]; }
+            return ( s[0] + s[1] ) + ( s[2] + s[3] );
+        }
+    } // namespace Kernels
     
     template < typename T > struct Diff
     { 
@@ -447,204 +574,679 @@ namespace Operations
         typedef double Type;
         static double subtract( boost::posix_time::ptime lhs, boost::posix_time::ptime rhs ) { return double( ( lhs - rhs ).total_microseconds() ) / 1e6; }
     };
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Diameter : public base
+    
+    /// histogram bin edges: for numbers, edges are doubles, since bins may be narrower than integer precision
+    template < typename T > struct Histogram
     {
-        public:
-            void push( const char* buf ) { min_.push( buf ); max_.push( buf ); }
-            void calculate( char* buf ) { if( min_.min_ ) { comma::csv::format::traits< typename Diff< T >::Type >::to_bin( Diff< T >::subtract( *max_.max_, *min_.min_ ), buf ); } }
-            base* clone() const { return new Diameter< T, F >( *this ); }
-        private:
-            Min< T, F > min_;
-            Max< T, F > max_;
+        typedef double Edge;
+        static Edge edge( T min, T max, std::size_t i, std::size_t bins ) { return double( min ) + ( double( max ) - double( min ) ) * i / bins; }
     };
-
+    
+    template <> struct Histogram< boost::posix_time::ptime >
+    {
+        typedef boost::posix_time::ptime Edge;
+        static Edge edge( boost::posix_time::ptime min, boost::posix_time::ptime max, std::size_t i, std::size_t bins ) { return min + boost::posix_time::microseconds( ( max - min ).total_microseconds() / comma::int64( bins ) * comma::int64( i ) ); }
+    };
+    
+    /// arithmetic kinds: floating point values are accumulated in batches,
+    /// integers value by value to keep integer arithmetic as is, time supports only mean
+    struct Kind { enum Values { time, integer, floating_point }; };
+    
+    template < typename T > struct kind : public boost::integral_constant< int, boost::is_floating_point< T >::value ? Kind::floating_point : boost::is_integral< T >::value ? Kind::integer : Kind::time > {};
+    
     template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Radius : public base
+    class Field : public base
     {
         public:
-            void push( const char* buf ) { min_.push( buf ); max_.push( buf ); }
-            void calculate( char* buf ) { if( min_.min_ ) { comma::csv::format::traits< typename Diff< T >::Type >::to_bin( Diff< T >::subtract( *max_.max_, *min_.min_ ) / 2, buf ); } }
-            base* clone() const { return new Radius< T, F >( *this ); }
+            Field( unsigned int needs, const Parameters& parameters ) : needs_( needs ), parameters_( parameters ) { check_( typename kind< T >::type() ); }
+            
+            std::size_t size() const { return sizeof( State ); }
+            
+            void init( char* state ) const
+            {
+                State* s = new ( state ) State;
+                if( needs_ & Needs::sketch ) { s->sketch = new comma::math::quantile_sketch< T >( parameters_.sketch_size ); }
+                if( needs_ & Needs::distinct ) { s->distinct = new comma::math::hyperloglog( parameters_.precision ); }
+                if( needs_ & Needs::top ) { s->top = new comma::math::space_saving< T >( parameters_.top ); }
+            }
+            
+            void destroy( char* state ) const
+            {
+                State* s = reinterpret_cast< State* >( state );
+                delete s->sketch;
+                delete s->distinct;
+                delete s->top;
+                s->~State();
+            }
+            
+            bool trivial() const { return !( needs_ & ( Needs::sketch | Needs::distinct | Needs::top ) ); }
+            
+            void push( char* state, const char* buf, std::size_t count, std::size_t stride ) const
+            {
+                if( count == 0 ) { return; }
+                State& s = *reinterpret_cast< State* >( state );
+                if( needs_ == 0 ) { s.count += count; return; }
+                T v[ batch_size ];
+                const char* p = buf;
+                for( std::size_t i = 0; i < count; ++i, p += stride ) { v[i] = comma::csv::format::traits< T, F >::from_bin( p ); }
+                if( needs_ & Needs::min ) { T min = Kernels::min( v, count ); if( !s.min || min < *s.min ) { s.min = min; } }
+                if( needs_ & Needs::max ) { T max = Kernels::max( v, count ); if( !s.max || *s.max < max ) { s.max = max; } }
+                if( needs_ & Needs::sketch ) { for( std::size_t i = 0; i < count; ++i ) { s.sketch->push( v[i] ); } }
+                if( needs_ & Needs::distinct ) { p = buf; for( std::size_t i = 0; i < count; ++i, p += stride ) { s.distinct->push( comma::math::hyperloglog::hash( p, comma::csv::format::traits< T, F >::size ) ); } }
+                if( needs_ & Needs::top ) { for( std::size_t i = 0; i < count; ++i ) { s.top->push( v[i] ); } }
+                push_( s, v, count, typename kind< T >::type() );
+            }
+            
+            void calculate( const char* state, Enum::Values operation, const Parameters& parameters, char* buf ) const
+            {
+                const State& s = *reinterpret_cast< const State* >( state );
+                if( s.count == 0 && operation != Enum::size ) { return; }
+                switch( operation )
+                {
+                    case Enum::min: comma::csv::format::traits< T, F >::to_bin( *s.min, buf ); break;
+                    case Enum::max: comma::csv::format::traits< T, F >::to_bin( *s.max, buf ); break;
+                    case Enum::centre: comma::csv::format::traits< T, F >::to_bin( *s.min + ( *s.max - *s.min ) / 2, buf ); break;
+                    case Enum::diameter: comma::csv::format::traits< typename Diff< T >::Type >::to_bin( Diff< T >::subtract( *s.max, *s.min ), buf ); break;
+                    case Enum::radius: comma::csv::format::traits< typename Diff< T >::Type >::to_bin( Diff< T >::subtract( *s.max, *s.min ) / 2, buf ); break;
+                    case Enum::mean: comma::csv::format::traits< T, F >::to_bin( *s.mean, buf ); break;
+                    case Enum::size: comma::csv::format::traits< comma::uint32 >::to_bin( s.count, buf ); break;
+                    case Enum::percentile: comma::csv::format::traits< T, F >::to_bin( s.sketch->quantile( parameters.percentile ), buf ); break;
+                    case Enum::iqr: comma::csv::format::traits< typename Diff< T >::Type >::to_bin( Diff< T >::subtract( s.sketch->quantile( 0.75 ), s.sketch->quantile( 0.25 ) ), buf ); break;
+                    case Enum::sum: case Enum::variance: case Enum::stddev: calculate_( s, operation, buf, typename kind< T >::type() ); break;
+                    case Enum::distinct: comma::csv::format::traits< comma::uint32 >::to_bin( s.distinct->estimate(), buf ); break;
+                    case Enum::top:
+                    {
+                        std::vector< typename comma::math::space_saving< T >::entry > top = s.top->top();
+                        for( std::size_t i = 0; i < top.size() && i < parameters.top; ++i, buf += comma::csv::format::traits< T, F >::size + sizeof( comma::uint32 ) )
+                        {
+                            comma::csv::format::traits< T, F >::to_bin( top[i].value, buf );
+                            comma::csv::format::traits< comma::uint32 >::to_bin( top[i].count, buf + comma::csv::format::traits< T, F >::size );
+                        }
+                        break;
+                    }
+                    case Enum::histogram:
+                    {
+                        std::vector< typename Histogram< T >::Edge > edges( parameters.bins - 1 );
+                        for( std::size_t i = 0; i < edges.size(); ++i ) { edges[i] = Histogram< T >::edge( *s.min, *s.max, i + 1, parameters.bins ); }
+                        std::vector< comma::uint64 > ranks = s.sketch->ranks( edges );
+                        ranks.push_back( s.count );
+                        for( std::size_t i = 0; i < ranks.size(); ++i, buf += sizeof( comma::uint32 ) ) { comma::csv::format::traits< comma::uint32 >::to_bin( ranks[i] - ( i == 0 ? 0 : ranks[ i - 1 ] ), buf ); }
+                        break;
+                    }
+                }
+            }
+            
         private:
-            Min< T, F > min_;
-            Max< T, F > max_;
+            typedef boost::integral_constant< int, Kind::time > time_tag;
+            typedef boost::integral_constant< int, Kind::integer > integer_tag;
+            typedef boost::integral_constant< int, Kind::floating_point > floating_point_tag;
+            struct State
+            {
+                std::size_t count;
+                boost::optional< T > min;
+                boost::optional< T > max;
+                boost::optional< T > sum;
+                boost::optional< T > mean;
+                boost::optional< T > squares;
+                comma::math::quantile_sketch< T >* sketch;
+                comma::math::hyperloglog* distinct;
+                comma::math::space_saving< T >* top;
+                boost::optional< T > origin; // time variance: welford's algorithm on seconds since the first value
+                double offset_mean;
+                double m2;
+                State() : count( 0 ), sketch( NULL ), distinct( NULL ), top( NULL ), offset_mean( 0 ), m2( 0 ) {}
+            };
+            unsigned int needs_;
+            Parameters parameters_;
+            
+            void check_( time_tag ) const
+            {
+                if( needs_ & Needs::sum ) { COMMA_THROW( comma::exception, "sum not defined for time" ); }
+            }
+            template < typename Tag > void check_( Tag ) const {}
+            
+            void push_( State& s, const T* v, std::size_t count, time_tag ) const
+            {
+                if( !( needs_ & Needs::mean ) ) { s.count += count; return; }
+                for( std::size_t i = 0; i < count; ++i )
+                {
+                    ++s.count;
+                    s.mean = s.mean ? *s.mean + ( v[i] - *s.mean ) / s.count : v[i];
+                    if( !( needs_ & Needs::variance ) ) { continue; }
+                    if( !s.origin ) { s.origin = v[i]; }
+                    double d = double( ( v[i] - *s.origin ).total_microseconds() ) / 1e6;
+                    double delta = d - s.offset_mean;
+                    s.offset_mean += delta / s.count;
+                    s.m2 += delta * ( d - s.offset_mean );
+                }
+            }
+            
+            void push_( State& s, const T* v, std::size_t count, integer_tag ) const
+            {
+                if( needs_ & Needs::sum ) { T t = Kernels::sum( v, count ); s.sum = s.sum ? *s.sum + t : t; }
+                if( !( needs_ & Needs::mean ) ) { s.count += count; return; }
+                for( std::size_t i = 0; i < count; ++i )
+                {
+                    ++s.count;
+                    s.mean = s.mean ? *s.mean + ( v[i] - *s.mean ) / s.count : v[i];
+                    if( needs_ & Needs::variance ) { s.squares = s.squares ? *s.squares + ( v[i] * v[i] - *s.squares ) / s.count : v[i] * v[i]; }
+                }
+            }
+            
+            void push_( State& s, const T* v, std::size_t count, floating_point_tag ) const
+            {
+                if( needs_ & ( Needs::sum | Needs::mean ) )
+                {
+                    T t = Kernels::sum( v, count );
+                    if( needs_ & Needs::sum ) { s.sum = s.sum ? *s.sum + t : t; }
+                    if( needs_ & Needs::mean ) { T mean = t / count; s.mean = s.mean ? *s.mean + ( mean - *s.mean ) * count / ( s.count + count ) : mean; }
+                    if( needs_ & Needs::variance ) { T squares = Kernels::sum_of_squares( v, count ) / count; s.squares = s.squares ? *s.squares + ( squares - *s.squares ) * count / ( s.count + count ) : squares; }
+                }
+                s.count += count;
+            }
+            
+            void calculate_( const State& s, Enum::Values operation, char* buf, time_tag ) const // variance in seconds squared, standard deviation in seconds
+            {
+                switch( operation )
+                {
+                    case Enum::variance: comma::csv::format::traits< double >::to_bin( s.m2 / s.count, buf ); break;
+                    case Enum::stddev: comma::csv::format::traits< double >::to_bin( std::sqrt( s.m2 / s.count ), buf ); break;
+                    default: break;
+                }
+            }
+            
+            template < typename Tag > void calculate_( const State& s, Enum::Values operation, char* buf, Tag ) const
+            {
+                switch( operation )
+                {
+                    case Enum::sum: comma::csv::format::traits< T, F >::to_bin( *s.sum, buf ); break;
+                    case Enum::variance: comma::csv::format::traits< T, F >::to_bin( *s.squares - *s.mean * *s.mean, buf ); break;
+                    case Enum::stddev: comma::csv::format::traits< T, F >::to_bin( static_cast< T >( std::sqrt( static_cast< long double >( *s.squares - *s.mean * *s.mean ) ) ), buf ); break;
+                    default: break;
+                }
+            }
     };
-
-    template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
-    class Size : public base
+    /// fixed size strings: min and max in lexicographic order, size, distinct and top;
+    /// min and max are kept in the state as zero-padded strings and thus compared by memcmp()
+    class String : public base
     {
         public:
-            Size() : count_( 0 ) {}
-            void push( const char* ) { ++count_; }
-            void calculate( char* buf ) { comma::csv::format::traits< comma::uint32 >::to_bin( count_, buf ); }
-            base* clone() const { return new Size< T, F >( *this ); }
+            String( unsigned int needs, const Parameters& parameters, std::size_t length ) : needs_( needs ), parameters_( parameters ), length_( length )
+            {
+                if( needs_ & ~( Needs::min | Needs::max | Needs::distinct | Needs::top ) ) { COMMA_THROW( comma::exception, "only min, max, size, distinct and top defined for strings" ); }
+            }
+            
+            std::size_t size() const { return sizeof( State ) + 2 * length_; }
+            
+            void init( char* state ) const
+            {
+                State* s = new ( state ) State;
+                if( needs_ & Needs::distinct ) { s->distinct = new comma::math::hyperloglog( parameters_.precision ); }
+                if( needs_ & Needs::top ) { s->top = new comma::math::space_saving< std::string >( parameters_.top ); }
+            }
+            
+            void destroy( char* state ) const
+            {
+                State* s = reinterpret_cast< State* >( state );
+                delete s->distinct;
+                delete s->top;
+                s->~State();
+            }
+            
+            bool trivial() const { return !( needs_ & ( Needs::distinct | Needs::top ) ); }
+            
+            void push( char* state, const char* buf, std::size_t count, std::size_t stride ) const
+            {
+                State& s = *reinterpret_cast< State* >( state );
+                char* min = state + sizeof( State );
+                char* max = min + length_;
+                for( std::size_t i = 0; i < count; ++i, buf += stride, ++s.count )
+                {
+                    if( ( needs_ & Needs::min ) && ( s.count == 0 || ::memcmp( buf, min, length_ ) < 0 ) ) { ::memcpy( min, buf, length_ ); }
+                    if( ( needs_ & Needs::max ) && ( s.count == 0 || ::memcmp( max, buf, length_ ) < 0 ) ) { ::memcpy( max, buf, length_ ); }
+                    if( needs_ & Needs::distinct ) { s.distinct->push( comma::math::hyperloglog::hash( buf, length_ ) ); }
+                    if( needs_ & Needs::top ) { s.top->push( comma::csv::format::traits< std::string, comma::csv::format::fixed_string >::from_bin( buf, length_ ) ); }
+                }
+            }
+            
+            void calculate( const char* state, Enum::Values operation, const Parameters& parameters, char* buf ) const
+            {
+                const State& s = *reinterpret_cast< const State* >( state );
+                if( s.count == 0 && operation != Enum::size ) { return; }
+                switch( operation )
+                {
+                    case Enum::min: ::memcpy( buf, state + sizeof( State ), length_ ); break;
+                    case Enum::max: ::memcpy( buf, state + sizeof( State ) + length_, length_ ); break;
+                    case Enum::size: comma::csv::format::traits< comma::uint32 >::to_bin( s.count, buf ); break;
+                    case Enum::distinct: comma::csv::format::traits< comma::uint32 >::to_bin( s.distinct->estimate(), buf ); break;
+                    case Enum::top:
+                    {
+                        std::vector< comma::math::space_saving< std::string >::entry > top = s.top->top();
+                        for( std::size_t i = 0; i < top.size() && i < parameters.top; ++i, buf += length_ + sizeof( comma::uint32 ) )
+                        {
+                            comma::csv::format::traits< std::string, comma::csv::format::fixed_string >::to_bin( top[i].value, buf, length_ );
+                            comma::csv::format::traits< comma::uint32 >::to_bin( top[i].count, buf + length_ );
+                        }
+                        break;
+                    }
+                    default: break;
+                }
+            }
+            
         private:
-            std::size_t count_;
+            struct State
+            {
+                std::size_t count;
+                comma::math::hyperloglog* distinct;
+                comma::math::space_saving< std::string >* top;
+                State() : count( 0 ), distinct( NULL ), top( NULL ) {}
+            };
+            unsigned int needs_;
+            Parameters parameters_;
+            std::size_t length_;
     };
-    
-    struct Enum { enum Values { min, max, centre, mean, sum, size, radius, diameter, variance, stddev }; };
-    
-    static Enum::Values from_name( const std::string& name )
-    {
-        if( name == "min" ) { return Enum::min; }
-        else if( name == "max" ) { return Enum::max; }
-        else if( name == "centre" ) { return Enum::centre; }
-        else if( name == "mean" ) { return Enum::mean; }
-        else if( name == "sum" ) { return Enum::sum; }
-        else if( name == "radius" ) { return Enum::radius; }
-        else if( name == "diameter" ) { return Enum::diameter; }
-        else if( name == "var" ) { return Enum::variance; }
-        else if( name == "stddev" ) { return Enum::stddev; }
-        else if( name == "size" ) { return Enum::size; }
-        else { COMMA_THROW( comma::exception, "expected operation name, got " << name ); }
-    }
-    
-    template < Enum::Values E > struct traits {};
-    template <> struct traits< Enum::min > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Min< T, F > Type; }; };
-    template <> struct traits< Enum::max > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Max< T, F > Type; }; };
-    template <> struct traits< Enum::centre > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Centre< T, F > Type; }; };
-    template <> struct traits< Enum::mean > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Mean< T, F > Type; }; };
-    template <> struct traits< Enum::sum > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Sum< T, F > Type; }; };
-    template <> struct traits< Enum::size > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Size< T, F > Type; }; };
-    template <> struct traits< Enum::radius > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Radius< T, F > Type; }; };
-    template <> struct traits< Enum::diameter > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Diameter< T, F > Type; }; };
-    template <> struct traits< Enum::variance > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Variance< T, F > Type; }; };
-    template <> struct traits< Enum::stddev > { template < typename T, comma::csv::format::types_enum F > struct FromEnum { typedef Stddev< T, F > Type; }; };
 } // namespace Operations
 
-class Operationbase
+/// bump allocator for the per-id state of a block: memory is allocated in large chunks
+/// and released all at once by clear(), which keeps the chunks for the next block
+class Arena
 {
     public:
-        virtual ~Operationbase() {}
-        virtual void push( const char* buf ) = 0;
-        virtual void calculate() = 0;
-        virtual Operationbase* clone() const = 0;
-        const comma::csv::format& output_format() const { return output_format_; }
-        const char* buffer() const { return &buffer_[0]; }
-        
-    protected:
-        boost::ptr_vector< Operations::base > operations_;
-        comma::csv::format input_format_;
-        std::vector< comma::csv::format::element > input_elements_;
-        comma::csv::format output_format_;
-        std::vector< comma::csv::format::element > output_elements_;
-        std::vector< char > buffer_;
+        Arena( std::size_t chunk_size = 1 << 20 ) : chunk_size_( chunk_size ), chunk_( 0 ), offset_( 0 ) {}
         
-        Operationbase* deep_copy_to_( Operationbase* lhs ) const
+        /// allocate size bytes, aligned to 16 bytes
+        char* allocate( std::size_t size )
         {
-            lhs->input_format_ = input_format_;
-            lhs->input_elements_ = input_elements_;
-            lhs->output_format_ = output_format_;
-            lhs->output_elements_ = output_elements_;
-            lhs->buffer_ = buffer_;
-            for( std::size_t i = 0; i < operations_.size(); ++i ) { lhs->operations_.push_back( operations_[i].clone() ); }
-            return lhs;
+            boost::mutex::scoped_lock lock( mutex_ ); // accumulators may allocate in worker threads
+            size = ( size + 15 ) & ~std::size_t( 15 );
+            while( chunk_ < chunks_.size() && padding_( chunks_[ chunk_ ] ) + offset_ + size > chunks_[ chunk_ ].size() ) { ++chunk_; offset_ = 0; }
+            if( chunk_ == chunks_.size() ) { chunks_.push_back( std::vector< char >( std::max( size, chunk_size_ ) + 15 ) ); }
+            std::vector< char >& chunk = chunks_[ chunk_ ];
+            char* p = &chunk[0] + padding_( chunk ) + offset_;
+            offset_ += size;
+            return p;
         }
+        
+        /// release all allocated memory
+        void clear() { chunk_ = 0; offset_ = 0; }
+        
+    private:
+        std::size_t chunk_size_;
+        std::deque< std::vector< char > > chunks_;
+        std::size_t chunk_;
+        std::size_t offset_;
+        boost::mutex mutex_;
+        static std::size_t padding_( const std::vector< char >& chunk ) { return ( 16 - reinterpret_cast< std::size_t >( &chunk[0] ) % 16 ) % 16; } // to align the chunk start
 };
 
-template < Operations::Enum::Values E >
-struct Operation : public Operationbase
+/// requested operations: output format of each operation and per-field accumulators;
+/// the accumulated state of all fields of one id is a single block of memory
+class Plan
 {
-    Operation() {}
-    Operation( const comma::csv::format& format )
-    {
-        input_format_ = format;
-        input_elements_.reserve( input_format_.count() );
-        for( std::size_t i = 0; i < input_format_.count(); ++i ) { input_elements_.push_back( input_format_.offset( i ) ); }
-        operations_.reserve( input_elements_.size() );
-        for( std::size_t i = 0; i < input_elements_.size(); ++i )
+    public:
+        Plan( const std::vector< Operations::Enum::Values >& operations, const std::vector< Operations::Parameters >& parameters, const comma::csv::format& format )
+            : operations_( operations )
+            , parameters_( parameters )
+            , output_formats_( operations.size() )
+            , output_elements_( operations.size() )
+            , buffers_( operations.size() )
+            , state_size_( 0 )
+            , trivial_( true )
         {
-            comma::csv::format::types_enum output_type = input_elements_[i].type;
-            switch( E ) // quick and dirty, implement in operations::traits, just no time
+            unsigned int needs = 0;
+            Operations::Parameters p; // fields keep enough counters for all operations
+            p.top = 0;
+            for( std::size_t i = 0; i < operations_.size(); ++i )
+            {
+                needs |= Operations::needs( operations_[i] );
+                p.sketch_size = parameters_[i].sketch_size;
+                p.precision = parameters_[i].precision;
+                if( operations_[i] == Operations::Enum::top && parameters_[i].top * 10 > p.top ) { p.top = parameters_[i].top * 10; } // spare counters make counts of the top k more accurate
+            }
+            for( std::size_t i = 0; i < format.count(); ++i ) { input_elements_.push_back( format.offset( i ) ); }
+            for( std::size_t i = 0; i < input_elements_.size(); ++i )
+            {
+                switch( input_elements_[i].type )
+                {
+                    case comma::csv::format::char_t: push_back_< char, comma::csv::format::char_t >( needs, p ); break;
+                    case comma::csv::format::int8: push_back_< char, comma::csv::format::int8 >( needs, p ); break;
+                    case comma::csv::format::uint8: push_back_< unsigned char, comma::csv::format::uint8 >( needs, p ); break;
+                    case comma::csv::format::int16: push_back_< comma::int16, comma::csv::format::int16 >( needs, p ); break;
+                    case comma::csv::format::uint16: push_back_< comma::uint16, comma::csv::format::uint16 >( needs, p ); break;
+                    case comma::csv::format::int32: push_back_< comma::int32, comma::csv::format::int32 >( needs, p ); break;
+                    case comma::csv::format::uint32: push_back_< comma::uint32, comma::csv::format::uint32 >( needs, p ); break;
+                    case comma::csv::format::int64: push_back_< comma::int64, comma::csv::format::int64 >( needs, p ); break;
+                    case comma::csv::format::uint64: push_back_< comma::uint64, comma::csv::format::uint64 >( needs, p ); break;
+                    case comma::csv::format::float_t: push_back_< float, comma::csv::format::float_t >( needs, p ); break;
+                    case comma::csv::format::double_t: push_back_< double, comma::csv::format::double_t >( needs, p ); break;
+                    case comma::csv::format::time: push_back_< boost::posix_time::ptime, comma::csv::format::time >( needs, p ); break;
+                    case comma::csv::format::long_time: push_back_< boost::posix_time::ptime, comma::csv::format::long_time >( needs, p ); break;
+                    case comma::csv::format::fixed_string: fields_.push_back( new Operations::String( needs, p, input_elements_[i].size ) ); break;
+                    default: COMMA_THROW( comma::exception, "operations for " << i << "th element in " << format.string() << " not defined" );
+                }
+                state_offsets_.push_back( state_size_ );
+                state_size_ += ( fields_.back().size() + 15 ) & ~std::size_t( 15 );
+                trivial_ = trivial_ && fields_.back().trivial();
+            }
+            for( std::size_t i = 0; i < operations_.size(); ++i )
+            {
+                std::vector< std::size_t > first; // index of first output element of each field
+                for( std::size_t j = 0; j < input_elements_.size(); ++j )
+                {
+                    first.push_back( output_formats_[i].count() );
+                    switch( operations_[i] )
+                    {
+                        case Operations::Enum::top: // value and count for each of k most frequent values
+                            for( std::size_t k = 0; k < parameters_[i].top; ++k ) { output_formats_[i] += comma::csv::format::to_format( input_elements_[j].type, input_elements_[j].size ); output_formats_[i] += "ui"; }
+                            break;
+                        case Operations::Enum::histogram:
+                            for( std::size_t k = 0; k < parameters_[i].bins; ++k ) { output_formats_[i] += "ui"; }
+                            break;
+                        default:
+                            output_formats_[i] += comma::csv::format::to_format( output_type_( operations_[i], input_elements_[j].type ), input_elements_[j].size );
+                    }
+                }
+                for( std::size_t j = 0; j < first.size(); ++j ) { output_elements_[i].push_back( output_formats_[i].offset( first[j] ) ); }
+                buffers_[i].resize( output_formats_[i].size() );
+            }
+        }
+        
+        /// size of accumulated state of one id in bytes
+        std::size_t state_size() const { return state_size_; }
+        
+        /// true, if state needs no destruction
+        bool trivial() const { return trivial_; }
+        
+        void init( char* state ) const { for( std::size_t i = 0; i < fields_.size(); ++i ) { fields_[i].init( state + state_offsets_[i] ); } }
+        
+        void destroy( char* state ) const { for( std::size_t i = 0; i < fields_.size(); ++i ) { fields_[i].destroy( state + state_offsets_[i] ); } }
+        
+        /// accumulate count records, record_size bytes apart
+        void push( char* state, const char* records, std::size_t count, std::size_t record_size ) const
+        {
+            for( std::size_t i = 0; i < fields_.size(); ++i ) { fields_[i].push( state + state_offsets_[i], records + input_elements_[i].offset, count, record_size ); }
+        }
+        
+        std::size_t size() const { return operations_.size(); }
+        
+        const comma::csv::format& output_format( std::size_t operation ) const { return output_formats_[operation]; }
+        
+        /// calculate given operation from accumulated state
+        const char* calculate( std::size_t operation, const char* state )
+        {
+            std::fill( buffers_[operation].begin(), buffers_[operation].end(), 0 ); // buffer is shared by all ids; e.g. top may write fewer than k pairs
+            char* buf = &buffers_[operation][0];
+            for( std::size_t i = 0; i < fields_.size(); ++i ) { fields_[i].calculate( state + state_offsets_[i], operations_[operation], parameters_[operation], buf + output_elements_[operation][i].offset ); }
+            return buf;
+        }
+        
+    private:
+        std::vector< Operations::Enum::Values > operations_;
+        std::vector< Operations::Parameters > parameters_;
+        std::vector< comma::csv::format::element > input_elements_;
+        std::vector< comma::csv::format > output_formats_;
+        std::vector< std::vector< comma::csv::format::element > > output_elements_;
+        std::vector< std::vector< char > > buffers_;
+        boost::ptr_vector< Operations::base > fields_;
+        std::vector< std::size_t > state_offsets_;
+        std::size_t state_size_;
+        bool trivial_;
+        
+        template < typename T, comma::csv::format::types_enum F >
+        void push_back_( unsigned int needs, const Operations::Parameters& parameters ) { fields_.push_back( new Operations::Field< T, F >( needs, parameters ) ); }
+        
+        static comma::csv::format::types_enum output_type_( Operations::Enum::Values operation, comma::csv::format::types_enum type )
+        {
+            switch( operation )
             {
                 case Operations::Enum::radius:
                 case Operations::Enum::diameter:
-                    if( input_elements_[i].type == comma::csv::format::time || input_elements_[i].type == comma::csv::format::long_time ) { output_type = comma::csv::format::double_t; }
-                    break;
+                case Operations::Enum::iqr:
+                case Operations::Enum::variance:
+                case Operations::Enum::stddev:
+                    return type == comma::csv::format::time || type == comma::csv::format::long_time ? comma::csv::format::double_t : type;
                 case Operations::Enum::size:
-                    output_type = comma::csv::format::uint32;
-                    break;
+                case Operations::Enum::distinct:
+                    return comma::csv::format::uint32;
                 default:
-                    break;
+                    return type;
             }
-            switch( input_elements_[i].type )
-            {
-                case comma::csv::format::char_t: operations_.push_back( new typename Operations::traits< E >::template FromEnum< char, comma::csv::format::char_t >::Type ); break;
-                case comma::csv::format::int8: operations_.push_back( new typename Operations::traits< E >::template FromEnum< char, comma::csv::format::int8 >::Type ); break;
-                case comma::csv::format::uint8: operations_.push_back( new typename Operations::traits< E >::template FromEnum< unsigned char, comma::csv::format::uint8 >::Type ); break;
-                case comma::csv::format::int16: operations_.push_back( new typename Operations::traits< E >::template FromEnum< comma::int16, comma::csv::format::int16 >::Type ); break;
-                case comma::csv::format::uint16: operations_.push_back( new typename Operations::traits< E >::template FromEnum< comma::uint16, comma::csv::format::uint16 >::Type ); break;
-                case comma::csv::format::int32: operations_.push_back( new typename Operations::traits< E >::template FromEnum< comma::int32, comma::csv::format::int32 >::Type ); break;
-                case comma::csv::format::uint32: operations_.push_back( new typename Operations::traits< E >::template FromEnum< comma::uint32, comma::csv::format::uint32 >::Type ); break;
-                case comma::csv::format::int64: operations_.push_back( new typename Operations::traits< E >::template FromEnum< comma::int64, comma::csv::format::int64 >::Type ); break;
-                case comma::csv::format::uint64: operations_.push_back( new typename Operations::traits< E >::template FromEnum< comma::uint64, comma::csv::format::uint64 >::Type ); break;
-                case comma::csv::format::float_t: operations_.push_back( new typename Operations::traits< E >::template FromEnum< float, comma::csv::format::float_t >::Type ); break;
-                case comma::csv::format::double_t: operations_.push_back( new typename Operations::traits< E >::template FromEnum< double, comma::csv::format::double_t >::Type ); break;
-                case comma::csv::format::time: operations_.push_back( new typename Operations::traits< E >::template FromEnum< boost::posix_time::ptime, comma::csv::format::time >::Type ); break;
-                case comma::csv::format::long_time: operations_.push_back( new typename Operations::traits< E >::template FromEnum< boost::posix_time::ptime, comma::csv::format::long_time >::Type ); break;
-                default: COMMA_THROW( comma::exception, "operations for " << i << "th element in " << format.string() << " not defined" );
-            }
-            output_format_ += comma::csv::format::to_format( output_type );
-        }
-        for( std::size_t i = 0; i < input_elements_.size(); ++i ) { output_elements_.push_back( output_format_.offset( i ) ); }
-        buffer_.resize( output_format_.size() );
-    }
-    
-    void push( const char* buf )
-    {
-        for( std::size_t i = 0; i < operations_.size(); ++i ) { operations_[i].push( buf + input_elements_[i].offset ); }
-    }
-    
-    void calculate()
-    {
-        for( std::size_t i = 0; i < operations_.size(); ++i ) { operations_[i].calculate( &buffer_[0] + output_elements_[i].offset ); }
-    }
-    
-    Operationbase* clone() const { Operation< E >* op = new Operation< E >; return deep_copy_to_( op ); }
+        }
 };
 
-typedef boost::unordered_map< comma::uint32, boost::ptr_vector< Operationbase >* > OperationsMap;
+/// accumulated state for one id, allocated from the arena of the current block; records are buffered
+/// and pushed to the field accumulators in batches, so that each field is decoded into a column once
+/// per batch and reduced by a tight loop
+class Accumulator
+{
+    public:
+        Accumulator( const Plan& plan, Arena& arena )
+            : plan_( plan )
+            , arena_( arena )
+            , state_( arena.allocate( plan.state_size() ) )
+            , records_( NULL )
+            , size_( 0 )
+            , capacity_( 0 )
+            , record_size_( 0 )
+        {
+            plan_.init( state_ );
+        }
+        
+        ~Accumulator() { plan_.destroy( state_ ); }
+        
+        const char* state() const { return state_; }
+        
+        void push( const char* buf, std::size_t record_size )
+        {
+            record_size_ = record_size;
+            if( size_ == capacity_ ) // grow gradually: there may be many ids with few records
+            {
+                capacity_ = capacity_ == 0 ? 1 : capacity_ * 2;
+                char* records = arena_.allocate( capacity_ * record_size_ );
+                if( size_ > 0 ) { ::memcpy( records, records_, size_ * record_size_ ); }
+                records_ = records;
+            }
+            ::memcpy( records_ + size_ * record_size_, buf, record_size_ );
+            if( ++size_ == Operations::batch_size ) { flush(); }
+        }
+        
+        void flush()
+        {
+            if( size_ == 0 ) { return; }
+            plan_.push( state_, records_, size_, record_size_ );
+            size_ = 0;
+        }
+        
+    private:
+        const Plan& plan_;
+        Arena& arena_;
+        char* state_;
+        char* records_;
+        std::size_t size_;
+        std::size_t capacity_;
+        std::size_t record_size_;
+};
 
-static void init_operations( boost::ptr_vector< Operationbase >& operations
-                           , const std::vector< Operations::Enum::Values >& operation_ids
-                           , const comma::csv::format& format )
+/// accumulators by id in a flat open addressing hash table with linear probing;
+/// entries are kept in order of insertion; clear() takes constant time: a slot
+/// is occupied only if stamped with the current generation
+class OperationsMap
 {
-    static boost::ptr_vector< Operationbase > sample;
-    if( sample.empty() )
-    {
-        sample.reserve( operation_ids.size() );
-        for( std::size_t i = 0; i < operation_ids.size(); ++i )
-        { 
-            switch( operation_ids[i] )
+    public:
+        typedef std::pair< comma::uint32, Accumulator* > Entry;
+        
+        OperationsMap() : slots_( 1024 ), shift_( 22 ), generation_( 1 ) {}
+        
+        /// return accumulator for given id or NULL, if not found
+        Accumulator* find( comma::uint32 id ) const
+        {
+            for( std::size_t i = hash_( id ); slots_[i].generation == generation_; i = ( i + 1 ) & ( slots_.size() - 1 ) )
             {
-                case Operations::Enum::min: sample.push_back( new Operation< Operations::Enum::min >( format ) ); break;
-                case Operations::Enum::max: sample.push_back( new Operation< Operations::Enum::max >( format ) ); break;
-                case Operations::Enum::centre: sample.push_back( new Operation< Operations::Enum::centre >( format ) ); break;
-                case Operations::Enum::mean: sample.push_back( new Operation< Operations::Enum::mean >( format ) ); break;
-                case Operations::Enum::radius: sample.push_back( new Operation< Operations::Enum::radius >( format ) ); break;
-                case Operations::Enum::diameter: sample.push_back( new Operation< Operations::Enum::diameter >( format ) ); break;
-                case Operations::Enum::variance: sample.push_back( new Operation< Operations::Enum::variance >( format ) ); break;
-                case Operations::Enum::stddev: sample.push_back( new Operation< Operations::Enum::stddev >( format ) ); break;
-                case Operations::Enum::sum: sample.push_back( new Operation< Operations::Enum::sum >( format ) ); break;
-                case Operations::Enum::size: sample.push_back( new Operation< Operations::Enum::size >( format ) ); break;
+                if( entries_[ slots_[i].index ].first == id ) { return entries_[ slots_[i].index ].second; }
             }
+            return NULL;
         }
-    }
-    operations.clear();
-    for( std::size_t i = 0; i < sample.size(); ++i ) { operations.push_back( sample[i].clone() ); }
-}
+        
+        /// insert accumulator for id not yet in the map
+        void insert( comma::uint32 id, Accumulator* accumulator )
+        {
+            if( ( entries_.size() + 1 ) * 2 > slots_.size() ) { rehash_(); }
+            entries_.push_back( Entry( id, accumulator ) );
+            place_( entries_.size() - 1 );
+        }
+        
+        const std::vector< Entry >& entries() const { return entries_; }
+        
+        void clear()
+        {
+            entries_.clear();
+            if( ++generation_ == 0 ) { slots_.assign( slots_.size(), Slot() ); generation_ = 1; } // generation wrapped around
+        }
+        
+    private:
+        struct Slot
+        {
+            comma::uint32 generation;
+            comma::uint32 index;
+            Slot() : generation( 0 ), index( 0 ) {}
+        };
+        std::vector< Slot > slots_;
+        unsigned int shift_;
+        comma::uint32 generation_;
+        std::vector< Entry > entries_;
+        
+        std::size_t hash_( comma::uint32 id ) const { return comma::uint32( id * 2654435769u ) >> shift_; } // fibonacci hashing
+        
+        void place_( std::size_t index )
+        {
+            std::size_t i = hash_( entries_[index].first );
+            while( slots_[i].generation == generation_ ) { i = ( i + 1 ) & ( slots_.size() - 1 ); }
+            slots_[i].generation = generation_;
+            slots_[i].index = index;
+        }
+        
+        void rehash_()
+        {
+            slots_.assign( slots_.size() * 2, Slot() );
+            --shift_;
+            for( std::size_t i = 0; i < entries_.size(); ++i ) { place_( i ); }
+        }
+};
+
+/// hash-partitions records by id across worker threads, so that all values of
+/// any given id are accumulated by the same thread and never need merging
+/// (accumulators may still hold buffered records after wait(), to be flushed by the caller)
+class Shards
+{
+    public:
+        Shards( unsigned int size, std::size_t batch_size = 1024 )
+            : batch_size_( batch_size )
+            , batches_( size )
+            , queues_( size )
+            , pending_( 0 )
+            , done_( false )
+        {
+            for( unsigned int i = 0; i < size; ++i ) { threads_.create_thread( boost::bind( &Shards::run_, this, i ) ); }
+        }
+        
+        ~Shards()
+        {
+            {
+                boost::mutex::scoped_lock lock( mutex_ );
+                done_ = true;
+                condition_.notify_all();
+            }
+            threads_.join_all();
+        }
+        
+        void push( comma::uint32 id, Accumulator* accumulator, const char* buf, std::size_t size )
+        {
+            unsigned int i = id % batches_.size();
+            Batch& batch = batches_[i];
+            batch.size = size;
+            batch.accumulators.push_back( accumulator );
+            batch.data.insert( batch.data.end(), buf, buf + size );
+            if( batch.accumulators.size() >= batch_size_ ) { flush_( i ); }
+        }
+        
+        /// wait until all records pushed so far are accumulated
+        void wait()
+        {
+            for( unsigned int i = 0; i < batches_.size(); ++i ) { if( !batches_[i].accumulators.empty() ) { flush_( i ); } }
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( pending_ > 0 && error_.empty() ) { condition_.wait( lock ); }
+            if( !error_.empty() ) { COMMA_THROW( comma::exception, error_ ); }
+        }
+        
+    private:
+        struct Batch
+        {
+            std::vector< Accumulator* > accumulators;
+            std::vector< char > data;
+            std::size_t size;
+            Batch() : size( 0 ) {}
+        };
+        std::size_t batch_size_;
+        std::vector< Batch > batches_;
+        std::vector< std::deque< boost::shared_ptr< Batch > > > queues_;
+        std::size_t pending_;
+        bool done_;
+        std::string error_;
+        boost::mutex mutex_;
+        boost::condition_variable condition_;
+        boost::thread_group threads_;
+        
+        void flush_( unsigned int i )
+        {
+            boost::shared_ptr< Batch > batch( new Batch );
+            std::swap( *batch, batches_[i] );
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( queues_[i].size() >= 4 && error_.empty() ) { condition_.wait( lock ); }
+            if( !error_.empty() ) { COMMA_THROW( comma::exception, error_ ); }
+            queues_[i].push_back( batch );
+            ++pending_;
+            condition_.notify_all();
+        }
+        
+        void run_( unsigned int i )
+        {
+            while( true )
+            {
+                boost::shared_ptr< Batch > batch;
+                {
+                    boost::mutex::scoped_lock lock( mutex_ );
+                    while( queues_[i].empty() && !done_ ) { condition_.wait( lock ); }
+                    if( queues_[i].empty() ) { return; }
+                    batch = queues_[i].front();
+                    queues_[i].pop_front();
+                    condition_.notify_all();
+                }
+                std::string error;
+                try
+                {
+                    for( std::size_t j = 0; j < batch->accumulators.size(); ++j ) { batch->accumulators[j]->push( &batch->data[ j * batch->size ], batch->size ); }
+                }
+                catch( std::exception& ex ) { error = ex.what(); }
+                catch( ... ) { error = "unknown exception"; }
+                boost::mutex::scoped_lock lock( mutex_ );
+                if( error_.empty() ) { error_ = error; }
+                --pending_;
+                condition_.notify_all();
+            }
+        }
+};
 
-static void calculate_and_output( const comma::csv::options& csv, OperationsMap& operations, boost::optional< comma::uint32 > block, bool has_block, bool has_id )
+static void calculate_and_output( const comma::csv::options& csv, Plan* plan, OperationsMap& operations, Arena& arena, boost::optional< comma::uint32 > block, bool has_block, bool has_id )
 {
-    for( OperationsMap::iterator it = operations.begin(); it != operations.end(); ++it )
+    const std::vector< OperationsMap::Entry >& entries = operations.entries();
+    for( std::vector< OperationsMap::Entry >::const_iterator it = entries.begin(); it != entries.end(); ++it )
     {
-        for( std::size_t i = 0; i < it->second->size(); ++i )
+        it->second->flush();
+        for( std::size_t i = 0; i < plan->size(); ++i )
         {
-            ( *it->second )[i].calculate();
-            if( csv.binary() ) { std::cout.write( ( *it->second )[i].buffer(), ( *it->second )[i].output_format().size() ); }
-            else { if( i > 0 ) { std::cout << csv.delimiter; } std::cout << ( *it->second )[i].output_format().bin_to_csv( ( *it->second )[i].buffer(), csv.delimiter, 12 ); }
+            const char* buf = plan->calculate( i, it->second->state() );
+            if( csv.binary() ) { std::cout.write( buf, plan->output_format( i ).size() ); }
+            else { if( i > 0 ) { std::cout << csv.delimiter; } std::cout << plan->output_format( i ).bin_to_csv( buf, csv.delimiter, 12 ); }
         }
         if( csv.binary() )
         {
@@ -659,8 +1261,200 @@ static void calculate_and_output( const comma::csv::options& csv, OperationsMap&
             std::cout << std::endl;
         }
     }
-    for( OperationsMap::iterator it = operations.begin(); it != operations.end(); ++it ) { delete it->second; } // quick and dirty
+    if( plan && !plan->trivial() ) { for( std::size_t i = 0; i < entries.size(); ++i ) { entries[i].second->~Accumulator(); } }
     operations.clear();
+    arena.clear();
+}
+
+/// rolling statistics over a window of the latest records with O(1) amortised updates:
+/// monotonic deques for min and max, running sum, welford's mean and variance
+class Rolling
+{
+    public:
+        Rolling( std::size_t size ) : fields_( size ), index_( 0 ), front_( 0 ) {}
+        
+        void push( const std::vector< double >& values, const boost::posix_time::ptime& t )
+        {
+            for( std::size_t i = 0; i < fields_.size(); ++i )
+            {
+                Field& f = fields_[i];
+                double x = values[i];
+                while( !f.min.empty() && !( f.min.back().second < x ) ) { f.min.pop_back(); }
+                f.min.push_back( std::make_pair( index_, x ) );
+                while( !f.max.empty() && !( x < f.max.back().second ) ) { f.max.pop_back(); }
+                f.max.push_back( std::make_pair( index_, x ) );
+                f.sum += x;
+                double d = x - f.mean;
+                f.mean += d / ( window_.size() + 1 );
+                f.m2 += d * ( x - f.mean );
+            }
+            window_.push_back( std::make_pair( t, values ) );
+            ++index_;
+        }
+        
+        void pop()
+        {
+            const std::vector< double >& values = window_.front().second;
+            std::size_t n = window_.size() - 1;
+            for( std::size_t i = 0; i < fields_.size(); ++i )
+            {
+                Field& f = fields_[i];
+                double x = values[i];
+                if( f.min.front().first == front_ ) { f.min.pop_front(); }
+                if( f.max.front().first == front_ ) { f.max.pop_front(); }
+                if( n == 0 ) { f = Field(); continue; }
+                f.sum -= x;
+                double d = x - f.mean;
+                f.mean -= d / n;
+                f.m2 -= d * ( x - f.mean );
+                if( f.m2 < 0 ) { f.m2 = 0; } // rounding
+            }
+            window_.pop_front();
+            ++front_;
+        }
+        
+        std::size_t size() const { return window_.size(); }
+        comma::uint64 count() const { return index_; }
+        const boost::posix_time::ptime& front_time() const { return window_.front().first; }
+        
+        double calculate( Operations::Enum::Values operation, std::size_t i ) const
+        {
+            if( window_.empty() ) { COMMA_THROW( comma::exception, "cannot calculate statistics of empty window" ); }
+            const Field& f = fields_[i];
+            switch( operation )
+            {
+                case Operations::Enum::min: return f.min.front().second;
+                case Operations::Enum::max: return f.max.front().second;
+                case Operations::Enum::centre: return ( f.min.front().second + f.max.front().second ) / 2;
+                case Operations::Enum::diameter: return f.max.front().second - f.min.front().second;
+                case Operations::Enum::radius: return ( f.max.front().second - f.min.front().second ) / 2;
+                case Operations::Enum::mean: return f.mean;
+                case Operations::Enum::sum: return f.sum;
+                case Operations::Enum::variance: return f.m2 / window_.size();
+                case Operations::Enum::stddev: return std::sqrt( f.m2 / window_.size() );
+                case Operations::Enum::size: return window_.size();
+                default: COMMA_THROW( comma::exception, "operation not supported in rolling mode" );
+            }
+        }
+        
+    private:
+        struct Field
+        {
+            std::deque< std::pair< comma::uint64, double > > min;
+            std::deque< std::pair< comma::uint64, double > > max;
+            double sum;
+            double mean;
+            double m2;
+            Field() : sum( 0 ), mean( 0 ), m2( 0 ) {}
+        };
+        std::vector< Field > fields_;
+        std::deque< std::pair< boost::posix_time::ptime, std::vector< double > > > window_;
+        comma::uint64 index_; // index of the next record
+        comma::uint64 front_; // index of the oldest record in the window
+};
+
+static double as_double( const char* buf, const comma::csv::format::element& e )
+{
+    switch( e.type )
+    {
+        case comma::csv::format::char_t: return comma::csv::format::traits< char >::from_bin( buf + e.offset );
+        case comma::csv::format::int8: return comma::csv::format::traits< char >::from_bin( buf + e.offset );
+        case comma::csv::format::uint8: return comma::csv::format::traits< unsigned char >::from_bin( buf + e.offset );
+        case comma::csv::format::int16: return comma::csv::format::traits< comma::int16 >::from_bin( buf + e.offset );
+        case comma::csv::format::uint16: return comma::csv::format::traits< comma::uint16 >::from_bin( buf + e.offset );
+        case comma::csv::format::int32: return comma::csv::format::traits< comma::int32 >::from_bin( buf + e.offset );
+        case comma::csv::format::uint32: return comma::csv::format::traits< comma::uint32 >::from_bin( buf + e.offset );
+        case comma::csv::format::int64: return comma::csv::format::traits< comma::int64 >::from_bin( buf + e.offset );
+        case comma::csv::format::uint64: return comma::csv::format::traits< comma::uint64 >::from_bin( buf + e.offset );
+        case comma::csv::format::float_t: return comma::csv::format::traits< float >::from_bin( buf + e.offset );
+        case comma::csv::format::double_t: return comma::csv::format::traits< double >::from_bin( buf + e.offset );
+        default: COMMA_THROW( comma::exception, "rolling statistics supported only for numeric fields, got " << comma::csv::format::to_format( e.type ) );
+    }
+}
+
+/// output statistics for the window ending at each record (or each step-th record), by id,
+/// keeping the window as the last window_size records or the records within span
+static void run_rolling( const comma::csv::options& csv
+                       , boost::scoped_ptr< asciiInput >& ascii
+                       , boost::scoped_ptr< binaryInput >& binary
+                       , const std::vector< Operations::Enum::Values >& operation_ids
+                       , std::size_t window_size
+                       , const boost::optional< boost::posix_time::time_duration >& span
+                       , std::size_t step )
+{
+    for( std::size_t i = 0; i < operation_ids.size(); ++i )
+    {
+        switch( operation_ids[i] )
+        {
+            case Operations::Enum::percentile: case Operations::Enum::iqr: COMMA_THROW( comma::exception, "percentiles not supported in rolling mode" );
+            case Operations::Enum::distinct: case Operations::Enum::top: case Operations::Enum::histogram: COMMA_THROW( comma::exception, "distinct, top and histogram not supported in rolling mode" );
+            default: break;
+        }
+    }
+    typedef boost::unordered_map< comma::uint32, boost::shared_ptr< Rolling > > Map;
+    Map windows;
+    boost::optional< comma::uint32 > block;
+    bool has_block = csv.has_field( "block" );
+    bool has_id = csv.has_field( "id" );
+    comma::csv::format output_format;
+    std::vector< comma::csv::format::element > elements;
+    std::vector< double > values;
+    std::vector< char > buffer;
+    comma::signal_flag is_shutdown;
+    while( !is_shutdown && std::cin.good() && !std::cin.eof() )
+    {
+        const Values* v = csv.binary() ? binary->read() : ascii->read();
+        if( v == NULL ) { break; }
+        if( elements.empty() )
+        {
+            for( std::size_t i = 0; i < v->format().count(); ++i ) { elements.push_back( v->format().offset( i ) ); }
+            for( std::size_t i = 0; i < operation_ids.size(); ++i )
+            {
+                for( std::size_t j = 0; j < elements.size(); ++j ) { output_format += operation_ids[i] == Operations::Enum::size ? "ui" : "d"; }
+            }
+            values.resize( elements.size() );
+            buffer.resize( output_format.size() );
+        }
+        if( has_block )
+        {
+            if( block && *block != v->block() ) { windows.clear(); }
+            block = v->block();
+        }
+        boost::shared_ptr< Rolling >& rolling = windows[ v->id() ];
+        if( !rolling ) { rolling.reset( new Rolling( elements.size() ) ); }
+        for( std::size_t i = 0; i < elements.size(); ++i ) { values[i] = as_double( v->buffer(), elements[i] ); }
+        rolling->push( values, v->time() );
+        if( span ) { while( rolling->size() > 1 && rolling->front_time() <= v->time() - *span ) { rolling->pop(); } } // the current record always stays, e.g. if its time is not-a-date-time
+        else { while( rolling->size() > window_size ) { rolling->pop(); } }
+        if( rolling->count() % step != 0 ) { continue; }
+        char* p = &buffer[0];
+        for( std::size_t i = 0; i < operation_ids.size(); ++i )
+        {
+            for( std::size_t j = 0; j < elements.size(); ++j )
+            {
+                double d = rolling->calculate( operation_ids[i], j );
+                if( operation_ids[i] == Operations::Enum::size ) { comma::csv::format::traits< comma::uint32 >::to_bin( static_cast< comma::uint32 >( d ), p ); p += sizeof( comma::uint32 ); }
+                else { comma::csv::format::traits< double >::to_bin( d, p ); p += sizeof( double ); }
+            }
+        }
+        comma::uint32 id = v->id();
+        if( csv.binary() )
+        {
+            std::cout.write( &buffer[0], buffer.size() );
+            if( span ) { char t[8]; comma::csv::format::traits< boost::posix_time::ptime >::to_bin( v->time(), t ); std::cout.write( t, 8 ); }
+            if( has_id ) { std::cout.write( reinterpret_cast< const char* >( &id ), sizeof( comma::uint32 ) ); }
+            if( has_block ) { std::cout.write( reinterpret_cast< const char* >( &( *block ) ), sizeof( comma::uint32 ) ); }
+            std::cout.flush();
+        }
+        else
+        {
+            std::cout << output_format.bin_to_csv( &buffer[0], csv.delimiter, 12 );
+            if( span ) { std::cout << csv.delimiter << boost::posix_time::to_iso_string( v->time() ); }
+            if( has_id ) { std::cout << csv.delimiter << id; }
+            if( has_block ) { std::cout << csv.delimiter << *block; }
+            std::cout << std::endl;
+        }
+    }
 }
 
 int main( int ac, char** av )
@@ -669,26 +1463,70 @@ int main( int ac, char** av )
     {
         comma::command_line_options options( ac, av );
         if( options.exists( "--help,-h" ) ) { usage(); }
-        std::vector< std::string > unnamed = options.unnamed( "", "--binary,-b,--delimiter,-d,--format,--fields,-f" );
+        std::vector< std::string > unnamed = options.unnamed( "--exact", "--binary,-b,--delimiter,-d,--format,--fields,-f,--sketch-size,--distinct-precision,--threads,--window,--span,--step,--on-error" );
         comma::csv::options csv( options );
         #ifdef WIN32
         if( csv.binary() ) { _setmode( _fileno( stdin ), _O_BINARY ); _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
+        std::ios_base::sync_with_stdio( false ); // otherwise std::getline() reads character by character; only iostreams are used
         if( unnamed.empty() ) { std::cerr << "csv-calc: please specify operations" << std::endl; exit( 1 ); }
         std::vector< std::string > v = comma::split( unnamed[0], ',' );
         std::vector< Operations::Enum::Values > operation_ids( v.size() );
-        for( std::size_t i = 0; i < v.size(); ++i ) { operation_ids[i] = Operations::from_name( v[i] ); }
+        std::vector< Operations::Parameters > parameters( v.size() );
+        std::size_t sketch_size = options.exists( "--exact" ) ? 0 : options.value< std::size_t >( "--sketch-size", 200 );
+        unsigned int precision = options.value< unsigned int >( "--distinct-precision", 12 );
+        for( std::size_t i = 0; i < v.size(); ++i )
+        {
+            std::vector< std::string > w = comma::split( v[i], '=' );
+            operation_ids[i] = Operations::from_name( w[0] );
+            parameters[i].sketch_size = sketch_size;
+            parameters[i].precision = precision;
+            if( w[0] == "percentile" )
+            {
+                if( w.size() != 2 ) { COMMA_THROW( comma::exception, "expected percentile=<p>, got \"" << v[i] << "\"" ); }
+                parameters[i].percentile = boost::lexical_cast< double >( w[1] );
+                if( !( parameters[i].percentile >= 0 && parameters[i].percentile <= 1 ) ) { COMMA_THROW( comma::exception, "expected percentile between 0 and 1, got " << w[1] ); }
+            }
+            else if( w[0] == "top" || w[0] == "histogram" )
+            {
+                if( w.size() != 2 ) { COMMA_THROW( comma::exception, "expected " << w[0] << "=<n>, got \"" << v[i] << "\"" ); }
+                std::size_t n = boost::lexical_cast< std::size_t >( w[1] );
+                if( n == 0 ) { COMMA_THROW( comma::exception, "expected positive number in \"" << v[i] << "\"" ); }
+                ( w[0] == "top" ? parameters[i].top : parameters[i].bins ) = n;
+            }
+            else if( w.size() > 1 ) { COMMA_THROW( comma::exception, "operation " << w[0] << " takes no parameters, got \"" << v[i] << "\"" ); }
+        }
         boost::optional< comma::csv::format > format;
         if( csv.binary() ) { format = csv.format(); }
         else if( options.exists( "--format" ) ) { format = comma::csv::format( options.value< std::string >( "--format" ) ); }
+        if( format && format->is_variable_size() ) { COMMA_THROW( comma::exception, "variable size format not supported; use fixed size strings instead, e.g. \"s[8]\"" ); }
+        boost::optional< std::size_t > window = options.optional< std::size_t >( "--window" );
+        boost::optional< boost::posix_time::time_duration > span;
+        if( options.exists( "--span" ) ) { span = boost::posix_time::microseconds( static_cast< comma::int64 >( options.value< double >( "--span" ) * 1000000 ) ); }
+        if( window && span ) { COMMA_THROW( comma::exception, "expected either --window or --span, got both" ); }
+        if( window && *window == 0 ) { COMMA_THROW( comma::exception, "expected positive --window" ); }
+        if( span && ( span->is_negative() || span->total_microseconds() == 0 ) ) { COMMA_THROW( comma::exception, "expected positive --span, got " << options.value< std::string >( "--span" ) ); }
         boost::scoped_ptr< asciiInput > ascii;
         boost::scoped_ptr< binaryInput > binary;
-        if( csv.binary() ) { binary.reset( new binaryInput( csv ) ); }
-        else { ascii.reset( new asciiInput( csv, format ) ); }
+        if( csv.binary() ) { binary.reset( new binaryInput( csv, bool( span ) ) ); }
+        else { ascii.reset( new asciiInput( csv, format, bool( span ) ) ); }
+        if( window || span )
+        {
+            std::size_t step = options.value< std::size_t >( "--step", 1 );
+            if( step == 0 ) { COMMA_THROW( comma::exception, "expected positive --step" ); }
+            run_rolling( csv, ascii, binary, operation_ids, window ? *window : 0, span, step );
+            return 0;
+        }
+        boost::scoped_ptr< Plan > plan;
         OperationsMap operations;
+        Arena arena;
         boost::optional< comma::uint32 > block;
         bool has_block = csv.has_field( "block" );
         bool has_id = csv.has_field( "id" );
+        unsigned int threads = options.value< unsigned int >( "--threads", 1 );
+        if( threads == 0 ) { threads = boost::thread::hardware_concurrency(); }
+        boost::scoped_ptr< Shards > shards;
+        if( threads > 1 ) { shards.reset( new Shards( threads ) ); }
         comma::signal_flag is_shutdown;
         while( !is_shutdown && std::cin.good() && !std::cin.eof() )
         { 
@@ -696,20 +1534,28 @@ int main( int ac, char** av )
             if( v == NULL ) { break; }
             if( has_block )
             {
-                if( block && *block != v->block() ) { calculate_and_output( csv, operations, block, has_block, has_id ); }
+                if( block && *block != v->block() )
+                {
+                    if( shards ) { shards->wait(); }
+                    calculate_and_output( csv, plan.get(), operations, arena, block, has_block, has_id );
+                }
                 block = v->block();
             }
-            OperationsMap::iterator it = operations.find( v->id() );
-            if( it == operations.end() )
+            Accumulator* accumulator = operations.find( v->id() );
+            if( accumulator == NULL )
             {
-                it = operations.insert( std::make_pair( v->id(), new boost::ptr_vector< Operationbase > ) ).first;
-                init_operations( *it->second, operation_ids, v->format() );
+                if( !plan ) { plan.reset( new Plan( operation_ids, parameters, v->format() ) ); }
+                accumulator = new ( arena.allocate( sizeof( Accumulator ) ) ) Accumulator( *plan, arena );
+                operations.insert( v->id(), accumulator );
             }
-            for( std::size_t i = 0; i < it->second->size(); ++i ) { ( *it->second )[i].push( v->buffer() ); }
+            if( shards ) { shards->push( v->id(), accumulator, v->buffer(), v->format().size() ); continue; }
+            accumulator->push( v->buffer(), v->format().size() );
         }
-        calculate_and_output( csv, operations, block, has_block, has_id );
+        if( shards ) { shards->wait(); }
+        calculate_and_output( csv, plan.get(), operations, arena, block, has_block, has_id );
         return 0;
     }
     catch( std::exception& ex ) { std::cerr << "csv-calc: " << ex.what() << std::endl; }
     catch( ... ) { std::cerr << "csv-calc: unknown exception" << std::endl; }
+    return 1;
 }
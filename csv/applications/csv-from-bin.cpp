@@ -63,14 +63,19 @@ int main( int ac, char** av )
         if( options.exists( "--precision" ) ) { precision = options.value< unsigned int >( "--precision" ); }
         comma::csv::format format( av[1] );
         std::vector< char > w( format.size() ); //char buf[ format.size() ]; // stupid windows
-        char* buf = &w[0];
         while( std::cin.good() && !std::cin.eof() )
         {
             if( shutdownFlag ) { std::cerr << "csv-from-bin: interrupted by signal" << std::endl; return -1; }
-            std::cin.read( buf, format.size() );
+            std::cin.read( &w[0], format.size() );
             if( std::cin.gcount() == 0 ) { break; }
             if( std::cin.gcount() < static_cast< int >( format.size() ) ) { COMMA_THROW( comma::exception, "expected " << format.size() << " bytes, got only " << std::cin.gcount() ); }
-            std::cout << format.bin_to_csv( buf, delimiter, precision ) << std::endl;
+            for( std::size_t size = format.size(), s = format.size( &w[0], size ); s > size; size = s, s = format.size( &w[0], size ) ) // variable size record: read the rest
+            {
+                if( w.size() < s ) { w.resize( s ); }
+                std::cin.read( &w[0] + size, s - size );
+                if( std::cin.gcount() < static_cast< int >( s - size ) ) { COMMA_THROW( comma::exception, "expected " << ( s - size ) << " more bytes, got only " << std::cin.gcount() ); }
+            }
+            std::cout << format.bin_to_csv( &w[0], delimiter, precision ) << std::endl;
         }
         return 0;
     }
@@ -18,21 +18,32 @@
 
 /// @author vsevolod vlaskine
 
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
-#include <boost/array.hpp>
-#include <boost/functional/hash.hpp>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/unordered_map.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <comma/application/command_line_options.h>
 #include <comma/application/contact_info.h>
 #include <comma/application/signal_flag.h>
 #include <comma/base/types.h>
 #include <comma/csv/stream.h>
+#include <comma/csv/impl/byte_swap.h>
+#include <comma/csv/impl/half.h>
+#include <comma/csv/impl/scaled.h>
 #include <comma/io/stream.h>
 #include <comma/name_value/parser.h>
 #include <comma/string/string.h>
@@ -41,7 +52,7 @@
 static void usage( bool long_help = false )
 {
     std::cerr << std::endl;
-    std::cerr << "join two csv files or streams by one or several keys (integer only for now)" << std::endl;
+    std::cerr << "join two csv files or streams by one or several keys" << std::endl;
     std::cerr << std::endl;
     std::cerr << "usage: cat something.csv csv-join \"something_else.csv[,options]\" [<options>]" << std::endl;
     std::cerr << std::endl;
@@ -49,9 +60,49 @@ static void usage( bool long_help = false )
     std::cerr << "        block: block number" << std::endl;
     std::cerr << "        any other field names: keys" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "    keys: any number of keys of any type: integer, floating point, time or string" << std::endl;
+    std::cerr << "          binary: key types are taken from the formats of both streams;" << std::endl;
+    std::cerr << "                  keys of different integer or floating point types match, if their values are equal," << std::endl;
+    std::cerr << "                  e.g. ui key matches d key; other type mismatches are an error" << std::endl;
+    std::cerr << "          ascii: key types are taken from --format, if present; otherwise keys are integers, e.g. 1 and 01 match;" << std::endl;
+    std::cerr << "                 for keys of other types use --format, e.g. for string keys: --fields=,id --format=,s" << std::endl;
+    std::cerr << std::endl;
     std::cerr << "options:" << std::endl;
     //std::cerr << "    --long-help: more help" << std::endl;
+    std::cerr << "    --anti: anti-join: output only stdin records that have no matching records, as is" << std::endl;
     std::cerr << "    --first-matching: output only the first matching record (a bit of hack for now, but we needed it)" << std::endl;
+    std::cerr << "    --radius=<radius>: spatial join: join stdin records with the records of the second input" << std::endl;
+    std::cerr << "                       within given distance, using fields x, y, and/or z (whichever are present)" << std::endl;
+    std::cerr << "                       as coordinates and any other common fields as exact keys, e.g:" << std::endl;
+    std::cerr << "                           cat points.csv | csv-join --fields=x,y,z,id --radius=0.5 \"targets.csv;fields=id,x,y,z\"" << std::endl;
+    std::cerr << "                       filter records are hashed by grid cells of size radius, thus neighbours" << std::endl;
+    std::cerr << "                       across cell edges are found in one pass; blocks work as usual" << std::endl;
+    std::cerr << "                       not supported with --sorted, --memory-limit, --threads, or --first-matching" << std::endl;
+    std::cerr << "    --nearest: with --radius, output only the nearest record within radius; of equally near records, the first one" << std::endl;
+    std::cerr << "    --prefetch: read the next block of the second input on a separate thread, while the current block" << std::endl;
+    std::cerr << "                is being joined; memory usage: two blocks instead of one" << std::endl;
+    std::cerr << "                not supported with --sorted or --memory-limit" << std::endl;
+    std::cerr << "    --semi: semi-join: output stdin records that have matching records once, as is;" << std::endl;
+    std::cerr << "            with --semi or --anti, only the keys of the second input are kept in memory" << std::endl;
+    std::cerr << "    --sorted: both inputs are sorted by block, if any, and then by keys in ascending order;" << std::endl;
+    std::cerr << "              join them in lockstep, keeping in memory only the records of the current key" << std::endl;
+    std::cerr << "              (otherwise, the whole block of the second input is loaded into memory);" << std::endl;
+    std::cerr << "              strings sort in byte order, e.g. as with LC_ALL=C sort; unsorted input is an error" << std::endl;
+    std::cerr << "    --format=<format>: ascii only: format hint for stdin fields, e.g. --fields=t,,id --format=t,,ui" << std::endl;
+    std::cerr << "    --on-error=<policy>: as in csv options below, applied to both inputs, including key fields, e.g. a non-integer" << std::endl;
+    std::cerr << "                         integer key: skip: skip the record; default: use 0, empty string or not-a-date-time as key" << std::endl;
+    std::cerr << "    --memory-limit=<size>: if a block of the second input takes more memory than given size, e.g. 512M or 2G," << std::endl;
+    std::cerr << "                           spill it and the matching records from stdin to temporary files partitioned by key" << std::endl;
+    std::cerr << "                           and join them partition by partition (grace hash join); memory limit is approximate" << std::endl;
+    std::cerr << "                           attention: for spilled blocks, output is not in the order of stdin records," << std::endl;
+    std::cerr << "                           but grouped by partition; records of the same key still are in the input order" << std::endl;
+    std::cerr << "    --temp-directory=<directory>: directory for temporary files; default: $TMPDIR or /tmp" << std::endl;
+    std::cerr << "    --threads=<n>: number of threads probing stdin records against the second input; 0: number of cores; default: 1" << std::endl;
+    std::cerr << "                   stdin is read in batches, one per thread; output is in the order of stdin records" << std::endl;
+    std::cerr << "                   not supported with --sorted, --memory-limit, --on-error other than throw, or variable size binary formats" << std::endl;
+    std::cerr << "    --batch-size=<n>: number of records per batch for --threads; default: 4096" << std::endl;
+    std::cerr << "    --tolerance=<tolerance>: floating point keys match if they fall into the same bin of given size," << std::endl;
+    std::cerr << "                             i.e. floor( key / tolerance ) is the same; default: exact match" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << comma::csv::options::usage() << std::endl;
     std::cerr << std::endl;
@@ -65,49 +116,280 @@ static void usage( bool long_help = false )
 
 struct input
 {
-    enum { size = 16 }; // quick and dirty: up to 16 keys
-    boost::array< comma::uint64, size > keys;
     comma::uint32 block;
- 
-    static unsigned int keys_size;
-    
-    struct Hash;
-    
     input() : block( 0 ) {}
-    
-    bool operator==( const input& rhs ) const
-    {
-        for( std::size_t i = 0; i < keys_size; ++i ) { if( keys[i] != rhs.keys[i] ) { return false; } }
-        return true;
-    }
-    
-    bool operator<( const input& rhs ) const
-    {
-        for( std::size_t i = 0; i < keys_size; ++i ) { if( keys[i] < rhs.keys[i] ) { return true; } }
-        return false;
-    }
 };
 
-unsigned int input::keys_size = 0;
-
 namespace comma { namespace visiting {
 
 template <> struct traits< input >
 {
-    template < typename K, typename V > static void visit( const K&, const input& p, V& v )
-    { 
-        v.apply( "keys", p.keys );
-        v.apply( "block", p.block );
-    }
-    template < typename K, typename V > static void visit( const K&, input& p, V& v )
-    { 
-        v.apply( "keys", p.keys );
-        v.apply( "block", p.block );
-    }
+    template < typename K, typename V > static void visit( const K&, const input& p, V& v ) { v.apply( "block", p.block ); }
+    template < typename K, typename V > static void visit( const K&, input& p, V& v ) { v.apply( "block", p.block ); }
 };
 
 } } // namespace comma { namespace visiting {
 
+/// join key of a record: values of all key fields in canonical binary form, so that
+/// keys of any number and type compare by a single string comparison; the hash is
+/// computed once, when the key is made
+struct key
+{
+    std::string bytes;
+    comma::uint64 hash;
+    
+    key() : hash( 0 ) {}
+};
+
+/// key types: keys of different types on the two sides are compared, if the types are of the same category;
+/// integers compared with floating point values are converted to floating point
+struct category { enum values { integer, floating_point, time, string }; };
+
+static category::values category_of( const comma::csv::format::element& e )
+{
+    switch( e.type )
+    {
+        case comma::csv::format::char_t:
+        case comma::csv::format::int8:
+        case comma::csv::format::uint8:
+        case comma::csv::format::int16:
+        case comma::csv::format::uint16:
+        case comma::csv::format::int32:
+        case comma::csv::format::uint32:
+        case comma::csv::format::int64:
+        case comma::csv::format::uint64:
+            return e.scaled() ? category::floating_point : category::integer;
+        case comma::csv::format::float_t:
+        case comma::csv::format::double_t:
+        case comma::csv::format::half_t:
+            return category::floating_point;
+        case comma::csv::format::time:
+        case comma::csv::format::long_time:
+            return category::time;
+        case comma::csv::format::fixed_string:
+        case comma::csv::format::variable_string:
+            return category::string;
+        default:
+            COMMA_THROW( comma::exception, "key of type " << comma::csv::format::to_format( e.type ) << " not supported" );
+    }
+}
+
+static category::values common_category( category::values a, category::values b, const std::string& name )
+{
+    if( a == b ) { return a; }
+    if( ( a == category::integer && b == category::floating_point ) || ( a == category::floating_point && b == category::integer ) ) { return category::floating_point; }
+    COMMA_THROW( comma::exception, "expected key \"" << name << "\" of the same type on both sides, got different types" );
+}
+
+/// makes keys from records of one stream, reading key fields straight from the
+/// binary record or from the ascii fields, without decoding the whole record
+class keys
+{
+    public:
+        keys( const comma::csv::options& csv, const std::vector< std::size_t >& indices, const std::vector< category::values >& categories, double tolerance )
+            : indices_( indices )
+            , categories_( categories )
+            , tolerance_( tolerance )
+            , binary_( csv.binary() )
+            , variable_size_( binary_ && csv.format().is_variable_size() )
+            , tolerant_( csv.on_error != comma::csv::options::on_error_throw )
+        {
+            if( !binary_ ) { return; }
+            for( std::size_t i = 0; i < csv.format().count(); ++i ) { elements_.push_back( csv.format().offset( i ) ); }
+            format_ = csv.format();
+        }
+        
+        /// make key from binary record; return true (binary key fields always convert)
+        bool make( const char* buf, key& k ) const
+        {
+            if( variable_size_ ) { format_.offsets( buf, elements_ ); }
+            k.bytes.clear();
+            for( std::size_t i = 0; i < indices_.size(); ++i ) { append_( buf, elements_[ indices_[i] ], categories_[i], k.bytes ); }
+            k.hash = hash( k.bytes );
+            return true;
+        }
+        
+        /// make key from ascii record; with --on-error other than throw, key fields
+        /// that fail to convert get default values and false is returned
+        bool make( const std::vector< std::string >& fields, key& k ) const
+        {
+            k.bytes.clear();
+            bool converted = true;
+            for( std::size_t i = 0; i < indices_.size(); ++i )
+            {
+                if( indices_[i] >= fields.size() ) { COMMA_THROW( comma::exception, "expected at least " << ( indices_[i] + 1 ) << " field(s), got " << fields.size() ); }
+                if( !tolerant_ ) { append_( fields[ indices_[i] ], categories_[i], k.bytes ); continue; }
+                try { append_( fields[ indices_[i] ], categories_[i], k.bytes ); }
+                catch( boost::bad_lexical_cast& ) { append_default_( categories_[i], k.bytes ); converted = false; }
+                catch( std::out_of_range& ) { append_default_( categories_[i], k.bytes ); converted = false; } // e.g. bad dates
+            }
+            k.hash = hash( k.bytes );
+            return converted;
+        }
+        
+        /// compare keys made by keys with the same key types: return -1, 0, or 1, if a is less, equal, or greater than b
+        int compare( const key& a, const key& b ) const
+        {
+            const char* p = &a.bytes[0];
+            const char* q = &b.bytes[0];
+            for( std::size_t i = 0; i < categories_.size(); ++i )
+            {
+                int c = 0;
+                switch( categories_[i] )
+                {
+                    case category::integer:
+                        c = compare_< comma::int64 >( p, q );
+                        p += sizeof( comma::int64 );
+                        q += sizeof( comma::int64 );
+                        break;
+                    case category::floating_point:
+                        c = tolerance_ > 0 ? compare_< comma::int64 >( p, q ) : compare_< double >( p, q );
+                        p += sizeof( double );
+                        q += sizeof( double );
+                        break;
+                    case category::time:
+                        c = compare_< comma::int64 >( p, q );
+                        if( c == 0 ) { c = compare_< comma::uint32 >( p + sizeof( comma::int64 ), q + sizeof( comma::int64 ) ); }
+                        p += sizeof( comma::int64 ) + sizeof( comma::uint32 );
+                        q += sizeof( comma::int64 ) + sizeof( comma::uint32 );
+                        break;
+                    case category::string:
+                    {
+                        comma::uint32 m, n;
+                        ::memcpy( &m, p, sizeof( comma::uint32 ) );
+                        ::memcpy( &n, q, sizeof( comma::uint32 ) );
+                        p += sizeof( comma::uint32 );
+                        q += sizeof( comma::uint32 );
+                        c = ::memcmp( p, q, std::min( m, n ) );
+                        if( c == 0 ) { c = m < n ? -1 : n < m ? 1 : 0; }
+                        p += m;
+                        q += n;
+                        break;
+                    }
+                }
+                if( c != 0 ) { return c < 0 ? -1 : 1; }
+            }
+            return 0;
+        }
+        
+    private:
+        std::vector< std::size_t > indices_;
+        std::vector< category::values > categories_;
+        double tolerance_;
+        bool binary_;
+        bool variable_size_;
+        bool tolerant_;
+        comma::csv::format format_;
+        mutable std::vector< comma::csv::format::element > elements_;
+        
+        template < typename T > static void append_( const T& t, std::string& bytes ) { bytes.append( reinterpret_cast< const char* >( &t ), sizeof( T ) ); }
+        
+        template < typename T > static int compare_( const char* p, const char* q )
+        {
+            T a, b;
+            ::memcpy( &a, p, sizeof( T ) );
+            ::memcpy( &b, q, sizeof( T ) );
+            return a < b ? -1 : b < a ? 1 : 0;
+        }
+        
+        static void append_string_( const char* s, comma::uint32 size, std::string& bytes ) { append_( size, bytes ); bytes.append( s, size ); } // length first, so that string keys concatenate unambiguously
+        
+        static void append_time_( const comma::time& t, std::string& bytes ) { append_( t.microseconds(), bytes ); append_( t.nanoseconds(), bytes ); }
+        
+        void append_double_( double d, std::string& bytes ) const
+        {
+            if( tolerance_ > 0 ) { append_( comma::int64( std::floor( d / tolerance_ ) ), bytes ); return; } // values in the same bucket match
+            if( d == 0 ) { d = 0; } // -0 and 0 match
+            append_( d, bytes );
+        }
+        
+        static comma::int64 integer_( const char* p, comma::csv::format::types_enum type )
+        {
+            switch( type )
+            {
+                case comma::csv::format::char_t: case comma::csv::format::int8: return comma::csv::format::traits< char >::from_bin( p );
+                case comma::csv::format::uint8: return comma::csv::format::traits< unsigned char >::from_bin( p );
+                case comma::csv::format::int16: return comma::csv::format::traits< comma::int16 >::from_bin( p );
+                case comma::csv::format::uint16: return comma::csv::format::traits< comma::uint16 >::from_bin( p );
+                case comma::csv::format::int32: return comma::csv::format::traits< comma::int32 >::from_bin( p );
+                case comma::csv::format::uint32: return comma::csv::format::traits< comma::uint32 >::from_bin( p );
+                case comma::csv::format::int64: return comma::csv::format::traits< comma::int64 >::from_bin( p );
+                case comma::csv::format::uint64: return static_cast< comma::int64 >( comma::csv::format::traits< comma::uint64 >::from_bin( p ) );
+                default: COMMA_THROW( comma::exception, "expected integer type, got " << comma::csv::format::to_format( type ) );
+            }
+        }
+        
+        void append_( const char* buf, const comma::csv::format::element& e, category::values c, std::string& bytes ) const
+        {
+            const char* p = buf + e.offset;
+            char swapped[16];
+            if( e.swapped() ) { ::memcpy( swapped, p, e.size ); comma::csv::impl::byte_swap( swapped, e.type ); p = swapped; }
+            switch( c )
+            {
+                case category::integer:
+                    append_( integer_( p, e.type ), bytes );
+                    break;
+                case category::floating_point:
+                    switch( e.type )
+                    {
+                        case comma::csv::format::float_t: append_double_( comma::csv::format::traits< float >::from_bin( p ), bytes ); break;
+                        case comma::csv::format::double_t: append_double_( comma::csv::format::traits< double >::from_bin( p ), bytes ); break;
+                        case comma::csv::format::half_t: append_double_( comma::csv::impl::half_to_float( comma::csv::format::traits< comma::uint16 >::from_bin( p ) ), bytes ); break;
+                        default: append_double_( e.scaled() ? comma::csv::impl::scaled_from_bin( p, e ) : double( integer_( p, e.type ) ), bytes ); break;
+                    }
+                    break;
+                case category::time:
+                    append_time_( e.type == comma::csv::format::time ? comma::csv::format::traits< comma::time, comma::csv::format::time >::from_bin( p ) : comma::csv::format::traits< comma::time, comma::csv::format::long_time >::from_bin( p ), bytes );
+                    break;
+                case category::string: // for variable size strings, offset and size are those of the string itself
+                    append_string_( p, e.type == comma::csv::format::fixed_string ? ::strnlen( p, e.size ) : e.size, bytes );
+                    break;
+            }
+        }
+        
+        void append_default_( category::values c, std::string& bytes ) const // as default-constructed fields of a csv stream
+        {
+            switch( c )
+            {
+                case category::integer: append_( comma::int64( 0 ), bytes ); break;
+                case category::floating_point: append_double_( 0, bytes ); break;
+                case category::time: append_time_( comma::time(), bytes ); break;
+                case category::string: append_string_( "", 0, bytes ); break;
+            }
+        }
+        
+        void append_( const std::string& s, category::values c, std::string& bytes ) const
+        {
+            switch( c )
+            {
+                case category::integer:
+                    try { append_( !s.empty() && s[0] == '-' ? boost::lexical_cast< comma::int64 >( s ) : static_cast< comma::int64 >( boost::lexical_cast< comma::uint64 >( s ) ), bytes ); }
+                    catch( boost::bad_lexical_cast& ) { if( tolerant_ ) { throw; } COMMA_THROW( comma::exception, "expected integer key, got \"" << s << "\"; for keys of other types use --format, e.g. --format=s" ); }
+                    break;
+                case category::floating_point:
+                    append_double_( boost::lexical_cast< double >( s ), bytes );
+                    break;
+                case category::time:
+                    append_time_( comma::time::from_iso_string( s ), bytes );
+                    break;
+                case category::string:
+                    append_string_( s.c_str(), s.size(), bytes );
+                    break;
+            }
+        }
+        
+    public:
+        static comma::uint64 hash( const std::string& bytes ) // fnv-1a followed by murmur3 finalizer to mix high bits
+        {
+            comma::uint64 h = 14695981039346656037ULL;
+            for( std::size_t i = 0; i < bytes.size(); ++i ) { h ^= static_cast< unsigned char >( bytes[i] ); h *= 1099511628211ULL; }
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            return h;
+        }
+};
+
 static bool verbose;
 static comma::signal_flag is_shutdown;
 static boost::scoped_ptr< comma::io::istream > filter_transport;
@@ -115,49 +397,930 @@ static boost::scoped_ptr< comma::csv::input_stream< input > > stdin_stream;
 static boost::scoped_ptr< comma::csv::input_stream< input > > filter_stream;
 static comma::csv::options stdin_csv;
 static comma::csv::options filter_csv;
+static boost::scoped_ptr< keys > stdin_keys;
+static boost::scoped_ptr< keys > filter_keys;
+static boost::scoped_ptr< keys > stdin_coordinates;
+static boost::scoped_ptr< keys > filter_coordinates;
+
+/// numbers of records with key fields that failed to convert
+struct key_errors
+{
+    comma::uint64 skipped;
+    comma::uint64 defaulted;
+    key_errors() : skipped( 0 ), defaulted( 0 ) {}
+};
+
+static key_errors stdin_errors;
+static key_errors filter_errors;
+
+/// apply --on-error to a record, for which keys::make() returned converted; return true, if the record is to be used
+static bool tolerated_( bool converted, key_errors& errors )
+{
+    if( converted ) { return true; }
+    if( stdin_csv.on_error == comma::csv::options::on_error_skip ) { ++errors.skipped; return false; }
+    ++errors.defaulted;
+    return true;
+}
+static double radius;
+static bool nearest;
 static bool first_matching;
+static bool semi;
+static bool anti;
+static bool sorted;
+static comma::uint64 memory_limit;
+static std::string temp_directory;
 
-struct input::Hash : public std::unary_function< input, std::size_t >
+/// filter records of the current block: records and keys are appended to one contiguous
+/// buffer, which is reused from block to block; records of the same key are chained by
+/// offsets in the order they were added; keys are found by open addressing on their hash
+class FilterMap
 {
-    std::size_t operator()( input const& p ) const
-    {
-        std::size_t seed = 0;
-        for( std::size_t i = 0; i < input::keys_size; ++i ) { boost::hash_combine( seed, p.keys[i] ); }
-        return seed;
-    }
+    public:
+        static const comma::uint64 none = comma::uint64( -1 );
+        static const std::size_t npos = std::size_t( -1 );
+        
+        static const comma::uint64 present = none - 1; /// "first record" of keys inserted without records
+        
+        FilterMap() : size_( 0 ), slots_( 1024 ), shift_( 54 ), generation_( 1 ), bloom_( 1024 / 8, 0 ) {}
+        
+        /// append record of given size for given key; return buffer to copy the record to
+        /// (valid until the next append)
+        char* append( const key& k, std::size_t size )
+        {
+            Entry& e = entry_( k );
+            comma::uint64 r = reserve_( header_size + size );
+            header_( r, none, size );
+            if( e.last == none ) { e.first = r; } else { set_next_( e.last, r ); }
+            e.last = r;
+            return &buffer_[ r + header_size ];
+        }
+        
+        /// insert key without records, e.g. for semi-join: find() will return present for it
+        void insert( const key& k ) { Entry& e = entry_( k ); e.first = present; }
+        
+        /// return offset of the first record for given key or none
+        comma::uint64 find( const key& k ) const { const Entry* e = find_( k ); return e ? e->first : none; }
+        
+        /// return index of given key or npos; unlike find(), does not touch anything that erase() modifies,
+        /// thus can be called from several threads, while another thread erases
+        std::size_t index( const key& k ) const { const Entry* e = find_( k ); return e ? std::size_t( e - &entries_[0] ) : npos; }
+        
+        /// return offset of the first record of key with given index or none
+        comma::uint64 first( std::size_t index ) const { return entries_[index].first; }
+        
+        /// remove records of given key
+        void erase( const key& k ) { Entry* e = find_( k ); if( e ) { e->first = none; } }
+        
+        /// remove records of key with given index
+        void erase( std::size_t index ) { entries_[index].first = none; }
+        
+        /// record at given offset
+        const char* data( comma::uint64 record ) const { return &buffer_[ record + header_size ]; }
+        comma::uint32 size( comma::uint64 record ) const { comma::uint32 s; ::memcpy( &s, &buffer_[ record + sizeof( comma::uint64 ) ], sizeof( comma::uint32 ) ); return s; }
+        comma::uint64 next( comma::uint64 record ) const { comma::uint64 n; ::memcpy( &n, &buffer_[ record ], sizeof( comma::uint64 ) ); return n; }
+        
+        /// return number of keys
+        std::size_t size() const { return entries_.size(); }
+        
+        /// get i-th key in the order of insertion; return offset of its first record
+        comma::uint64 entry( std::size_t i, key& k ) const
+        {
+            const Entry& e = entries_[i];
+            k.bytes.assign( &buffer_[ e.key ], e.key_size );
+            k.hash = e.hash;
+            return e.first;
+        }
+        
+        /// return memory used, roughly
+        comma::uint64 bytes() const { return buffer_.size() + entries_.capacity() * sizeof( Entry ) + slots_.size() * sizeof( Slot ) + bloom_.size() * sizeof( comma::uint64 ); }
+        
+        bool empty() const { return entries_.empty(); }
+        
+        void swap( FilterMap& rhs )
+        {
+            buffer_.swap( rhs.buffer_ );
+            std::swap( size_, rhs.size_ );
+            entries_.swap( rhs.entries_ );
+            slots_.swap( rhs.slots_ );
+            std::swap( shift_, rhs.shift_ );
+            std::swap( generation_, rhs.generation_ );
+            bloom_.swap( rhs.bloom_ );
+        }
+        
+        /// remove all records and keys, keeping the memory
+        void clear()
+        {
+            size_ = 0;
+            entries_.clear();
+            if( ++generation_ == 0 ) { slots_.assign( slots_.size(), Slot() ); generation_ = 1; } // generation wrapped around
+            std::fill( bloom_.begin(), bloom_.end(), 0 );
+        }
+        
+    private:
+        enum { header_size = sizeof( comma::uint64 ) + sizeof( comma::uint32 ) }; // offset of the next record of the same key; record size
+        struct Entry
+        {
+            comma::uint64 hash;
+            comma::uint64 key; // offset of key bytes
+            comma::uint64 key_size;
+            comma::uint64 first;
+            comma::uint64 last;
+        };
+        struct Slot
+        {
+            comma::uint32 generation;
+            comma::uint32 index;
+            Slot() : generation( 0 ), index( 0 ) {}
+        };
+        std::vector< char > buffer_;
+        comma::uint64 size_;
+        std::vector< Entry > entries_;
+        std::vector< Slot > slots_;
+        unsigned int shift_;
+        comma::uint32 generation_;
+        std::vector< comma::uint64 > bloom_; // blocked bloom filter of keys, one word per 8 slots; rejects most absent keys in one memory access
+        
+        std::size_t slot_( comma::uint64 hash ) const { return hash >> shift_; }
+        
+        comma::uint64& bloom_word_( comma::uint64 hash ) { return bloom_[ slot_( hash ) >> 3 ]; }
+        const comma::uint64& bloom_word_( comma::uint64 hash ) const { return bloom_[ slot_( hash ) >> 3 ]; }
+        
+        static comma::uint64 bloom_mask_( comma::uint64 hash ) // 4 bits from the lower 24 bits of the hash, which slots do not use
+        {
+            return ( comma::uint64( 1 ) << ( hash & 63 ) ) | ( comma::uint64( 1 ) << ( ( hash >> 6 ) & 63 ) ) | ( comma::uint64( 1 ) << ( ( hash >> 12 ) & 63 ) ) | ( comma::uint64( 1 ) << ( ( hash >> 18 ) & 63 ) );
+        }
+        
+        const Entry* find_( const key& k ) const
+        {
+            comma::uint64 mask = bloom_mask_( k.hash );
+            if( ( bloom_word_( k.hash ) & mask ) != mask ) { return NULL; }
+            for( std::size_t i = slot_( k.hash ); slots_[i].generation == generation_; i = ( i + 1 ) & ( slots_.size() - 1 ) )
+            {
+                const Entry& e = entries_[ slots_[i].index ];
+                if( e.hash == k.hash && e.key_size == k.bytes.size() && ::memcmp( &buffer_[ e.key ], &k.bytes[0], e.key_size ) == 0 ) { return &e; }
+            }
+            return NULL;
+        }
+        
+        Entry* find_( const key& k ) { return const_cast< Entry* >( static_cast< const FilterMap* >( this )->find_( k ) ); }
+        
+        Entry& entry_( const key& k ) // find or add key
+        {
+            Entry* e = find_( k );
+            if( e ) { return *e; }
+            if( ( entries_.size() + 1 ) * 2 > slots_.size() ) { rehash_(); }
+            Entry f;
+            f.hash = k.hash;
+            f.key = reserve_( k.bytes.size() );
+            f.key_size = k.bytes.size();
+            f.first = none;
+            f.last = none;
+            ::memcpy( &buffer_[ f.key ], &k.bytes[0], k.bytes.size() );
+            entries_.push_back( f );
+            place_( entries_.size() - 1 );
+            return entries_.back();
+        }
+        
+        comma::uint64 reserve_( std::size_t size ) // buffer grows geometrically and never shrinks
+        {
+            comma::uint64 offset = size_;
+            size_ += size;
+            if( size_ > buffer_.size() ) { buffer_.resize( std::max( size_, comma::uint64( buffer_.size() * 2 ) ) ); }
+            return offset;
+        }
+        
+        void header_( comma::uint64 record, comma::uint64 next, comma::uint32 size )
+        {
+            ::memcpy( &buffer_[ record ], &next, sizeof( comma::uint64 ) );
+            ::memcpy( &buffer_[ record + sizeof( comma::uint64 ) ], &size, sizeof( comma::uint32 ) );
+        }
+        
+        void set_next_( comma::uint64 record, comma::uint64 next ) { ::memcpy( &buffer_[ record ], &next, sizeof( comma::uint64 ) ); }
+        
+        void place_( std::size_t index )
+        {
+            std::size_t i = slot_( entries_[index].hash );
+            while( slots_[i].generation == generation_ ) { i = ( i + 1 ) & ( slots_.size() - 1 ); }
+            slots_[i].generation = generation_;
+            slots_[i].index = index;
+            bloom_word_( entries_[index].hash ) |= bloom_mask_( entries_[index].hash );
+        }
+        
+        void rehash_()
+        {
+            slots_.assign( slots_.size() * 2, Slot() );
+            bloom_.assign( slots_.size() / 8, 0 );
+            --shift_;
+            for( std::size_t i = 0; i < entries_.size(); ++i ) { place_( i ); }
+        }
 };
 
-//typedef boost::unordered_map< input, std::deque< std::string >, input::Hash > FilterMap;
-typedef boost::unordered_map< input, std::vector< std::string >, input::Hash > FilterMap;
 FilterMap filter_map;
 static comma::uint32 block;
 
-void read_filter_block_()
+static std::size_t ascii_size_( const std::vector< std::string >& v )
+{
+    std::size_t size = v.size() - 1;
+    for( std::size_t i = 0; i < v.size(); ++i ) { size += v[i].size(); }
+    return size;
+}
+
+static void ascii_copy_( const std::vector< std::string >& v, char* buf ) // same as comma::join, without making a string
+{
+    for( std::size_t i = 0; i < v.size(); ++i )
+    {
+        if( i > 0 ) { *buf++ = stdin_csv.delimiter; }
+        ::memcpy( buf, v[i].data(), v[i].size() );
+        buf += v[i].size();
+    }
+}
+
+/// temporary file holding records of one partition of a spilled block: key hash, key, and record
+/// (the file is removed as soon as created, so that it gets deleted when closed or on exit)
+class partition
+{
+    public:
+        partition() : file_( NULL ), size_( 0 )
+        {
+            std::string name = temp_directory + "/csv-join.XXXXXX";
+            int fd = ::mkstemp( &name[0] );
+            if( fd < 0 ) { COMMA_THROW( comma::exception, "failed to create temporary file in " << temp_directory ); }
+            ::unlink( name.c_str() );
+            file_ = ::fdopen( fd, "w+b" );
+            if( !file_ ) { ::close( fd ); COMMA_THROW( comma::exception, "failed to open temporary file in " << temp_directory ); }
+            ::setvbuf( file_, NULL, _IOFBF, 65536 );
+        }
+        
+        ~partition() { ::fclose( file_ ); }
+        
+        void write( const key& k, const char* buf, comma::uint32 size )
+        {
+            comma::uint32 key_size = k.bytes.size();
+            write_( &k.hash, sizeof( comma::uint64 ) );
+            write_( &key_size, sizeof( comma::uint32 ) );
+            write_( &k.bytes[0], key_size );
+            write_( &size, sizeof( comma::uint32 ) );
+            write_( buf, size );
+        }
+        
+        /// read next record; return false on end of file
+        bool read( key& k, std::string& record )
+        {
+            comma::uint32 size;
+            if( ::fread( &k.hash, sizeof( comma::uint64 ), 1, file_ ) != 1 ) { return false; }
+            read_( &size, sizeof( comma::uint32 ) );
+            k.bytes.resize( size );
+            read_( &k.bytes[0], size );
+            read_( &size, sizeof( comma::uint32 ) );
+            record.resize( size );
+            if( size > 0 ) { read_( &record[0], size ); }
+            return true;
+        }
+        
+        /// start reading from the beginning
+        void rewind() { ::fflush( file_ ); ::rewind( file_ ); }
+        
+        /// return number of bytes written
+        comma::uint64 size() const { return size_; }
+        
+    private:
+        std::FILE* file_;
+        comma::uint64 size_;
+        
+        void write_( const void* buf, std::size_t size )
+        {
+            if( size > 0 && ::fwrite( buf, size, 1, file_ ) != 1 ) { COMMA_THROW( comma::exception, "failed to write temporary file in " << temp_directory ); }
+            size_ += size;
+        }
+        
+        void read_( void* buf, std::size_t size ) { if( ::fread( buf, size, 1, file_ ) != 1 ) { COMMA_THROW( comma::exception, "failed to read temporary file in " << temp_directory ); } }
+};
+
+static bool join_( const char* left, std::size_t left_size, comma::uint64 r );
+
+/// grace hash join of a block that does not fit in memory: filter and stdin records of the
+/// block are partitioned by key hash into temporary files, then joined partition by partition;
+/// a partition that still does not fit gets partitioned again on other bits of the hash
+class spill
+{
+    public:
+        enum { fan_out = 64, bits = 6, levels = 4 };
+        
+        spill( unsigned int level = 0 ) : level_( level ), filter_( fan_out ), stdin_( fan_out ) {}
+        
+        void push_filter( const key& k, const char* buf, std::size_t size ) { partition_( filter_, k ).write( k, buf, size ); }
+        
+        void push_stdin( const key& k, const char* buf, std::size_t size ) { partition_( stdin_, k ).write( k, buf, size ); }
+        
+        /// join partitions and output matches; return number of stdin records without matches
+        comma::uint64 join()
+        {
+            comma::uint64 discarded = 0;
+            key k;
+            std::string record;
+            for( unsigned int i = 0; i < fan_out && !is_shutdown; ++i )
+            {
+                if( !filter_[i] ) { if( stdin_[i] ) { stdin_[i]->rewind(); while( stdin_[i]->read( k, record ) ) { if( !join_( &record[0], record.size(), FilterMap::none ) ) { ++discarded; } } } continue; }
+                filter_[i]->rewind();
+                if( stdin_[i] ) { stdin_[i]->rewind(); }
+                if( filter_[i]->size() > memory_limit && level_ + 1 < levels ) // too big: partition further
+                {
+                    if( verbose ) { std::cerr << "csv-join: partition " << i << " at level " << level_ << " of " << filter_[i]->size() << " byte(s) exceeds memory limit; partitioning further" << std::endl; }
+                    spill s( level_ + 1 );
+                    while( filter_[i]->read( k, record ) ) { s.push_filter( k, &record[0], record.size() ); }
+                    if( stdin_[i] ) { while( stdin_[i]->read( k, record ) ) { s.push_stdin( k, &record[0], record.size() ); } }
+                    filter_[i].reset();
+                    stdin_[i].reset();
+                    discarded += s.join();
+                    continue;
+                }
+                filter_map.clear();
+                while( filter_[i]->read( k, record ) )
+                {
+                    if( semi || anti ) { filter_map.insert( k ); }
+                    else { ::memcpy( filter_map.append( k, record.size() ), &record[0], record.size() ); }
+                }
+                filter_[i].reset();
+                if( !stdin_[i] ) { continue; }
+                while( stdin_[i]->read( k, record ) && !is_shutdown )
+                {
+                    comma::uint64 r = filter_map.find( k );
+                    if( !join_( &record[0], record.size(), r ) ) { ++discarded; }
+                    if( first_matching && r != FilterMap::none ) { filter_map.erase( k ); }
+                }
+                stdin_[i].reset();
+            }
+            filter_map.clear();
+            return discarded;
+        }
+        
+    private:
+        unsigned int level_;
+        std::vector< boost::shared_ptr< partition > > filter_;
+        std::vector< boost::shared_ptr< partition > > stdin_;
+        
+        /// partition by bits 24 to 47 of hash, 6 bits per level: keys of a partition share them, thus they must not be
+        /// the lower 24 bits, which select the bloom filter bits of a key, nor the high bits, which select its slot
+        partition& partition_( std::vector< boost::shared_ptr< partition > >& partitions, const key& k )
+        {
+            boost::shared_ptr< partition >& p = partitions[ ( k.hash >> ( 24 + level_ * bits ) ) & ( fan_out - 1 ) ];
+            if( !p ) { p.reset( new partition ); }
+            return *p;
+        }
+};
+
+static boost::scoped_ptr< spill > spilled;
+
+static void spill_filter_map_() // move filter records loaded so far to partitions
+{
+    if( verbose ) { std::cerr << "csv-join: block " << block << " exceeds memory limit of " << memory_limit << " byte(s); spilling to " << temp_directory << std::endl; }
+    spilled.reset( new spill );
+    key k;
+    for( std::size_t i = 0; i < filter_map.size(); ++i )
+    {
+        comma::uint64 r = filter_map.entry( i, k );
+        if( semi || anti ) { spilled->push_filter( k, NULL, 0 ); continue; }
+        for( ; r != FilterMap::none; r = filter_map.next( r ) ) { spilled->push_filter( k, filter_map.data( r ), filter_map.size( r ) ); }
+    }
+    filter_map.clear();
+}
+
+static comma::uint64 join_spilled_()
+{
+    if( !spilled ) { return 0; }
+    comma::uint64 discarded = spilled->join();
+    spilled.reset();
+    return discarded;
+}
+
+static void output_( const char* left, std::size_t left_size, const char* right, std::size_t right_size );
+static void output_( const char* left, std::size_t left_size );
+
+/// spatial join: filter records are hashed by their keys and the grid cell of their coordinates,
+/// with cell size equal to the radius; each filter record is stored with its coordinates in front
+
+/// make key of given keys and grid cell of given coordinates shifted by given offset in cells
+static void cell_key_( const key& k, const double* coordinates, std::size_t dimensions, const int* offset, key& cell )
+{
+    cell.bytes = k.bytes;
+    for( std::size_t i = 0; i < dimensions; ++i )
+    {
+        comma::int64 n = comma::int64( std::floor( coordinates[i] / radius ) ) + offset[i];
+        cell.bytes.append( reinterpret_cast< const char* >( &n ), sizeof( comma::int64 ) );
+    }
+    cell.hash = keys::hash( cell.bytes );
+}
+
+/// append filter record of given size with given keys and coordinates; return buffer to copy the record to
+static char* spatial_append_( FilterMap& map, const key& k, const key& coordinates, std::size_t size, key& cell )
+{
+    static const int offset[] = { 0, 0, 0 };
+    double c[3];
+    ::memcpy( c, &coordinates.bytes[0], coordinates.bytes.size() );
+    cell_key_( k, c, coordinates.bytes.size() / sizeof( double ), offset, cell );
+    char* buf = map.append( cell, coordinates.bytes.size() + size );
+    ::memcpy( buf, &coordinates.bytes[0], coordinates.bytes.size() );
+    return buf + coordinates.bytes.size();
+}
+
+/// output stdin record with given keys and coordinates joined with filter records within radius,
+/// as per join mode; return false, if the stdin record is discarded
+static bool spatial_join_( const char* left, std::size_t left_size, const key& k, const key& coordinates, key& cell )
+{
+    std::size_t dimensions = coordinates.bytes.size() / sizeof( double );
+    double c[3];
+    ::memcpy( c, &coordinates.bytes[0], coordinates.bytes.size() );
+    unsigned int cells = 1;
+    for( std::size_t i = 0; i < dimensions; ++i ) { cells *= 3; }
+    bool found = false;
+    double squared_radius = radius * radius;
+    double best = 0;
+    comma::uint64 best_record = FilterMap::none;
+    std::size_t header = dimensions * sizeof( double );
+    for( unsigned int n = 0; n < cells && !( found && ( semi || anti ) ); ++n ) // current cell and its neighbours
+    {
+        int offset[3];
+        for( std::size_t i = 0, m = n; i < dimensions; ++i, m /= 3 ) { offset[i] = int( m % 3 ) - 1; }
+        cell_key_( k, c, dimensions, offset, cell );
+        for( comma::uint64 r = filter_map.find( cell ); r != FilterMap::none; r = filter_map.next( r ) )
+        {
+            double d[3];
+            ::memcpy( d, filter_map.data( r ), header );
+            double squared_distance = 0;
+            for( std::size_t i = 0; i < dimensions; ++i ) { squared_distance += ( d[i] - c[i] ) * ( d[i] - c[i] ); }
+            if( squared_distance > squared_radius ) { continue; }
+            if( nearest && found && ( squared_distance > best || ( squared_distance == best && r > best_record ) ) ) { continue; } // ties: record appended first, i.e. first in input
+            found = true;
+            if( semi || anti ) { break; }
+            if( nearest ) { best = squared_distance; best_record = r; continue; }
+            output_( left, left_size, filter_map.data( r ) + header, filter_map.size( r ) - header );
+        }
+    }
+    if( anti ) { if( !found ) { output_( left, left_size ); } return !found; }
+    if( !found ) { return false; }
+    if( semi ) { output_( left, left_size ); }
+    else if( nearest ) { output_( left, left_size, filter_map.data( best_record ) + header, filter_map.size( best_record ) - header ); }
+    return true;
+}
+
+/// read next block of filter records into given map; return false, if there are no more filter records
+/// (a block exceeding memory limit gets spilled, which is supported only for filter_map)
+static bool read_filter_block_( FilterMap& map, comma::uint32& block, const volatile bool* stop = NULL )
 {
     static const input* last = filter_stream->read();
-    if( !last ) { return; }
+    map.clear(); // also if no more filter records: stdin records of the following blocks have no matches
+    if( !last ) { return false; }
     block = last->block;
-    filter_map.clear();
     comma::uint64 count = 0;
-    while( last->block == block && !is_shutdown )
+    key k;
+    key coordinates;
+    key cell;
+    std::string record;
+    while( last->block == block && !is_shutdown && !( stop && *stop ) )
     {
         if( filter_stream->is_binary() )
         {
-            FilterMap::mapped_type& d = filter_map[ *last ];
-            d.push_back( std::string() );
-            d.back().resize( filter_csv.format().size() );
-            ::memcpy( &d.back()[0], filter_stream->binary().last(), filter_csv.format().size() );
+            filter_keys->make( filter_stream->binary().last(), k );
+            if( radius > 0 )
+            {
+                filter_coordinates->make( filter_stream->binary().last(), coordinates );
+                std::size_t size = ( semi || anti ) ? 0 : filter_stream->binary().last_size();
+                ::memcpy( spatial_append_( map, k, coordinates, size, cell ), filter_stream->binary().last(), size );
+            }
+            else if( spilled ) { spilled->push_filter( k, filter_stream->binary().last(), ( semi || anti ) ? 0 : filter_stream->binary().last_size() ); }
+            else if( semi || anti ) { map.insert( k ); }
+            else { ::memcpy( map.append( k, filter_stream->binary().last_size() ), filter_stream->binary().last(), filter_stream->binary().last_size() ); }
         }
         else
         {
-            filter_map[ *last ].push_back( comma::join( filter_stream->ascii().last(), stdin_csv.delimiter ) );
-        }        
-        if( verbose ) { ++count; if( count % 10000 == 0 ) { std::cerr << "csv-join: reading block " << block << "; loaded " << count << " point[s]; hash map size: " << filter_map.size() << std::endl; } }
+            const std::vector< std::string >& v = filter_stream->ascii().last();
+            bool converted = filter_keys->make( v, k );
+            if( radius > 0 ) { converted = filter_coordinates->make( v, coordinates ) && converted; }
+            if( tolerated_( converted, filter_errors ) )
+            {
+                if( radius > 0 )
+                {
+                    std::size_t size = ( semi || anti ) ? 0 : ascii_size_( v );
+                    char* buf = spatial_append_( map, k, coordinates, size, cell );
+                    if( size > 0 ) { ascii_copy_( v, buf ); }
+                }
+                else if( spilled ) { record = ( semi || anti ) ? std::string() : comma::join( v, stdin_csv.delimiter ); spilled->push_filter( k, &record[0], record.size() ); }
+                else if( semi || anti ) { map.insert( k ); }
+                else { ascii_copy_( v, map.append( k, ascii_size_( v ) ) ); }
+            }
+        }
+        if( memory_limit > 0 && !spilled && map.bytes() > memory_limit ) { spill_filter_map_(); }
+        if( verbose ) { ++count; if( count % 10000 == 0 ) { std::cerr << "csv-join: reading block " << block << "; loaded " << count << " point[s]; hash map size: " << map.size() << std::endl; } }
         //if( ( *filter_transport )->good() && !( *filter_transport )->eof() ) { break; }
         last = filter_stream->read();
         if( !last ) { break; }
     }
-    if( verbose ) { std::cerr << "csv-join: read block " << block << " of " << count << " point[s]; hash map size: " << filter_map.size() << std::endl; }
+    if( verbose ) { std::cerr << "csv-join: read block " << block << " of " << count << " point[s]; hash map size: " << map.size() << std::endl; }
+    return true;
+}
+
+/// reads filter blocks on a background thread: while the current block is probed,
+/// the next one is loaded into the second table, which then gets swapped with filter_map
+class Prefetch
+{
+    public:
+        Prefetch() : ready_( false ), loaded_( false ), done_( false ), block_( 0 ) { thread_.reset( new boost::thread( boost::bind( &Prefetch::run_, this ) ) ); }
+        
+        ~Prefetch()
+        {
+            {
+                boost::mutex::scoped_lock lock( mutex_ );
+                done_ = true;
+                condition_.notify_all();
+            }
+            thread_->join();
+        }
+        
+        /// wait for the next block and swap it into filter_map; return false, if there are no more filter records
+        bool next()
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            while( !ready_ ) { condition_.wait( lock ); }
+            if( !error_.empty() ) { COMMA_THROW( comma::exception, error_ ); }
+            if( !loaded_ ) { filter_map.clear(); return false; }
+            filter_map.swap( next_ );
+            block = block_;
+            ready_ = false;
+            condition_.notify_all();
+            return true;
+        }
+        
+    private:
+        FilterMap next_;
+        bool ready_;
+        bool loaded_;
+        volatile bool done_;
+        comma::uint32 block_;
+        std::string error_;
+        boost::mutex mutex_;
+        boost::condition_variable condition_;
+        boost::scoped_ptr< boost::thread > thread_;
+        
+        void run_()
+        {
+            while( true )
+            {
+                bool loaded = false;
+                std::string error;
+                try { loaded = read_filter_block_( next_, block_, &done_ ); }
+                catch( std::exception& ex ) { error = ex.what(); }
+                catch( ... ) { error = "unknown exception"; }
+                boost::mutex::scoped_lock lock( mutex_ );
+                loaded_ = loaded;
+                error_ = error;
+                ready_ = true;
+                condition_.notify_all();
+                if( !loaded || !error.empty() ) { return; }
+                while( ready_ && !done_ ) { condition_.wait( lock ); }
+                if( done_ ) { return; }
+            }
+        }
+};
+
+static boost::scoped_ptr< Prefetch > prefetch;
+
+/// read next block of filter records into filter_map, or take it from prefetch; return false, if there are no more filter records
+static bool next_filter_block_() { return prefetch ? prefetch->next() : read_filter_block_( filter_map, block ); }
+
+/// sort-merge join of streams sorted by block and then by key: the filter stream is
+/// read in lockstep with stdin, keeping in memory only the records of the current key
+/// (with --semi or --anti, only the key and the number of its records)
+class merge
+{
+    public:
+        merge() : has_group_( false ), has_next_( false ), has_last_( false ) { read_(); advance_(); }
+        
+        /// return true, if there are filter records left
+        bool empty() const { return !has_group_; }
+        
+        /// find filter records with given block and key; return their number, 0 if none
+        std::size_t find( comma::uint32 block, const key& k )
+        {
+            if( has_last_ && compare_( block, k, last_.block, last_.key ) < 0 ) { COMMA_THROW( comma::exception, "expected stdin sorted by block and key, got a key less than the previous one" ); }
+            has_last_ = true;
+            last_.block = block;
+            last_.key.bytes = k.bytes;
+            while( has_group_ && compare_( group_.block, group_.key, block, k ) < 0 ) { advance_(); }
+            return has_group_ && compare_( group_.block, group_.key, block, k ) == 0 ? group_.count : 0;
+        }
+        
+        /// return records found last; empty with --semi or --anti
+        const std::vector< std::string >& records() const { return group_.records; }
+        
+        /// discard records found last, e.g. for --first-matching
+        void erase() { group_.count = 0; group_.records.clear(); }
+        
+    private:
+        struct group
+        {
+            comma::uint32 block;
+            ::key key;
+            std::size_t count;
+            std::vector< std::string > records;
+            group() : block( 0 ), count( 0 ) {}
+        };
+        group group_;
+        group next_; // lookahead record read from the filter stream
+        group last_; // last stdin key, to check order
+        bool has_group_;
+        bool has_next_;
+        bool has_last_;
+        
+        static int compare_( comma::uint32 a_block, const key& a, comma::uint32 b_block, const key& b ) { return a_block < b_block ? -1 : b_block < a_block ? 1 : filter_keys->compare( a, b ); }
+        
+        bool read_()
+        {
+            while( true )
+            {
+                const input* p = filter_stream->read();
+                has_next_ = p != NULL;
+                if( !has_next_ ) { return false; }
+                next_.block = p->block;
+                next_.records.resize( semi || anti ? 0 : 1 );
+                if( filter_stream->is_binary() )
+                {
+                    filter_keys->make( filter_stream->binary().last(), next_.key );
+                    if( !next_.records.empty() ) { next_.records[0].assign( filter_stream->binary().last(), filter_stream->binary().last_size() ); }
+                }
+                else
+                {
+                    if( !tolerated_( filter_keys->make( filter_stream->ascii().last(), next_.key ), filter_errors ) ) { continue; }
+                    if( !next_.records.empty() ) { next_.records[0] = comma::join( filter_stream->ascii().last(), stdin_csv.delimiter ); }
+                }
+                return true;
+            }
+        }
+        
+        void advance_()
+        {
+            has_group_ = has_next_;
+            if( !has_group_ ) { return; }
+            group_.block = next_.block;
+            std::swap( group_.key, next_.key );
+            group_.count = 0;
+            group_.records.clear();
+            do
+            {
+                ++group_.count;
+                if( !next_.records.empty() ) { group_.records.push_back( std::string() ); std::swap( group_.records.back(), next_.records[0] ); }
+            }
+            while( read_() && next_.block == group_.block && filter_keys->compare( next_.key, group_.key ) == 0 );
+            if( has_next_ && compare_( next_.block, next_.key, group_.block, group_.key ) < 0 ) { COMMA_THROW( comma::exception, "expected " << filter_csv.filename << " sorted by block and key, got a key less than the previous one" ); }
+        }
+};
+
+static void output_( const char* left, std::size_t left_size, const char* right, std::size_t right_size )
+{
+    std::cout.write( left, left_size );
+    if( stdin_stream->is_binary() )
+    {
+        std::cout.write( right, right_size );
+        std::cout.flush();
+    }
+    else
+    {
+        std::cout << stdin_csv.delimiter;
+        std::cout.write( right, right_size );
+        std::cout << std::endl;
+    }
+}
+
+static void output_( const char* left, std::size_t left_size )
+{
+    std::cout.write( left, left_size );
+    if( stdin_stream->is_binary() ) { std::cout.flush(); } else { std::cout << std::endl; }
+}
+
+/// output stdin record as per join mode, given the first matching filter record r or none;
+/// return false, if the stdin record is discarded
+static bool join_( const char* left, std::size_t left_size, comma::uint64 r )
+{
+    if( anti ) { if( r == FilterMap::none ) { output_( left, left_size ); } return r == FilterMap::none; }
+    if( r == FilterMap::none ) { return false; }
+    if( semi ) { output_( left, left_size ); return true; }
+    for( ; r != FilterMap::none; r = first_matching ? FilterMap::none : filter_map.next( r ) ) { output_( left, left_size, filter_map.data( r ), filter_map.size( r ) ); }
+    return true;
+}
+
+static void report_errors_()
+{
+    if( !verbose ) { return; }
+    prefetch.reset(); // stop reading filter blocks, so that the counts are final
+    comma::uint64 skipped = stdin_stream->skipped() + stdin_errors.skipped;
+    comma::uint64 defaulted = stdin_stream->defaulted() + stdin_errors.defaulted;
+    if( skipped || defaulted ) { std::cerr << "csv-join: stdin: skipped " << skipped << " record[s], defaulted fields in " << defaulted << " record[s] on error" << std::endl; }
+    skipped = filter_stream->skipped() + filter_errors.skipped;
+    defaulted = filter_stream->defaulted() + filter_errors.defaulted;
+    if( skipped || defaulted ) { std::cerr << "csv-join: filter: skipped " << skipped << " record[s], defaulted fields in " << defaulted << " record[s] on error" << std::endl; }
+}
+
+static void stdin_record_( std::string& record )
+{
+    if( stdin_stream->is_binary() ) { record.assign( stdin_stream->binary().last(), stdin_stream->binary().last_size() ); }
+    else { record = comma::join( stdin_stream->ascii().last(), stdin_csv.delimiter ); }
+}
+
+/// probes filter map on worker threads: stdin records are read in rounds of one batch per thread;
+/// on each thread, records of a batch get parsed, their keys made and looked up in the filter map,
+/// which is read-only meanwhile; then the matches are written in the order of input
+///
+/// if a record of another block is encountered, probing stops there, so that the caller could read
+/// the next filter block and probe the rest of the round against it
+class Probes
+{
+    public:
+        Probes( unsigned int size, std::size_t batch_size )
+            : batch_size_( batch_size )
+            , batches_( size )
+            , pending_( 0 )
+            , round_( 0 )
+            , done_( false )
+            , record_size_( stdin_csv.binary() ? stdin_csv.format().size() : 0 )
+            , stopped_( 0 )
+            , forced_( false )
+            , check_block_( true )
+        {
+            if( stdin_csv.binary() && stdin_csv.format().is_variable_size() ) { COMMA_THROW( comma::exception, "--threads: variable size binary formats not supported" ); }
+            for( unsigned int i = 0; i < size; ++i ) { threads_.create_thread( boost::bind( &Probes::run_, this, i ) ); }
+        }
+        
+        ~Probes()
+        {
+            {
+                boost::mutex::scoped_lock lock( mutex_ );
+                done_ = true;
+                condition_.notify_all();
+            }
+            threads_.join_all();
+        }
+        
+        /// read next round of records from stdin; return false on end of stdin
+        bool read()
+        {
+            bool any = false;
+            for( std::size_t i = 0; i < batches_.size(); ++i ) { any = read_( batches_[i] ) || any; }
+            stopped_ = 0;
+            forced_ = false;
+            return any;
+        }
+        
+        /// probe records of the current round from where it stopped last time
+        /// and write matches; return true, if the round stopped at a record of another block
+        bool probe( comma::uint64& discarded )
+        {
+            {
+                boost::mutex::scoped_lock lock( mutex_ );
+                pending_ = batches_.size();
+                ++round_;
+                condition_.notify_all();
+                while( pending_ > 0 ) { condition_.wait( lock ); }
+                if( !error_.empty() ) { COMMA_THROW( comma::exception, error_ ); }
+            }
+            for( ; stopped_ < batches_.size(); ++stopped_ )
+            {
+                Batch& b = batches_[ stopped_ ];
+                for( std::size_t i = b.begin; i < b.end; ++i )
+                {
+                    std::size_t index = b.matches[i];
+                    comma::uint64 r = index == FilterMap::npos ? FilterMap::none : filter_map.first( index );
+                    const char* record = record_size_ ? &b.data[ i * record_size_ ] : &b.lines[i][0];
+                    std::size_t size = record_size_ ? record_size_ : b.lines[i].size();
+                    if( !join_( record, size, r ) ) { ++discarded; }
+                    if( first_matching && r != FilterMap::none ) { filter_map.erase( index ); }
+                }
+                b.begin = b.end;
+                if( b.end < b.size ) { forced_ = true; return true; } // the record at end is probed against the next filter block without checking its block
+            }
+            return false;
+        }
+        
+        /// stop checking blocks, e.g. when there are no more filter blocks to read
+        void ignore_blocks() { check_block_ = false; }
+        
+    private:
+        struct Batch
+        {
+            std::vector< std::string > lines; // ascii records
+            std::vector< char > data; // binary records
+            std::vector< std::size_t > matches; // index of matching key in filter map or npos
+            std::size_t size;
+            std::size_t begin;
+            std::size_t end;
+            Batch() : size( 0 ), begin( 0 ), end( 0 ) {}
+        };
+        std::size_t batch_size_;
+        std::vector< Batch > batches_;
+        std::size_t pending_;
+        comma::uint64 round_;
+        bool done_;
+        std::size_t record_size_;
+        std::size_t stopped_; // batch, in which probing stopped
+        bool forced_;
+        bool check_block_;
+        std::string error_;
+        boost::mutex mutex_;
+        boost::condition_variable condition_;
+        boost::thread_group threads_;
+        
+        bool read_( Batch& b )
+        {
+            b.size = 0;
+            b.begin = 0;
+            b.end = 0;
+            if( record_size_ )
+            {
+                b.data.resize( batch_size_ * record_size_ );
+                if( !std::cin.good() || std::cin.eof() ) { return false; }
+                std::cin.read( &b.data[0], b.data.size() );
+                std::size_t count = std::cin.gcount();
+                if( count % record_size_ ) { COMMA_THROW( comma::exception, "expected at least " << record_size_ << " bytes; got " << ( count % record_size_ ) ); }
+                b.size = count / record_size_;
+            }
+            else
+            {
+                b.lines.resize( batch_size_ );
+                while( b.size < batch_size_ && std::cin.good() && !std::cin.eof() )
+                {
+                    std::string& s = b.lines[ b.size ];
+                    std::getline( std::cin, s );
+                    if( !s.empty() && *s.rbegin() == '\r' ) { s.resize( s.length() - 1 ); } // windows... sigh...
+                    if( !s.empty() ) { ++b.size; }
+                }
+            }
+            b.matches.resize( b.size );
+            return b.size > 0;
+        }
+        
+        void run_( unsigned int i )
+        {
+            comma::uint64 round = 0;
+            keys k( *stdin_keys );
+            key probe;
+            input in;
+            comma::csv::ascii< input > ascii( stdin_csv );
+            boost::scoped_ptr< comma::csv::binary< input > > binary( record_size_ ? new comma::csv::binary< input >( stdin_csv ) : NULL );
+            while( true )
+            {
+                {
+                    boost::mutex::scoped_lock lock( mutex_ );
+                    while( round_ == round && !done_ ) { condition_.wait( lock ); }
+                    if( done_ ) { return; }
+                    round = round_;
+                }
+                std::string error;
+                try
+                {
+                    Batch& b = batches_[i];
+                    b.end = b.begin;
+                    if( i >= stopped_ )
+                    {
+                        for( ; b.end < b.size; ++b.end )
+                        {
+                            if( record_size_ )
+                            {
+                                const char* buf = &b.data[ b.end * record_size_ ];
+                                binary->get( in, buf );
+                                k.make( buf, probe );
+                            }
+                            else
+                            {
+                                std::vector< std::string > fields = comma::split( b.lines[ b.end ], stdin_csv.delimiter );
+                                ascii.get( in, fields );
+                                k.make( fields, probe );
+                            }
+                            bool forced = forced_ && i == stopped_ && b.end == b.begin;
+                            if( check_block_ && in.block != block && !forced ) { break; }
+                            b.matches[ b.end ] = filter_map.index( probe );
+                        }
+                    }
+                }
+                catch( std::exception& ex ) { error = ex.what(); }
+                catch( ... ) { error = "unknown exception"; }
+                boost::mutex::scoped_lock lock( mutex_ );
+                if( error_.empty() ) { error_ = error; }
+                --pending_;
+                condition_.notify_all();
+            }
+        }
+};
+
+static comma::uint64 bytes_( const std::string& s ) // e.g. 1000, 64k, 512M, 2G
+{
+    if( s.empty() ) { COMMA_THROW( comma::exception, "expected size, got empty string" ); }
+    comma::uint64 unit = 1;
+    switch( s[ s.size() - 1 ] )
+    {
+        case 'k': case 'K': unit = 1024; break;
+        case 'm': case 'M': unit = 1024 * 1024; break;
+        case 'g': case 'G': unit = 1024 * 1024 * 1024; break;
+        default: break;
+    }
+    return boost::lexical_cast< comma::uint64 >( unit == 1 ? s : s.substr( 0, s.size() - 1 ) ) * unit;
 }
 
 int main( int ac, char** av )
@@ -168,34 +1331,118 @@ int main( int ac, char** av )
         if( options.exists( "--help,-h,--long-help" ) ) { usage( options.exists( "--long-help" ) ); }
         verbose = options.exists( "--verbose,-v" );
         first_matching = options.exists( "--first-matching" );
+        semi = options.exists( "--semi" );
+        anti = options.exists( "--anti" );
+        if( semi && anti ) { std::cerr << "csv-join: --semi and --anti are mutually exclusive" << std::endl; return 1; }
+        sorted = options.exists( "--sorted" );
+        memory_limit = options.exists( "--memory-limit" ) ? bytes_( options.value< std::string >( "--memory-limit" ) ) : 0;
+        temp_directory = options.value< std::string >( "--temp-directory", ::getenv( "TMPDIR" ) ? ::getenv( "TMPDIR" ) : "/tmp" );
+        if( sorted && memory_limit > 0 ) { std::cerr << "csv-join: --sorted and --memory-limit are mutually exclusive" << std::endl; return 1; }
+        unsigned int threads = options.value< unsigned int >( "--threads", 1 );
+        if( threads == 0 ) { threads = boost::thread::hardware_concurrency(); }
+        if( options.exists( "--prefetch" ) && ( sorted || memory_limit > 0 ) ) { std::cerr << "csv-join: --prefetch: not supported with --sorted or --memory-limit" << std::endl; return 1; }
+        radius = options.value( "--radius", 0.0 );
+        nearest = options.exists( "--nearest" );
+        if( radius < 0 ) { std::cerr << "csv-join: expected positive radius, got " << radius << std::endl; return 1; }
+        if( nearest && radius == 0 ) { std::cerr << "csv-join: --nearest: please specify --radius" << std::endl; return 1; }
+        if( radius > 0 && ( sorted || memory_limit > 0 || threads > 1 || first_matching ) ) { std::cerr << "csv-join: --radius: not supported with --sorted, --memory-limit, --threads, or --first-matching" << std::endl; return 1; }
+        if( threads > 1 && ( sorted || memory_limit > 0 ) ) { std::cerr << "csv-join: --threads: not supported with --sorted or --memory-limit" << std::endl; return 1; }
         stdin_csv = comma::csv::options( options );
-        std::vector< std::string > unnamed = options.unnamed( "--verbose,-v,--first-matching", "--binary,-b,--delimiter,-d,--fields,-f" );
+        if( threads > 1 && stdin_csv.on_error != comma::csv::options::on_error_throw ) { std::cerr << "csv-join: --threads: not supported with --on-error=skip or --on-error=default" << std::endl; return 1; }
+        std::vector< std::string > unnamed = options.unnamed( "--verbose,-v,--first-matching,--sorted,--semi,--anti,--prefetch,--nearest", "--binary,-b,--delimiter,-d,--fields,-f,--format,--memory-limit,--temp-directory,--threads,--batch-size,--tolerance,--radius,--on-error" );
         if( unnamed.empty() ) { std::cerr << "csv-join: please specify the second source" << std::endl; return 1; }
         if( unnamed.size() > 1 ) { std::cerr << "csv-join: expected one file or stream to join, got " << comma::join( unnamed, ' ' ) << std::endl; return 1; }
         comma::name_value::parser parser( "filename", ';', '=', false );
         filter_csv = parser.get< comma::csv::options >( unnamed[0] );
+        filter_csv.on_error = stdin_csv.on_error;
         if( stdin_csv.binary() != filter_csv.binary() ) { std::cerr << "csv-join: expected both streams ascii or both streams binary" << std::endl; return 1; }
         std::vector< std::string > v = comma::split( stdin_csv.fields, ',' );
         std::vector< std::string > w = comma::split( filter_csv.fields, ',' );
+        std::vector< std::size_t > stdin_indices;
+        std::vector< std::size_t > filter_indices;
+        std::vector< std::string > names;
+        std::vector< std::size_t > stdin_coordinate_indices;
+        std::vector< std::size_t > filter_coordinate_indices;
         for( std::size_t i = 0; i < v.size(); ++i ) // quick and dirty, wasteful, but who cares
         { 
             if( v[i].empty() || v[i] == "block" ) { continue; }
             for( std::size_t k = 0; k < w.size(); ++k )
             {
                 if( v[i] != w[k] ) { continue; }
-                v[i] = "keys[" + boost::lexical_cast< std::string >( input::keys_size ) + "]";
-                w[k] = "keys[" + boost::lexical_cast< std::string >( input::keys_size ) + "]";
-                ++input::keys_size;
+                if( radius > 0 && ( v[i] == "x" || v[i] == "y" || v[i] == "z" ) )
+                {
+                    stdin_coordinate_indices.push_back( i );
+                    filter_coordinate_indices.push_back( k );
+                }
+                else
+                {
+                    names.push_back( v[i] );
+                    stdin_indices.push_back( i );
+                    filter_indices.push_back( k );
+                }
+                v[i] = "";
+                w[k] = "";
+                break;
             }
         }
-        if( input::keys_size == 0 ) { std::cerr << "csv-join: please specify at least one common key" << std::endl; return 1; }
-        stdin_csv.fields = comma::join( v, ',' );
-        filter_csv.fields = comma::join( w, ',' );
+        if( radius > 0 )
+        {
+            if( stdin_coordinate_indices.empty() ) { std::cerr << "csv-join: --radius: please specify coordinates x, y, and/or z on both sides" << std::endl; return 1; }
+            std::vector< category::values > c( stdin_coordinate_indices.size(), category::floating_point );
+            stdin_coordinates.reset( new keys( stdin_csv, stdin_coordinate_indices, c, 0 ) );
+            filter_coordinates.reset( new keys( filter_csv, filter_coordinate_indices, c, 0 ) );
+        }
+        else if( names.empty() ) { std::cerr << "csv-join: please specify at least one common key" << std::endl; return 1; }
+        std::vector< category::values > categories( names.size(), category::integer );
+        if( stdin_csv.binary() )
+        {
+            for( std::size_t i = 0; i < names.size(); ++i )
+            {
+                if( stdin_indices[i] >= stdin_csv.format().count() ) { std::cerr << "csv-join: key \"" << names[i] << "\" not in the format of stdin" << std::endl; return 1; }
+                if( filter_indices[i] >= filter_csv.format().count() ) { std::cerr << "csv-join: key \"" << names[i] << "\" not in the format of " << filter_csv.filename << std::endl; return 1; }
+                categories[i] = common_category( category_of( stdin_csv.format().offset( stdin_indices[i] ) ), category_of( filter_csv.format().offset( filter_indices[i] ) ), names[i] );
+            }
+        }
+        else if( options.exists( "--format" ) )
+        {
+            std::vector< std::string > f = comma::split( options.value< std::string >( "--format" ), ',' );
+            for( std::size_t i = 0; i < f.size(); ++i ) { if( f[i].empty() ) { f[i] = "l"; } } // allow hints for some keys only, e.g. --format=,,s; keys without hints stay integer
+            comma::csv::format format( comma::join( f, ',' ) );
+            for( std::size_t i = 0; i < names.size(); ++i ) { if( stdin_indices[i] < format.count() ) { categories[i] = category_of( format.offset( stdin_indices[i] ) ); } }
+        }
+        double tolerance = options.value( "--tolerance", 0.0 );
+        if( tolerance < 0 ) { std::cerr << "csv-join: expected non-negative tolerance, got " << tolerance << std::endl; return 1; }
+        stdin_keys.reset( new keys( stdin_csv, stdin_indices, categories, tolerance ) );
+        filter_keys.reset( new keys( filter_csv, filter_indices, categories, tolerance ) );
+        stdin_csv.fields = v.size() == 1 ? std::string( "," ) : comma::join( v, ',' ); // a single empty field would stand for all the fields of input
+        filter_csv.fields = w.size() == 1 ? std::string( "," ) : comma::join( w, ',' );
         stdin_stream.reset( new comma::csv::input_stream< input >( std::cin, stdin_csv ) );
         filter_transport.reset( new comma::io::istream( filter_csv.filename, filter_csv.binary() ? comma::io::mode::binary : comma::io::mode::ascii ) );
         filter_stream.reset( new comma::csv::input_stream< input >( **filter_transport, filter_csv ) );
+        boost::scoped_ptr< Probes > probes;
+        if( threads > 1 ) { probes.reset( new Probes( threads, options.value< std::size_t >( "--batch-size", 4096 ) ) ); }
         std::size_t discarded = 0;
-        read_filter_block_();
+        boost::scoped_ptr< merge > merged;
+        if( sorted ) { merged.reset( new merge ); } else { read_filter_block_( filter_map, block ); }
+        if( !sorted && options.exists( "--prefetch" ) ) { prefetch.reset( new Prefetch ); }
+        if( probes )
+        {
+            while( !is_shutdown && ( anti || !filter_map.empty() ) && probes->read() )
+            {
+                while( probes->probe( discarded ) ) // block changed
+                {
+                    if( !next_filter_block_() ) { probes->ignore_blocks(); }
+                    if( !anti && filter_map.empty() ) { break; }
+                }
+            }
+            if( verbose ) { std::cerr << "csv-join: discarded " << discarded << " entrie[s] with no matches" << std::endl; }
+            report_errors_();
+            return 0;
+        }
+        key k;
+        key coordinates;
+        key cell;
+        std::string left;
 
         #ifdef WIN32
         if( stdin_stream->is_binary() )
@@ -207,30 +1454,42 @@ int main( int ac, char** av )
         {
             const input* p = stdin_stream->read();
             if( !p ) { break; }
-            if( block != p->block ) { read_filter_block_(); }
-            if( filter_map.empty() ) { break; }
-            FilterMap::const_iterator it = filter_map.find( *p );
-            if( it == filter_map.end() || it->second.empty() ) { ++discarded; continue; }
-            if( stdin_stream->is_binary() )
+            bool converted = stdin_stream->is_binary() ? stdin_keys->make( stdin_stream->binary().last(), k ) : stdin_keys->make( stdin_stream->ascii().last(), k );
+            if( radius > 0 ) { converted = ( stdin_stream->is_binary() ? stdin_coordinates->make( stdin_stream->binary().last(), coordinates ) : stdin_coordinates->make( stdin_stream->ascii().last(), coordinates ) ) && converted; }
+            if( !tolerated_( converted, stdin_errors ) ) { continue; }
+            if( sorted )
             {
-                for( std::size_t i = 0; i < ( first_matching ? 1 : it->second.size() ); ++i )
+                if( merged->empty() && !anti ) { break; }
+                bool matched = merged->find( p->block, k ) > 0;
+                if( matched == anti ) { ++discarded; continue; }
+                stdin_record_( left );
+                if( semi || anti ) { output_( &left[0], left.size() ); }
+                else
                 {
-                    std::cout.write( stdin_stream->binary().last(), stdin_csv.format().size() );
-                    std::cout.write( &( it->second[i][0] ), filter_csv.format().size() );
-                    std::cout.flush();
+                    const std::vector< std::string >& records = merged->records();
+                    for( std::size_t i = 0; i < ( first_matching ? 1 : records.size() ); ++i ) { output_( &left[0], left.size(), &records[i][0], records[i].size() ); }
                 }
-                std::cout.flush();
+                if( first_matching && !anti ) { merged->erase(); }
+                continue;
             }
-            else
+            if( block != p->block ) { discarded += join_spilled_(); next_filter_block_(); }
+            if( filter_map.empty() && !spilled && !anti ) { break; }
+            if( spilled ) { stdin_record_( left ); spilled->push_stdin( k, &left[0], left.size() ); continue; }
+            if( radius > 0 )
             {
-                for( std::size_t i = 0; i < ( first_matching ? 1 : it->second.size() ); ++i )
-                {
-                    std::cout << comma::join( stdin_stream->ascii().last(), stdin_csv.delimiter ) << stdin_csv.delimiter << it->second[i] << std::endl;
-                }
+                stdin_record_( left );
+                if( !spatial_join_( &left[0], left.size(), k, coordinates, cell ) ) { ++discarded; }
+                continue;
             }
-            if( first_matching ) { filter_map.erase( it->first ); } // quick and dirty for now
+            comma::uint64 r = filter_map.find( k );
+            if( ( r == FilterMap::none ) != anti ) { ++discarded; continue; }
+            stdin_record_( left );
+            join_( &left[0], left.size(), r );
+            if( first_matching && !anti ) { filter_map.erase( k ); } // quick and dirty for now
         }
+        discarded += join_spilled_();
         if( verbose ) { std::cerr << "csv-join: discarded " << discarded << " entrie[s] with no matches" << std::endl; }
+        report_errors_();
         return 0;
     }
     catch( std::exception& ex )
@@ -169,7 +169,7 @@ int main( int ac, char** av )
                     q.rsize = rsize;
                     if( has_size )
                     {
-                        if( csv.binary() ) { buffer.resize( csv.format().size() ); ::memcpy( &buffer[0], istream.binary().last(), csv.format().size() ); }
+                        if( csv.binary() ) { buffer.resize( istream.binary().last_size() ); ::memcpy( &buffer[0], istream.binary().last(), buffer.size() ); }
                         else { buffer = comma::join( istream.ascii().last(), csv.delimiter ); }
                         points.push_back( std::make_pair( q, buffer ) );
                     }
@@ -192,7 +192,7 @@ int main( int ac, char** av )
                     block = q.block;
                     if( has_size ) // quick and dirty, use boost::optional instead
                     {
-                        if( csv.binary() ) { buffer.resize( csv.format().size() ); ::memcpy( &buffer[0], istream.binary().last(), csv.format().size() ); }
+                        if( csv.binary() ) { buffer.resize( istream.binary().last_size() ); ::memcpy( &buffer[0], istream.binary().last(), buffer.size() ); }
                         else { buffer = comma::join( istream.ascii().last(), csv.delimiter ); }
                         points.push_back( std::make_pair( q, buffer ) );
                     }
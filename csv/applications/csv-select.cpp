@@ -18,16 +18,24 @@
 
 /// @author vsevolod vlaskine
 
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <map>
 #include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <comma/application/command_line_options.h>
 #include <comma/application/contact_info.h>
 #include <comma/application/signal_flag.h>
+#include <comma/base/exception.h>
 #include <comma/csv/stream.h>
 #include <comma/math/compare.h>
 #include <comma/name_value/parser.h>
@@ -45,7 +53,13 @@ void usage()
     std::cerr << "    --equals=<value>: equals to <value>" << std::endl;
     std::cerr << "    --from=<value>: from <value> (inclusive, i.e. greater or equals)" << std::endl;
     std::cerr << "    --to=<value>: to <value> (inclusive, i.e. less or equals)" << std::endl;
-    std::cerr << "      todo: implement a simple boolean expression grammar" << std::endl;
+    std::cerr << "    --expression,-e=<expression>: select records for which <expression> is true; and-ed with constraints above, if any" << std::endl;
+    std::cerr << "        operators, from lowest precedence: or, ||; and, &&; not, !;" << std::endl;
+    std::cerr << "                                           ==, =, !=, <, <=, >, >=, starts_with, in ( <value>, ... ); +, -; *, /; unary -" << std::endl;
+    std::cerr << "        operands: field names, numbers, 'strings' in single quotes;" << std::endl;
+    std::cerr << "                  field names that are keywords or contain other characters than letters, digits and underscore in double quotes, e.g. \"position/x\"" << std::endl;
+    std::cerr << "        time fields are compared and subtracted as seconds; 'strings' compared with time are parsed as iso time, e.g. t >= '20120101T000000'" << std::endl;
+    std::cerr << "        the expression is compiled once; with --verbose, the compiled code is output to stderr" << std::endl;
     std::cerr << "    --sorted: a hint that the key column is sorted in ascending order" << std::endl;
     std::cerr << "              todo: support descending order" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
@@ -60,6 +74,8 @@ void usage()
     std::cerr << "    cat a.csv | csv-select --fields=,,t --from=20120101T000000 --to=20120101T000010 --sorted" << std::endl;
     std::cerr << "    cat xyz.csv | csv-select --fields=x,y,z \"x;from=1;to=2\" \"y;from=-1;to=1.1\" \"z;from=5;to=5.5\"" << std::endl;
     std::cerr << "    cat a.csv | csv-select --fields=t,scalar \"t;from=20120101T000000;sorted\" \"scalar;from=-10;to=20.5\"" << std::endl;
+    std::cerr << "    cat xyz.csv | csv-select --fields=x,y,z --expression=\"x * x + y * y < 4 or z in ( 1, 2, 5 )\"" << std::endl;
+    std::cerr << "    cat a.csv | csv-select --fields=t,name,scalar --expression=\"not name starts_with 'test_' and ( scalar > 10 or t < '20120101T000000' )\"" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -180,6 +196,528 @@ template <> struct traits< input_t >
 
 } } // namespace comma { namespace visiting {
 
+/// boolean expression over input fields, compiled once into flat postfix code
+///
+/// grammar (lowest precedence first):
+///     or: and { ( "or" | "||" ) and }
+///     and: not { ( "and" | "&&" ) not }
+///     not: ( "not" | "!" ) not | comparison
+///     comparison: sum [ ( "==" | "=" | "!=" | "<" | "<=" | ">" | ">=" | "starts_with" ) sum | "in" "(" literal { "," literal } ")" ]
+///     sum: product { ( "+" | "-" ) product }
+///     product: unary { ( "*" | "/" ) unary }
+///     unary: "-" unary | number | 'string' | field | "field" | "(" or ")"
+///
+/// code runs on a stack of doubles: time is seconds since epoch, boolean is 0 or 1;
+/// strings are never put on the stack: string comparisons refer to fields or literals directly
+class expression_t
+{
+    public:
+        enum types { number, time, string, boolean };
+
+        struct field_t
+        {
+            types type;
+            unsigned int index;
+            field_t() {}
+            field_t( types type, unsigned int index ) : type( type ), index( index ) {}
+        };
+
+        expression_t( const std::string& text, const std::map< std::string, field_t >& fields );
+
+        bool operator()( const input_t& input ) const;
+
+        /// return compiled code as text, for debugging
+        std::string dump() const;
+
+    private:
+        struct node
+        {
+            enum kinds { number, string, field, unary, binary, in };
+            kinds kind;
+            std::string text;
+            double value;
+            std::vector< boost::shared_ptr< node > > children;
+            node( kinds kind, const std::string& text = "", double value = 0 ) : kind( kind ), text( text ), value( value ) {}
+        };
+        typedef boost::shared_ptr< node > node_ptr;
+
+        enum opcodes { push, push_double, push_time, add, subtract, multiply, divide, negate, compare, compare_strings, in_numbers, in_strings, logical_not, jump_if_false, jump_if_true };
+        enum comparisons { equal, not_equal, less, less_equal, greater, greater_equal, starts_with };
+
+        struct instruction
+        {
+            opcodes opcode;
+            double value;
+            unsigned int a;
+            unsigned int b;
+            unsigned int c;
+            instruction( opcodes opcode, double value = 0, unsigned int a = 0, unsigned int b = 0, unsigned int c = 0 ) : opcode( opcode ), value( value ), a( a ), b( b ), c( c ) {}
+        };
+
+        struct string_operand
+        {
+            bool is_field;
+            unsigned int index;
+            std::string literal;
+        };
+
+        std::map< std::string, field_t > fields_;
+        std::vector< instruction > code_;
+        std::vector< string_operand > strings_;
+        std::vector< std::vector< double > > number_sets_;
+        std::vector< std::vector< std::string > > string_sets_;
+        mutable std::vector< double > stack_;
+
+        // parser
+        std::string text_;
+        std::size_t pos_;
+        std::string token_;
+        enum token_kinds { end, symbol, word, quoted_field, quoted_string, numeric };
+        token_kinds kind_;
+        void next_();
+        bool accept_( const std::string& s );
+        void expect_( const std::string& s );
+        node_ptr or_();
+        node_ptr and_();
+        node_ptr not_();
+        node_ptr comparison_();
+        node_ptr sum_();
+        node_ptr product_();
+        node_ptr unary_();
+        node_ptr literal_();
+
+        // compiler
+        types type_( const node_ptr& n ) const;
+        const field_t& field_( const std::string& name ) const;
+        void compile_( const node_ptr& n, types as );
+        void compile_boolean_( const node_ptr& n );
+        unsigned int compile_string_( const node_ptr& n );
+        static bool is_comparison_( const std::string& op );
+        static comparisons comparison_of_( const std::string& op );
+        static double seconds_( const boost::posix_time::ptime& t );
+        static double time_literal_( const std::string& s );
+        const std::string& string_( unsigned int i, const input_t& input ) const;
+        template < typename T > static bool compare_( const T& lhs, const T& rhs, unsigned int how );
+};
+
+static const boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+
+double expression_t::seconds_( const boost::posix_time::ptime& t ) { return t.is_special() ? std::numeric_limits< double >::quiet_NaN() : double( ( t - epoch ).total_microseconds() ) / 1000000; }
+
+double expression_t::time_literal_( const std::string& s )
+{
+    try { return seconds_( boost::posix_time::from_iso_string( s ) ); }
+    catch( ... ) { COMMA_THROW( comma::exception, "expected time, got '" << s << "'" ); }
+}
+
+expression_t::expression_t( const std::string& text, const std::map< std::string, field_t >& fields )
+    : fields_( fields )
+    , text_( text )
+    , pos_( 0 )
+{
+    next_();
+    node_ptr n = or_();
+    if( kind_ != end ) { COMMA_THROW( comma::exception, "expected end of expression, got \"" << token_ << "\" in \"" << text_ << "\"" ); }
+    compile_boolean_( n );
+    stack_.resize( code_.size() + 1 ); // each instruction pushes at most one value
+}
+
+void expression_t::next_()
+{
+    while( pos_ < text_.size() && std::isspace( text_[pos_] ) ) { ++pos_; }
+    if( pos_ == text_.size() ) { kind_ = end; token_ = ""; return; }
+    char c = text_[pos_];
+    if( c == '\'' || c == '"' )
+    {
+        std::size_t closing = text_.find( c, pos_ + 1 );
+        if( closing == std::string::npos ) { COMMA_THROW( comma::exception, "expected closing quote in \"" << text_ << "\"" ); }
+        token_ = text_.substr( pos_ + 1, closing - pos_ - 1 );
+        kind_ = c == '\'' ? quoted_string : quoted_field;
+        pos_ = closing + 1;
+        return;
+    }
+    if( std::isalpha( c ) || c == '_' )
+    {
+        std::size_t begin = pos_;
+        while( pos_ < text_.size() && ( std::isalnum( text_[pos_] ) || text_[pos_] == '_' ) ) { ++pos_; }
+        token_ = text_.substr( begin, pos_ - begin );
+        kind_ = word;
+        return;
+    }
+    if( std::isdigit( c ) || ( c == '.' && pos_ + 1 < text_.size() && std::isdigit( text_[ pos_ + 1 ] ) ) )
+    {
+        const char* begin = text_.c_str() + pos_;
+        char* finish;
+        ::strtod( begin, &finish );
+        token_ = std::string( begin, finish - begin );
+        kind_ = numeric;
+        pos_ += finish - begin;
+        return;
+    }
+    static const char* symbols[] = { "==", "!=", "<=", ">=", "&&", "||", "=", "<", ">", "!", "+", "-", "*", "/", "(", ")", ",", NULL };
+    for( const char** s = symbols; *s; ++s )
+    {
+        if( text_.compare( pos_, ::strlen( *s ), *s ) != 0 ) { continue; }
+        token_ = *s;
+        kind_ = symbol;
+        pos_ += token_.size();
+        return;
+    }
+    COMMA_THROW( comma::exception, "unexpected '" << c << "' in \"" << text_ << "\"" );
+}
+
+bool expression_t::accept_( const std::string& s )
+{
+    if( ( kind_ != symbol && kind_ != word ) || token_ != s ) { return false; }
+    next_();
+    return true;
+}
+
+void expression_t::expect_( const std::string& s )
+{
+    if( !accept_( s ) ) { COMMA_THROW( comma::exception, "expected \"" << s << "\", got \"" << token_ << "\" in \"" << text_ << "\"" ); }
+}
+
+expression_t::node_ptr expression_t::or_()
+{
+    node_ptr n = and_();
+    while( accept_( "or" ) || accept_( "||" ) )
+    {
+        node_ptr b( new node( node::binary, "or" ) );
+        b->children.push_back( n );
+        b->children.push_back( and_() );
+        n = b;
+    }
+    return n;
+}
+
+expression_t::node_ptr expression_t::and_()
+{
+    node_ptr n = not_();
+    while( accept_( "and" ) || accept_( "&&" ) )
+    {
+        node_ptr b( new node( node::binary, "and" ) );
+        b->children.push_back( n );
+        b->children.push_back( not_() );
+        n = b;
+    }
+    return n;
+}
+
+expression_t::node_ptr expression_t::not_()
+{
+    if( !accept_( "not" ) && !accept_( "!" ) ) { return comparison_(); }
+    node_ptr n( new node( node::unary, "not" ) );
+    n->children.push_back( not_() );
+    return n;
+}
+
+expression_t::node_ptr expression_t::comparison_()
+{
+    node_ptr n = sum_();
+    if( accept_( "in" ) )
+    {
+        node_ptr s( new node( node::in ) );
+        s->children.push_back( n );
+        expect_( "(" );
+        do { s->children.push_back( literal_() ); } while( accept_( "," ) );
+        expect_( ")" );
+        return s;
+    }
+    if( ( kind_ != symbol && kind_ != word ) || !is_comparison_( token_ ) ) { return n; }
+    node_ptr b( new node( node::binary, token_ == "=" ? "==" : token_ ) );
+    next_();
+    b->children.push_back( n );
+    b->children.push_back( sum_() );
+    return b;
+}
+
+expression_t::node_ptr expression_t::sum_()
+{
+    node_ptr n = product_();
+    while( kind_ == symbol && ( token_ == "+" || token_ == "-" ) )
+    {
+        node_ptr b( new node( node::binary, token_ ) );
+        next_();
+        b->children.push_back( n );
+        b->children.push_back( product_() );
+        n = b;
+    }
+    return n;
+}
+
+expression_t::node_ptr expression_t::product_()
+{
+    node_ptr n = unary_();
+    while( kind_ == symbol && ( token_ == "*" || token_ == "/" ) )
+    {
+        node_ptr b( new node( node::binary, token_ ) );
+        next_();
+        b->children.push_back( n );
+        b->children.push_back( unary_() );
+        n = b;
+    }
+    return n;
+}
+
+expression_t::node_ptr expression_t::unary_()
+{
+    if( accept_( "-" ) )
+    {
+        node_ptr n( new node( node::unary, "-" ) );
+        n->children.push_back( unary_() );
+        return n;
+    }
+    if( accept_( "(" ) )
+    {
+        node_ptr n = or_();
+        expect_( ")" );
+        return n;
+    }
+    if( kind_ == word || kind_ == quoted_field )
+    {
+        if( kind_ == word && ( token_ == "and" || token_ == "or" || token_ == "not" || token_ == "in" || token_ == "starts_with" ) ) { COMMA_THROW( comma::exception, "expected operand, got \"" << token_ << "\" in \"" << text_ << "\"; quote field names that are keywords, e.g. \"\\\"" << token_ << "\\\"\"" ); }
+        node_ptr n( new node( node::field, token_ ) );
+        next_();
+        return n;
+    }
+    return literal_();
+}
+
+expression_t::node_ptr expression_t::literal_()
+{
+    bool minus = kind_ == symbol && token_ == "-";
+    if( minus ) { next_(); }
+    node_ptr n;
+    if( kind_ == numeric ) { n.reset( new node( node::number, token_, boost::lexical_cast< double >( token_ ) * ( minus ? -1 : 1 ) ) ); }
+    else if( kind_ == quoted_string && !minus ) { n.reset( new node( node::string, token_ ) ); }
+    else { COMMA_THROW( comma::exception, "expected number or 'string', got \"" << token_ << "\" in \"" << text_ << "\"" ); }
+    next_();
+    return n;
+}
+
+bool expression_t::is_comparison_( const std::string& op ) { return op == "==" || op == "=" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=" || op == "starts_with"; }
+
+expression_t::comparisons expression_t::comparison_of_( const std::string& op )
+{
+    if( op == "==" ) { return equal; }
+    if( op == "!=" ) { return not_equal; }
+    if( op == "<" ) { return less; }
+    if( op == "<=" ) { return less_equal; }
+    if( op == ">" ) { return greater; }
+    if( op == ">=" ) { return greater_equal; }
+    return starts_with;
+}
+
+const expression_t::field_t& expression_t::field_( const std::string& name ) const
+{
+    std::map< std::string, field_t >::const_iterator it = fields_.find( name );
+    if( it == fields_.end() ) { COMMA_THROW( comma::exception, "field \"" << name << "\" not found in fields" ); }
+    return it->second;
+}
+
+expression_t::types expression_t::type_( const node_ptr& n ) const
+{
+    switch( n->kind )
+    {
+        case node::number: return number;
+        case node::string: return string;
+        case node::field: return field_( n->text ).type;
+        case node::in: return boolean;
+        case node::unary: return n->text == "not" ? boolean : number;
+        case node::binary:
+        {
+            if( n->text == "and" || n->text == "or" || is_comparison_( n->text ) ) { return boolean; }
+            types a = type_( n->children[0] );
+            types b = type_( n->children[1] );
+            if( n->text == "-" && a == time && ( b == time || b == string ) ) { return number; }
+            if( ( n->text == "+" || n->text == "-" ) && a == time ) { return time; }
+            if( n->text == "+" && b == time ) { return time; }
+            return number;
+        }
+    }
+    return number;
+}
+
+void expression_t::compile_boolean_( const node_ptr& n )
+{
+    types t = type_( n );
+    if( t != boolean && t != number ) { COMMA_THROW( comma::exception, "expected boolean or number, got " << ( t == time ? "time" : "string" ) << " in \"" << text_ << "\"" ); }
+    compile_( n, t );
+}
+
+unsigned int expression_t::compile_string_( const node_ptr& n )
+{
+    string_operand s;
+    s.is_field = n->kind == node::field;
+    if( s.is_field ) { s.index = field_( n->text ).index; }
+    else { s.literal = n->text; }
+    strings_.push_back( s );
+    return strings_.size() - 1;
+}
+
+/// compile value; as: the type to convert string literals to, i.e. time, if compared or added to a time
+void expression_t::compile_( const node_ptr& n, types as )
+{
+    switch( n->kind )
+    {
+        case node::number:
+            code_.push_back( instruction( push, n->value ) );
+            return;
+        case node::string:
+            if( as != time ) { COMMA_THROW( comma::exception, "expected number, got '" << n->text << "' in \"" << text_ << "\"" ); }
+            code_.push_back( instruction( push, time_literal_( n->text ) ) );
+            return;
+        case node::field:
+        {
+            const field_t& f = field_( n->text );
+            if( f.type == string ) { COMMA_THROW( comma::exception, "expected numeric field, got string field \"" << n->text << "\" in \"" << text_ << "\"" ); }
+            code_.push_back( instruction( f.type == time ? push_time : push_double, 0, f.index ) );
+            return;
+        }
+        case node::unary:
+            if( n->text == "not" ) { compile_boolean_( n->children[0] ); code_.push_back( instruction( logical_not ) ); return; }
+            compile_( n->children[0], number );
+            code_.push_back( instruction( negate ) );
+            return;
+        case node::in:
+        {
+            types t = type_( n->children[0] );
+            if( t == string )
+            {
+                if( n->children[0]->kind != node::field ) { COMMA_THROW( comma::exception, "expected string field on the left of \"in\" in \"" << text_ << "\"" ); }
+                std::vector< std::string > set;
+                for( unsigned int i = 1; i < n->children.size(); ++i )
+                {
+                    if( n->children[i]->kind != node::string ) { COMMA_THROW( comma::exception, "expected 'string' in set of strings, got " << n->children[i]->text << " in \"" << text_ << "\"" ); }
+                    set.push_back( n->children[i]->text );
+                }
+                std::sort( set.begin(), set.end() );
+                string_sets_.push_back( set );
+                code_.push_back( instruction( in_strings, 0, compile_string_( n->children[0] ), string_sets_.size() - 1 ) );
+                return;
+            }
+            compile_( n->children[0], t );
+            std::vector< double > set;
+            for( unsigned int i = 1; i < n->children.size(); ++i )
+            {
+                if( n->children[i]->kind == node::number ) { set.push_back( n->children[i]->value ); }
+                else if( t == time ) { set.push_back( time_literal_( n->children[i]->text ) ); }
+                else { COMMA_THROW( comma::exception, "expected number in set of numbers, got '" << n->children[i]->text << "' in \"" << text_ << "\"" ); }
+            }
+            std::sort( set.begin(), set.end() );
+            number_sets_.push_back( set );
+            code_.push_back( instruction( in_numbers, 0, number_sets_.size() - 1 ) );
+            return;
+        }
+        case node::binary:
+        {
+            const std::string& op = n->text;
+            if( op == "and" || op == "or" ) // short circuit: leave left operand on the stack, if it decides the result
+            {
+                compile_boolean_( n->children[0] );
+                std::size_t jump = code_.size();
+                code_.push_back( instruction( op == "and" ? jump_if_false : jump_if_true ) );
+                compile_boolean_( n->children[1] );
+                code_[jump].a = code_.size();
+                return;
+            }
+            types a = type_( n->children[0] );
+            types b = type_( n->children[1] );
+            if( a == boolean || b == boolean ) { COMMA_THROW( comma::exception, "expected values on both sides of \"" << op << "\", got boolean in \"" << text_ << "\"" ); }
+            if( is_comparison_( op ) && a == string && b == string )
+            {
+                unsigned int lhs = compile_string_( n->children[0] );
+                unsigned int rhs = compile_string_( n->children[1] );
+                code_.push_back( instruction( compare_strings, 0, lhs, rhs, comparison_of_( op ) ) );
+                return;
+            }
+            if( op == "starts_with" ) { COMMA_THROW( comma::exception, "expected strings on both sides of \"starts_with\" in \"" << text_ << "\"" ); }
+            types as = a == time || b == time ? time : number;
+            compile_( n->children[0], as );
+            compile_( n->children[1], as );
+            if( is_comparison_( op ) ) { code_.push_back( instruction( compare, 0, 0, 0, comparison_of_( op ) ) ); return; }
+            if( ( op == "*" || op == "/" ) && as == time ) { COMMA_THROW( comma::exception, "expected numbers on both sides of \"" << op << "\", got time in \"" << text_ << "\"" ); }
+            if( op == "+" && a != number && b != number ) { COMMA_THROW( comma::exception, "cannot add two times in \"" << text_ << "\"" ); }
+            code_.push_back( instruction( op == "+" ? add : op == "-" ? subtract : op == "*" ? multiply : divide ) );
+            return;
+        }
+    }
+}
+
+const std::string& expression_t::string_( unsigned int i, const input_t& input ) const { return strings_[i].is_field ? input.strings[ strings_[i].index ].value : strings_[i].literal; }
+
+template < typename T >
+bool expression_t::compare_( const T& lhs, const T& rhs, unsigned int how )
+{
+    switch( how )
+    {
+        case equal: return comma::math::equal( lhs, rhs );
+        case not_equal: return !comma::math::equal( lhs, rhs );
+        case less: return comma::math::less( lhs, rhs );
+        case less_equal: return !comma::math::less( rhs, lhs );
+        case greater: return comma::math::less( rhs, lhs );
+        case greater_equal: return !comma::math::less( lhs, rhs );
+    }
+    return false;
+}
+
+bool expression_t::operator()( const input_t& input ) const
+{
+    double* top = &stack_[0] - 1;
+    for( std::size_t pc = 0; pc < code_.size(); ++pc )
+    {
+        const instruction& i = code_[pc];
+        switch( i.opcode )
+        {
+            case push: *++top = i.value; break;
+            case push_double: *++top = input.doubles[ i.a ].value; break;
+            case push_time: *++top = seconds_( input.time[ i.a ].value ); break;
+            case add: --top; *top += top[1]; break;
+            case subtract: --top; *top -= top[1]; break;
+            case multiply: --top; *top *= top[1]; break;
+            case divide: --top; *top /= top[1]; break;
+            case negate: *top = -*top; break;
+            case compare: --top; *top = compare_( *top, top[1], i.c ); break;
+            case compare_strings:
+            {
+                const std::string& lhs = string_( i.a, input );
+                const std::string& rhs = string_( i.b, input );
+                *++top = i.c == starts_with ? lhs.compare( 0, rhs.size(), rhs ) == 0 : compare_( lhs, rhs, i.c );
+                break;
+            }
+            case in_numbers: *top = std::binary_search( number_sets_[ i.a ].begin(), number_sets_[ i.a ].end(), *top ); break;
+            case in_strings: *++top = std::binary_search( string_sets_[ i.b ].begin(), string_sets_[ i.b ].end(), string_( i.a, input ) ); break;
+            case logical_not: *top = *top == 0; break;
+            case jump_if_false: if( *top == 0 ) { pc = i.a - 1; } else { --top; } break;
+            case jump_if_true: if( *top != 0 ) { pc = i.a - 1; } else { --top; } break;
+        }
+    }
+    return *top != 0;
+}
+
+std::string expression_t::dump() const
+{
+    static const char* names[] = { "push", "push_double", "push_time", "add", "subtract", "multiply", "divide", "negate", "compare", "compare_strings", "in_numbers", "in_strings", "not", "jump_if_false", "jump_if_true" };
+    std::ostringstream oss;
+    for( std::size_t pc = 0; pc < code_.size(); ++pc )
+    {
+        const instruction& i = code_[pc];
+        oss << pc << ": " << names[ i.opcode ];
+        switch( i.opcode )
+        {
+            case push: oss << " " << i.value; break;
+            case push_double: case push_time: case in_numbers: case jump_if_false: case jump_if_true: oss << " " << i.a; break;
+            case compare: oss << " " << i.c; break;
+            case compare_strings: oss << " " << i.a << " " << i.b << " " << i.c; break;
+            case in_strings: oss << " " << i.a << " " << i.b; break;
+            default: break;
+        }
+        oss << std::endl;
+    }
+    return oss.str();
+}
+
 template < typename T >
 static value_t< T > make_value( const std::string& constraints_string, const comma::command_line_options& options )
 {
@@ -194,10 +732,14 @@ static comma::csv::options csv;
 static input_t input;
 static std::vector< std::string > fields;
 static std::map< std::string, std::string > constraints_map;
+static boost::scoped_ptr< expression_t > expression;
+
+static bool is_a_match( const input_t& p ) { return p.is_a_match() && ( !expression || ( *expression )( p ) ); }
 
 static void init_input( const comma::csv::format& format, const comma::command_line_options& options )
 {
     if( fields.empty() ) { for( unsigned int i = 0; i < format.count(); ++i ) { fields.push_back( "v" ); } }
+    std::map< std::string, expression_t::field_t > names;
     for( unsigned int i = 0; i < fields.size(); ++i )
     {
         if( comma::strip( fields[i], ' ' ).empty() ) { continue; }
@@ -205,14 +747,18 @@ static void init_input( const comma::csv::format& format, const comma::command_l
         {
             case comma::csv::format::time:
             case comma::csv::format::long_time:
+                names.insert( std::make_pair( fields[i], expression_t::field_t( expression_t::time, input.time.size() ) ) );
                 input.time.push_back( make_value< boost::posix_time::ptime >( constraints_map[ fields[i] ], options ) );
                 fields[i] = "t[" + boost::lexical_cast< std::string >( input.time.size() - 1 ) + "]/value";
                 break;
             case comma::csv::format::fixed_string:
+            case comma::csv::format::variable_string:
+                names.insert( std::make_pair( fields[i], expression_t::field_t( expression_t::string, input.strings.size() ) ) );
                 input.strings.push_back( make_value< std::string >( constraints_map[ fields[i] ], options ) );
                 fields[i] = "strings[" + boost::lexical_cast< std::string >( input.strings.size() - 1 ) + "]/value";
                 break;
             default:
+                names.insert( std::make_pair( fields[i], expression_t::field_t( expression_t::number, input.doubles.size() ) ) );
                 input.doubles.push_back( make_value< double >( constraints_map[ fields[i] ], options ) );
                 fields[i] = "doubles[" + boost::lexical_cast< std::string >( input.doubles.size() - 1 ) + "]/value";
                 break;
@@ -220,6 +766,9 @@ static void init_input( const comma::csv::format& format, const comma::command_l
     }
     csv.fields = comma::join( fields, ',' );
     csv.full_xpath = true;
+    if( !options.exists( "--expression,-e" ) ) { return; }
+    expression.reset( new expression_t( options.value< std::string >( "--expression,-e" ), names ) );
+    if( verbose ) { std::cerr << "csv-select: compiled expression:" << std::endl << expression->dump(); }
 }
 
 static comma::csv::format guess_format( const std::string& line )
@@ -242,7 +791,7 @@ static comma::csv::format guess_format( const std::string& line )
             }
             catch( ... )
             {
-                format += "s[1024]"; // quick and dirty
+                format += "s";
             }
         }
     }
@@ -250,6 +799,11 @@ static comma::csv::format guess_format( const std::string& line )
     return format;
 }
 
+static void report_errors_( std::size_t skipped, std::size_t defaulted )
+{
+    if( verbose && ( skipped || defaulted ) ) { std::cerr << "csv-select: skipped " << skipped << " record[s], defaulted fields in " << defaulted << " record[s] on error" << std::endl; }
+}
+
 int main( int ac, char** av )
 {
     try
@@ -260,7 +814,7 @@ int main( int ac, char** av )
         csv = comma::csv::options( options );
         fields = comma::split( csv.fields, ',' );
         if( fields.size() == 1 && fields[0].empty() ) { fields.clear(); }
-        std::vector< std::string > unnamed = options.unnamed( "--sorted,--verbose,-v", "-b,--binary,-f,--fields,-d,--delimiter,--precision,--equals,--from,--to" );
+        std::vector< std::string > unnamed = options.unnamed( "--sorted,--verbose,-v", "-b,--binary,-f,--fields,-d,--delimiter,--precision,--equals,--from,--to,--expression,-e,--on-error" );
         for( unsigned int i = 0; i < unnamed.size(); constraints_map.insert( std::make_pair( comma::split( unnamed[i], ';' )[0], unnamed[i] ) ), ++i );
         comma::signal_flag is_shutdown;
         if( csv.binary() )
@@ -274,12 +828,15 @@ int main( int ac, char** av )
             {
                 const input_t* p = istream.read();
                 if( !p || p->done() ) { break; }
-                if( p->is_a_match() ) { std::cout.write( istream.last(), csv.format().size() ); std::cout.flush(); }
+                if( is_a_match( *p ) ) { std::cout.write( istream.last(), istream.last_size() ); std::cout.flush(); }
             }
+            report_errors_( istream.skipped(), istream.defaulted() );
         }
         else
         {
             boost::scoped_ptr< comma::csv::ascii_input_stream< input_t > > istream;
+            std::size_t skipped = 0;
+            std::size_t defaulted = 0;
             while( !is_shutdown && std::cin.good() && !std::cin.eof() )
             {
                 if( !istream )
@@ -300,8 +857,10 @@ int main( int ac, char** av )
                     std::istringstream iss( line );
                     comma::csv::ascii_input_stream< input_t > isstream( iss, csv, input );
                     const input_t* p = isstream.read();
-                    if( p->done() ) { break; }
-                    if( p->is_a_match() ) { std::cout << line << std::endl; }
+                    skipped += isstream.skipped();
+                    defaulted += isstream.defaulted();
+                    if( p && p->done() ) { break; }
+                    if( p && is_a_match( *p ) ) { std::cout << line << std::endl; }
 
     //                 input = comma::csv::ascii< input_t >( csv.fields, csv.delimiter, csv.full_xpath, input ).get( comma::split( line, csv.delimiter ) );
     //                 if( input.done() ) { break; }
@@ -311,10 +870,13 @@ int main( int ac, char** av )
                 {
                     const input_t* p = istream->read();
                     if( !p || p->done() ) { break; }
-                    if( p->is_a_match() ) { std::cout << comma::join( istream->last(), csv.delimiter ) << std::endl; }
+                    if( is_a_match( *p ) ) { std::cout << comma::join( istream->last(), csv.delimiter ) << std::endl; }
                 }
             }
+            if( istream ) { skipped += istream->skipped(); defaulted += istream->defaulted(); }
+            report_errors_( skipped, defaulted );
         }
+        return 0;
     }
     catch( std::exception& ex )
     {
@@ -324,4 +886,5 @@ int main( int ac, char** av )
     {
         std::cerr << "csv-select: unknown exception" << std::endl;
     }
+    return 1;
 }
@@ -67,6 +67,7 @@ int main( int argc, char** argv )
         }
         comma::csv::options csv = comma::csv::program_options::get( vm );
         if( csv.binary() ) { size = csv.format().size(); }
+        if( csv.binary() && csv.format().is_variable_size() ) { std::cerr << "csv-split: variable size format not supported; use fixed size strings instead, e.g. \"s[8]\"" << std::endl; return 1; }
         boost::optional< boost::posix_time::time_duration > duration;
         if( period > 0 ) { duration = boost::posix_time::microseconds( period * 1e6 ); }
         std::string suffix;
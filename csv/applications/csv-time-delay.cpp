@@ -40,6 +40,8 @@ static void usage()
     std::cerr << "    --binary,-b <format>: binary format" << std::endl;
     std::cerr << "    --delimiter,-d <delimiter>: ascii only; default ','" << std::endl;
     std::cerr << "    --fields,-f <fields>: input fields; default: t" << std::endl;
+    std::cerr << "    --on-error=<policy>: throw, skip, or default, for records that fail to parse; default: throw" << std::endl;
+    std::cerr << "    --verbose,-v: more output to stderr, e.g. number of records skipped or defaulted on error" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -69,7 +71,7 @@ int main( int ac, char** av )
     {
         comma::command_line_options options( ac, av );
         if( options.exists( "--help" ) || options.exists( "-h" ) || ac == 1 ) { usage(); }        
-        double d = boost::lexical_cast< double >( options.unnamed( "", "--binary,-b,--delimiter,-d,--fields,-f" )[0] );
+        double d = boost::lexical_cast< double >( options.unnamed( "--verbose,-v", "--binary,-b,--delimiter,-d,--fields,-f,--on-error" )[0] );
         int sign = d < 0 ? -1 : 1;
         int seconds = int( std::floor( std::abs( d ) ) );
         int microseconds = int( ( std::abs( d ) - seconds ) * 1000000 );
@@ -89,6 +91,7 @@ int main( int ac, char** av )
             if( csv.binary() ) { ostream.write( q, istream.binary().last() ); }
             else { ostream.write( q, istream.ascii().last() ); }
         }
+        if( options.exists( "--verbose,-v" ) && ( istream.skipped() || istream.defaulted() ) ) { std::cerr << "csv-time-delay: skipped " << istream.skipped() << " record[s], defaulted fields in " << istream.defaulted() << " record[s] on error" << std::endl; }
         if( is_shutdown ) { std::cerr << "csv-time-delay: interrupted by signal" << std::endl; }
         return 0;     
     }
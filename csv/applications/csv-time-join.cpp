@@ -24,6 +24,7 @@
 #include <comma/application/command_line_options.h>
 #include <comma/application/contact_info.h>
 #include <comma/application/signal_flag.h>
+#include <comma/base/time.h>
 #include <comma/base/types.h>
 #include <comma/csv/stream.h>
 #include <comma/io/stream.h>
@@ -68,6 +69,8 @@ static void usage()
     std::cerr << "                         consistently timestamped, especially head or tail" << std::endl;
     std::cerr << "    --timestamp-only,--time-only: join only timestamp from the second input" << std::endl;
     std::cerr << "                                  otherwise join the whole line" << std::endl;
+    std::cerr << "    --on-error=<policy>: throw, skip, or default, for records of both inputs that fail to parse; default: throw" << std::endl;
+    std::cerr << "    --verbose,-v: more output to stderr, e.g. number of records skipped or defaulted on error" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -76,10 +79,10 @@ static void usage()
 
 struct Point
 {
-    boost::posix_time::ptime timestamp;
+    comma::time timestamp;
     unsigned int block;
     Point() : block( 0 ) {}
-    Point( const boost::posix_time::ptime& timestamp ) : timestamp( timestamp ), block( 0 ) {}
+    Point( const comma::time& timestamp ) : timestamp( timestamp ), block( 0 ) {}
 };
 
 namespace comma { namespace visiting {
@@ -114,12 +117,13 @@ int main( int ac, char** av )
         //bool nearest_only = options.exists( "--nearest-only" );
         bool timestamp_only = options.exists( "--timestamp-only,--time-only" );
         bool discard = !options.exists( "--no-discard" );
-        boost::optional< boost::posix_time::time_duration > bound;
-        if( options.exists( "--bound" ) ) { bound = boost::posix_time::microseconds( options.value< double >( "--bound" ) * 1000000 ); }
+        bool verbose = options.exists( "--verbose,-v" );
+        boost::optional< comma::int64 > bound; // microseconds
+        if( options.exists( "--bound" ) ) { bound = static_cast< comma::int64 >( options.value< double >( "--bound" ) * 1000000 ); }
         comma::csv::options stdin_csv( options, "t" );
         //bool has_block = stdin_csv.has_field( "block" );
         comma::csv::input_stream< Point > stdin_stream( std::cin, stdin_csv );
-        std::vector< std::string > unnamed = options.unnamed( "--by-lower,--by-upper,--nearest,--timestamp-only,--time-only,--no-discard", "--binary,-b,--delimiter,-d,--fields,-f,--bound" );
+        std::vector< std::string > unnamed = options.unnamed( "--by-lower,--by-upper,--nearest,--timestamp-only,--time-only,--no-discard,--verbose,-v", "--binary,-b,--delimiter,-d,--fields,-f,--bound,--on-error" );
         std::string properties;
         bool bounded_first = true;
         switch( unnamed.size() )
@@ -143,9 +147,10 @@ int main( int ac, char** av )
         comma::name_value::parser parser( "filename" );
         comma::csv::options csv = parser.get< comma::csv::options >( properties );
         if( csv.fields.empty() ) { csv.fields = "t"; }
+        csv.on_error = stdin_csv.on_error;
         comma::csv::input_stream< Point > istream( *is, csv );
         std::pair< std::string, std::string > last;
-        std::pair< boost::posix_time::ptime, boost::posix_time::ptime > last_timestamp;
+        std::pair< comma::time, comma::time > last_timestamp;
         comma::signal_flag is_shutdown;
 
         #ifdef WIN32
@@ -166,19 +171,19 @@ int main( int ac, char** av )
                 last_timestamp.second = q->timestamp;
                 if( !timestamp_only )
                 {
-                    if( csv.binary() ) { last.second = std::string( istream.binary().last(), csv.format().size() ); }
+                    if( csv.binary() ) { last.second = std::string( istream.binary().last(), istream.binary().last_size() ); }
                     else { last.second = comma::join( istream.ascii().last(), stdin_csv.delimiter ); }
                 }
             }
             if( eof ) { break; }
             if( discard && p->timestamp < last_timestamp.first ) { continue; }
             bool is_first = by_lower || ( nearest && ( p->timestamp - last_timestamp.first ) < ( last_timestamp.second - p->timestamp ) );
-            const boost::posix_time::ptime& t = is_first ? last_timestamp.first : last_timestamp.second;
+            const comma::time& t = is_first ? last_timestamp.first : last_timestamp.second;
             if( bound && !( ( t - *bound ) <= p->timestamp && p->timestamp <= ( t + *bound ) ) ) { continue; }
             const std::string& s = is_first ? last.first : last.second;
             if( stdin_csv.binary() )
             {
-                if( bounded_first ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
+                if( bounded_first ) { std::cout.write( stdin_stream.binary().last(), stdin_stream.binary().last_size() ); }
                 if( timestamp_only )
                 {
                     static comma::csv::binary< Point > b;
@@ -190,18 +195,20 @@ int main( int ac, char** av )
                 {
                     std::cout.write( &s[0], s.size() );
                 }
-                if( !bounded_first ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
+                if( !bounded_first ) { std::cout.write( stdin_stream.binary().last(), stdin_stream.binary().last_size() ); }
                 std::cout.flush();
             }
             else
             {
                 if( bounded_first ) { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ) << stdin_csv.delimiter; }
-                if( timestamp_only ) { std::cout << boost::posix_time::to_iso_string( t ); }
+                if( timestamp_only ) { std::cout << t.to_iso_string(); }
                 else { std::cout << s; }
                 if( !bounded_first ) { std::cout << stdin_csv.delimiter << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ); }
                 std::cout << std::endl;
             }
         }
+        if( verbose && ( stdin_stream.skipped() || stdin_stream.defaulted() ) ) { std::cerr << "csv-time-join: stdin: skipped " << stdin_stream.skipped() << " record[s], defaulted fields in " << stdin_stream.defaulted() << " record[s] on error" << std::endl; }
+        if( verbose && ( istream.skipped() || istream.defaulted() ) ) { std::cerr << "csv-time-join: bounding: skipped " << istream.skipped() << " record[s], defaulted fields in " << istream.defaulted() << " record[s] on error" << std::endl; }
         if( is_shutdown ) { std::cerr << "csv-time-join: interrupted by signal" << std::endl; }
         return 0;     
     }
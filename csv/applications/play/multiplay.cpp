@@ -124,10 +124,10 @@ bool Multiplay::read()
         if( !m_timestamps[i].is_not_a_date_time() ) { end = false; continue; }
         const time* time = m_inputStreams[i]->read();
         if( time == NULL ) { continue; }
-        boost::posix_time::ptime t = time->timestamp;
+        comma::time t = time->timestamp;
         if( m_configs[i].offset.total_microseconds() != 0 )
         {
-            t += m_configs[i].offset;
+            t += m_configs[i].offset.total_microseconds();
         }
         end = false;
         if( ( ( !m_from.is_not_a_date_time() ) && ( t < m_from ) ) || ( ( !m_to.is_not_a_date_time() ) && ( t > m_to ) ) )
@@ -138,7 +138,7 @@ bool Multiplay::read()
         m_timestamps[i] = t;
     }
     if( end ) { return false; }
-    boost::posix_time::ptime oldest;
+    comma::time oldest;
     std::size_t index = 0;
     for( unsigned int i = 0; i < m_timestamps.size(); ++i )
     {
@@ -150,7 +150,7 @@ bool Multiplay::read()
     {
         return true;
     }
-    m_play.wait( oldest );
+    m_play.wait( oldest.to_ptime() );
     if( m_configs[index].options.binary() )
     {
         if( binary_[index] )
@@ -178,7 +178,7 @@ bool Multiplay::read()
             ( *m_publishers[index] ) << comma::join( m_inputStreams[index]->ascii().last(), m_configs[index].options.delimiter ) << endl;
         }
     }
-    m_timestamps[index] = boost::posix_time::not_a_date_time;
+    m_timestamps[index] = comma::time();
     return true;
 }
 
@@ -23,6 +23,7 @@
 
 #include <vector>
 #include <boost/thread/thread_time.hpp>
+#include <comma/base/time.h>
 #include <comma/csv/options.h>
 #include <comma/csv/stream.h>
 #include <comma/io/publisher.h>
@@ -37,8 +38,8 @@ class Multiplay
         struct time
         {
             time() {}
-            time( boost::posix_time::ptime t ) : timestamp( t ) {}
-            boost::posix_time::ptime timestamp;
+            time( const comma::time& t ) : timestamp( t ) {}
+            comma::time timestamp;
         };
 
         struct SourceConfig
@@ -73,10 +74,10 @@ class Multiplay
         std::vector< boost::shared_ptr< csv::input_stream< time > > > m_inputStreams;
         std::vector< boost::shared_ptr< comma::io::publisher > > m_publishers;
         csv::impl::play m_play;
-        std::vector< boost::posix_time::ptime > m_timestamps;
+        std::vector< comma::time > m_timestamps;
         bool m_started;
-        boost::posix_time::ptime m_from;
-        boost::posix_time::ptime m_to;
+        comma::time m_from;
+        comma::time m_to;
         std::vector< boost::shared_ptr< csv::ascii< time > > > ascii_;
         std::vector< boost::shared_ptr< csv::binary< time > > > binary_;
         std::vector< char > buf_fer;
@@ -52,6 +52,10 @@ class ascii
         /// get value (unfilled fields have the same value as in default constructor; convenience function)
         S get( const std::string& line ) const { S s; get( s, line ); return s; }
 
+        /// get value, leaving fields with values that fail to parse unchanged instead of throwing;
+        /// return number of such fields; type mismatches still throw
+        std::size_t get_tolerant( S& s, const std::vector< std::string >& v ) const;
+
         /// put value at the right place in the vector
         const std::vector< std::string >& put( const S& s, std::vector< std::string >& v ) const;
 
@@ -96,6 +100,15 @@ inline const S& ascii< S >::get( S& s, const std::vector< std::string >& v ) con
     return s;
 }
 
+template < typename S >
+inline std::size_t ascii< S >::get_tolerant( S& s, const std::vector< std::string >& v ) const
+{
+    std::size_t errors = 0;
+    impl::from_ascii_ f( ascii_.indices(), ascii_.optional(), v, &errors );
+    visiting::apply( f, s );
+    return errors;
+}
+
 template < typename S >
 inline const std::vector< std::string >& ascii< S >::put( const S& s, std::vector< std::string >& v ) const
 {
@@ -21,6 +21,9 @@
 #ifndef COMMA_CSV_BINARY_HEADER_GUARD_
 #define COMMA_CSV_BINARY_HEADER_GUARD_
 
+#include <string.h>
+#include <algorithm>
+#include <vector>
 #include <boost/optional.hpp>
 #include <comma/csv/names.h>
 #include <comma/csv/options.h>
@@ -43,23 +46,46 @@ class binary
         
         /// get value (returns reference pointing to the parameter) 
         const S& get( S& s, const char* buf ) const;
+
+        /// get value, leaving fields with values that fail to convert unchanged instead of throwing;
+        /// return number of such fields; type mismatches, e.g. string field for integer member, still throw
+        std::size_t get_tolerant( S& s, const char* buf ) const;
         
         /// put value at the right place in the vector
+        /// for variable size formats, the buffer should be big enough (see size( s ))
+        /// and the fields not present in the struct will be zeroed
         char* put( const S& s, char* buf ) const;
         
+        /// put value into the buffer, resizing it as needed; return record size
+        std::size_t put( const S& s, std::vector< char >& buf ) const;
+        
+        /// substitute corresponding fields in the given record and put the result into the buffer, resizing it as needed; return record size
+        /// (for variable size formats, the record size may change)
+        std::size_t put( const S& s, const char* record, std::vector< char >& buf ) const;
+        
+        /// return size of the record for a given value (for fixed size formats, same as format().size())
+        std::size_t size( const S& s ) const;
+        
         /// return format
         const csv::format& format() const { return format_; }
         
     private:
         const csv::format format_;
         boost::optional< impl::binary_visitor > binary_;
+        mutable std::vector< std::size_t > lengths_;
+        mutable std::vector< format::element > fields_;
+        mutable std::vector< format::element > record_fields_;
+        mutable std::vector< boost::optional< format::element > > offsets_;
+        const std::vector< boost::optional< format::element > >& offsets_from_( const std::vector< format::element >& fields ) const;
+        std::size_t layout_( const S& s ) const;
+        void put_lengths_( char* buf ) const;
 };
 
 template < typename S >
 inline binary< S >::binary( const std::string& f, const std::string& column_names, bool full_path_as_name, const S& sample )
     : format_( f == "" ? csv::format::value( sample ) : f )
 {
-    if( format_.size() == sizeof( S ) && format_.string() == csv::format::value( sample ) && join( csv::names( column_names, full_path_as_name, sample ), ',' ) == join( csv::names( full_path_as_name ), ',' ) ) { return; }
+    if( !format_.is_variable_size() && format_.size() == sizeof( S ) && format_.string() == csv::format::value( sample ) && join( csv::names( column_names, full_path_as_name, sample ), ',' ) == join( csv::names( full_path_as_name ), ',' ) ) { return; }
     binary_ = impl::binary_visitor( format_, join( csv::names( column_names, full_path_as_name, sample ), ',' ), full_path_as_name );
     visiting::apply( *binary_, sample );
 }
@@ -68,7 +94,7 @@ template < typename S >
 inline binary< S >::binary( const options& o, const S& sample )
     : format_( o.format().string() == "" ? csv::format::value( sample ) : o.format().string() )
 {
-    if( format_.size() == sizeof( S ) && format_.string() == csv::format::value( sample ) && join( csv::names( o.fields, o.full_xpath, sample ), ',' ) == join( csv::names( o.full_xpath ), ',' ) ) { return; }
+    if( !format_.is_variable_size() && format_.size() == sizeof( S ) && format_.string() == csv::format::value( sample ) && join( csv::names( o.fields, o.full_xpath, sample ), ',' ) == join( csv::names( o.full_xpath ), ',' ) ) { return; }
     binary_ = impl::binary_visitor( format_, join( csv::names( o.fields, o.full_xpath, sample ), ',' ), o.full_xpath );
     visiting::apply( *binary_, sample );
 }
@@ -78,7 +104,8 @@ inline const S& binary< S >::get( S& s, const char* buf ) const
 {
     if( binary_ )
     {
-        impl::frobinary_ f( binary_->offsets(), binary_->optional(), buf );
+        if( format_.is_variable_size() ) { format_.offsets( buf, fields_ ); }
+        impl::frobinary_ f( format_.is_variable_size() ? offsets_from_( fields_ ) : binary_->offsets(), binary_->optional(), buf );
         visiting::apply( f, s );
     }
     else // quick and dirty for better performance
@@ -88,10 +115,29 @@ inline const S& binary< S >::get( S& s, const char* buf ) const
     return s;
 }
 
+template < typename S >
+inline std::size_t binary< S >::get_tolerant( S& s, const char* buf ) const
+{
+    if( !binary_ ) { ::memcpy( reinterpret_cast< char* >( &s ), buf, sizeof( S ) ); return 0; } // plain copy never fails
+    std::size_t errors = 0;
+    if( format_.is_variable_size() ) { format_.offsets( buf, fields_ ); }
+    impl::frobinary_ f( format_.is_variable_size() ? offsets_from_( fields_ ) : binary_->offsets(), binary_->optional(), buf, &errors );
+    visiting::apply( f, s );
+    return errors;
+}
+
 template < typename S >
 inline char* binary< S >::put( const S& s, char* buf ) const
 {
-    if( binary_ )
+    if( format_.is_variable_size() )
+    {
+        lengths_.assign( format_.count(), 0 );
+        ::memset( buf, 0, layout_( s ) );
+        put_lengths_( buf );
+        impl::to_binary f( offsets_from_( fields_ ), buf );
+        visiting::apply( f, s );
+    }
+    else if( binary_ )
     {
         impl::to_binary f( binary_->offsets(), buf );
         visiting::apply( f, s );
@@ -103,6 +149,72 @@ inline char* binary< S >::put( const S& s, char* buf ) const
     return buf;
 }
 
+template < typename S >
+inline std::size_t binary< S >::put( const S& s, std::vector< char >& buf ) const
+{
+    buf.resize( size( s ) );
+    put( s, &buf[0] );
+    return buf.size();
+}
+
+template < typename S >
+inline std::size_t binary< S >::put( const S& s, const char* record, std::vector< char >& buf ) const
+{
+    if( !format_.is_variable_size() )
+    {
+        buf.resize( format_.size() );
+        ::memcpy( &buf[0], record, format_.size() );
+        put( s, &buf[0] );
+        return buf.size();
+    }
+    format_.offsets( record, record_fields_ );
+    lengths_.resize( format_.count() );
+    for( std::size_t i = 0; i < record_fields_.size(); ++i ) { lengths_[i] = record_fields_[i].size; }
+    buf.resize( layout_( s ) );
+    ::memset( &buf[0], 0, buf.size() );
+    for( std::size_t i = 0; i < fields_.size(); ++i ) { ::memcpy( &buf[0] + fields_[i].offset, record + record_fields_[i].offset, std::min( fields_[i].size, record_fields_[i].size ) ); }
+    put_lengths_( &buf[0] );
+    impl::to_binary f( offsets_from_( fields_ ), &buf[0] );
+    visiting::apply( f, s );
+    return buf.size();
+}
+
+template < typename S >
+inline std::size_t binary< S >::size( const S& s ) const
+{
+    if( !format_.is_variable_size() ) { return format_.size(); }
+    lengths_.assign( format_.count(), 0 );
+    return layout_( s );
+}
+
+template < typename S >
+inline std::size_t binary< S >::layout_( const S& s ) const
+{
+    impl::to_binary_lengths l( binary_->offsets(), binary_->indices(), lengths_ );
+    visiting::apply( l, s );
+    return format_.offsets( lengths_, fields_ );
+}
+
+template < typename S >
+inline void binary< S >::put_lengths_( char* buf ) const
+{
+    typedef csv::format::traits< std::string, csv::format::variable_string >::length_type length_type;
+    for( std::size_t i = 0; i < fields_.size(); ++i )
+    {
+        if( fields_[i].type != csv::format::variable_string ) { continue; }
+        *reinterpret_cast< length_type* >( buf + fields_[i].offset - sizeof( length_type ) ) = static_cast< length_type >( fields_[i].size );
+    }
+}
+
+template < typename S >
+inline const std::vector< boost::optional< format::element > >& binary< S >::offsets_from_( const std::vector< format::element >& fields ) const
+{
+    const std::vector< boost::optional< std::size_t > >& indices = binary_->indices();
+    offsets_.resize( indices.size() );
+    for( std::size_t i = 0; i < indices.size(); ++i ) { offsets_[i] = indices[i] ? boost::optional< format::element >( fields[ *indices[i] ] ) : boost::none; }
+    return offsets_;
+}
+
 } } // namespace comma { namespace csv {
 
 #endif // #ifndef COMMA_CSV_BINARY_HEADER_GUARD_
@@ -29,7 +29,10 @@
 #include <comma/base/types.h>
 #include <comma/string/string.h>
 #include <comma/csv/format.h>
+#include "./impl/byte_swap.h"
 #include "./impl/epoch.h"
+#include "./impl/half.h"
+#include "./impl/scaled.h"
 
 namespace comma { namespace csv {
 
@@ -37,6 +40,7 @@ format::format( const std::string& f )
     : string_( f )
     , size_( 0 )
     , count_( 0 )
+    , variable_size_( false )
 {
     std::string format = comma::strip( f, " \t\r\n" );
     if( format == "" ) { return; }
@@ -45,11 +49,37 @@ format::format( const std::string& f )
     std::size_t offset = 0;
     for( unsigned int i = 0; i < v.size(); ++i )
     {
+        byte_order_enum byte_order = native;
+        if( !v[i].empty() && ( v[i][0] == '<' || v[i][0] == '>' ) ) { byte_order = v[i][0] == '<' ? little_endian : big_endian; v[i] = v[i].substr( 1 ); }
         std::string s;
         for( ; s.length() < v[i].length() && v[i][ s.length() ] >= '0' && v[i][ s.length() ] <= '9'; s += v[i][ s.length() ] );
         if( s.length() >= v[i].length() ) { COMMA_THROW( comma::exception, "expected format, got '" << v[i] << "' in " << format ); }
         std::size_t arraySize = s.empty() ? 1 : boost::lexical_cast< std::size_t >( s );
         std::string type = v[i].substr( s.length() );
+        double scale = 1;
+        double value_offset = 0;
+        std::string::size_type star = type.find( '*' );
+        if( star != std::string::npos ) // scaled integer, e.g. "uw*0.001" or "w*0.01+-20"
+        {
+            const char* begin = type.c_str() + star + 1;
+            char* end;
+            scale = ::strtod( begin, &end );
+            if( end == begin || scale == 0 ) { COMMA_THROW( comma::exception, "expected non-zero scale, got '" << v[i] << "' in " << format ); }
+            if( *end == '+' || *end == '-' )
+            {
+                begin = *end == '+' ? end + 1 : end;
+                value_offset = ::strtod( begin, &end );
+                if( end == begin ) { COMMA_THROW( comma::exception, "expected offset, got '" << v[i] << "' in " << format ); }
+            }
+            if( *end != 0 ) { COMMA_THROW( comma::exception, "expected scaled integer, e.g. \"uw*0.001\" or \"w*0.01+-20\", got '" << v[i] << "' in " << format ); }
+            type = type.substr( 0, star );
+        }
+        if( type[0] == '<' || type[0] == '>' )
+        {
+            if( byte_order != native ) { COMMA_THROW( comma::exception, "expected byte order given once, got '" << v[i] << "' in " << format ); }
+            byte_order = type[0] == '<' ? little_endian : big_endian;
+            type = type.substr( 1 );
+        }
         types_enum t;
         unsigned int size;
         if( type == "b" ) { t = format::int8; size = 1; }
@@ -65,15 +95,26 @@ format::format( const std::string& f )
         else if( type == "lt" ) { t = format::long_time; size = sizeof( comma::int32 ) + sizeof( comma::int64 ); }
         else if( type == "f" ) { t = format::float_t; size = sizeof( float ); }
         else if( type == "d" ) { t = format::double_t; size = sizeof( double ); }
-        else if( type[0] == 's' && type.length() == 1 ) { COMMA_THROW( comma::exception, "got variable size string in [" << format << "]: not implemented, use fixed size string instead, e.g. \"s[8]\"" ); }
+        else if( type == "h" ) { t = format::half_t; size = sizeof( comma::uint16 ); }
+        else if( type == "s" ) { t = format::variable_string; size = traits< std::string, format::variable_string >::size; variable_size_ = true; }
         else if( type[0] == 's' && type.length() > 3 && type[1] == '[' && *type.rbegin() == ']' )
         {
             t = format::fixed_string;
             size = boost::lexical_cast< std::size_t >( type.substr( 2, type.length() - 3 ) );
         }
+        else if( type == "x" ) { t = format::padding; size = 1; }
+        else if( type[0] == 'x' && type.length() > 3 && type[1] == '[' && *type.rbegin() == ']' )
+        {
+            t = format::padding;
+            size = boost::lexical_cast< std::size_t >( type.substr( 2, type.length() - 3 ) );
+        }
         else { COMMA_THROW( comma::exception, "expected format, got '" << type << "' in " << format ); }
-        elements_.push_back( element( offset, arraySize, size, t ) );
-        count_ += arraySize;
+        if( byte_order != native && ( t == format::fixed_string || t == format::variable_string || t == format::padding ) ) { COMMA_THROW( comma::exception, "byte order applies only to numeric types and time, got '" << v[i] << "' in " << format ); }
+        if( star != std::string::npos && ( t < format::int8 || t > format::uint64 ) ) { COMMA_THROW( comma::exception, "scale and offset apply only to integer types, got '" << v[i] << "' in " << format ); }
+        elements_.push_back( element( offset, arraySize, size, t, byte_order ) );
+        elements_.back().scale = scale;
+        elements_.back().value_offset = value_offset;
+        if( t != format::padding ) { count_ += arraySize; }
         size *= arraySize;
         offset += size;
         size_ += size;
@@ -86,7 +127,7 @@ std::string format::to_format( types_enum type, unsigned int size )
 {
     std::ostringstream oss;
     oss << to_format( type );
-    if( type == format::fixed_string ) { oss << "[" << size << "]"; }
+    if( type == format::fixed_string || ( type == format::padding && size != 1 ) ) { oss << "[" << size << "]"; }
     return oss.str();
 }
 
@@ -108,17 +149,102 @@ std::string format::to_format( format::types_enum type )
         case format::time: return "t";
         case format::long_time: return "lt";
         case format::fixed_string: return "s";
+        case format::padding: return "x";
+        case format::variable_string: return "s";
+        case format::half_t: return "h";
     }
     COMMA_THROW( comma::exception, "expected type, got " << type );
 }
 
 std::size_t format::size() const { return size_; }
 
+const std::size_t format::max_record_size;
+
 std::size_t format::count() const { return count_; }
 
-static boost::array< unsigned int, 12 > Sizesimpl()
+bool format::is_variable_size() const { return variable_size_; }
+
+std::size_t format::size( const char* buf, std::size_t available ) const
+{
+    if( !variable_size_ ) { return size_; }
+    std::size_t offset = 0;
+    std::size_t lengths = 0;
+    for( unsigned int e = 0; e < elements_.size(); ++e )
+    {
+        if( elements_[e].type != format::variable_string ) { offset += elements_[e].count * elements_[e].size; continue; }
+        for( unsigned int count = 0; count < elements_[e].count; ++count )
+        {
+            if( offset + elements_[e].size > available ) { return size_ + lengths; }
+            std::size_t length = *reinterpret_cast< const traits< std::string, format::variable_string >::length_type* >( buf + offset );
+            lengths += length;
+            if( size_ + lengths > max_record_size ) { COMMA_THROW( comma::exception, "expected variable size record of at most " << max_record_size << " bytes, got string of length " << length << " making record at least " << ( size_ + lengths ) << " bytes; corrupted data?" ); }
+            offset += elements_[e].size + length;
+        }
+    }
+    return size_ + lengths;
+}
+
+namespace impl {
+
+struct lengths_from_buffer
+{
+    const char* buf;
+    lengths_from_buffer( const char* buf ) : buf( buf ) {}
+    std::size_t operator()( std::size_t offset, std::size_t ) const { return *reinterpret_cast< const format::traits< std::string, format::variable_string >::length_type* >( buf + offset ); }
+};
+
+struct lengths_from_vector
+{
+    const std::vector< std::size_t >& lengths;
+    lengths_from_vector( const std::vector< std::size_t >& lengths ) : lengths( lengths ) {}
+    std::size_t operator()( std::size_t, std::size_t i ) const { return lengths[i]; }
+};
+
+template < typename Lengths >
+static std::size_t offsets( const std::vector< format::element >& elements, std::size_t count, Lengths lengths, std::vector< format::element >& fields )
+{
+    fields.resize( count );
+    std::size_t offset = 0;
+    unsigned int i = 0;
+    for( unsigned int e = 0; e < elements.size(); ++e )
+    {
+        if( elements[e].type == format::padding ) { offset += elements[e].count * elements[e].size; continue; }
+        for( unsigned int k = 0; k < elements[e].count; ++k, ++i )
+        {
+            fields[i] = elements[e];
+            fields[i].count = 1;
+            if( elements[e].type == format::variable_string )
+            {
+                fields[i].offset = offset + elements[e].size;
+                fields[i].size = lengths( offset, i );
+                offset += elements[e].size + fields[i].size;
+            }
+            else
+            {
+                fields[i].offset = offset;
+                offset += elements[e].size;
+            }
+        }
+    }
+    return offset;
+}
+
+} // namespace impl {
+
+std::size_t format::offsets( const char* buf, std::vector< element >& fields ) const
 {
-    boost::array< unsigned int, 12 > sizes;
+    return impl::offsets( elements_, count_, impl::lengths_from_buffer( buf ), fields );
+}
+
+std::size_t format::offsets( const std::vector< std::size_t >& lengths, std::vector< element >& fields ) const
+{
+    if( lengths.size() != count_ ) { COMMA_THROW( comma::exception, "expected " << count_ << " lengths, got " << lengths.size() ); }
+    return impl::offsets( elements_, count_, impl::lengths_from_vector( lengths ), fields );
+}
+
+static boost::array< unsigned int, 17 > Sizesimpl()
+{
+    boost::array< unsigned int, 17 > sizes;
     sizes[ format::char_t ] = sizeof( char );
     sizes[ format::int8 ] = sizeof( char );
     sizes[ format::uint8 ] = sizeof( unsigned char );
@@ -133,6 +259,9 @@ static boost::array< unsigned int, 12 > Sizesimpl()
     sizes[ format::time ] = sizeof( int64 );
     sizes[ format::long_time ] = sizeof( int64 ) + sizeof( int32 );
     sizes[ format::fixed_string ] = 0; // will it blast somewhere?
+    sizes[ format::padding ] = 1;
+    sizes[ format::variable_string ] = sizeof( format::traits< std::string, format::variable_string >::length_type ); // size of empty string
+    sizes[ format::half_t ] = sizeof( comma::uint16 );
     return sizes;
 }
 
@@ -163,16 +292,25 @@ std::string format::usage()
         << "            c  : char" << std::endl
         << "            f  : float" << std::endl
         << "            d  : double" << std::endl
-        << "            s  : variable size string (not implemented)" << std::endl
+        << "            h  : half precision float (16-bit), converted from and to float" << std::endl
+        << "            s  : variable size string (32-bit unsigned length followed by the string); record size becomes variable" << std::endl
         << "            s[<length>]  : fixed size string, e.g. \"s[4]\"" << std::endl
         << "            t  : time (64-bit signed int, number of microseconds since epoch)" << std::endl
-        << "            lt  : time (64+32 bit, seconds since epoch and nanoseconds)" << std::endl;
+        << "            lt  : time (64+32 bit, seconds since epoch and nanoseconds)" << std::endl
+        << "            x  : padding byte, never decoded or encoded and not output as csv field" << std::endl
+        << "            x[<length>]  : padding of given length, e.g. \"x[16]\" (same as \"16x\")" << std::endl
+        << "        scaled integers: integer type followed by scale and optional offset, decoded to and encoded from double, e.g." << std::endl
+        << "            uw*0.001  : range in millimetres as unsigned 16-bit int, value in metres" << std::endl
+        << "            w*0.01+-20  : 16-bit int, value = int * 0.01 - 20" << std::endl
+        << "        byte order: numeric types and time are in host byte order, unless prefixed with" << std::endl
+        << "            < : little endian, e.g. \"<ui\" or \"3<d\"" << std::endl
+        << "            > : big endian (network byte order), e.g. \">ui\" or \"3>d\"" << std::endl;
     return oss.str();
 }
 
 std::size_t format::size_of( types_enum type ) // todo: returns 0 for fixed size string, which is lame
 {
-    static boost::array< unsigned int, 12 > sizes = Sizesimpl();
+    static boost::array< unsigned int, 17 > sizes = Sizesimpl();
     return sizes[ static_cast< std::size_t >( type ) ];
 }
 
@@ -243,9 +381,12 @@ static std::size_t csv_to_bin( char* buf, const std::string& s, format::types_en
             case format::char_t: return csv_to_bin< char >( buf, s );
             case format::float_t: return csv_to_bin< float >( buf, s );
             case format::double_t: return csv_to_bin< double >( buf, s );
-            case format::time: // TODO: quick and dirty: use serialization traits
-                format::traits< boost::posix_time::ptime, format::time >::to_bin( boost::posix_time::from_iso_string( s ), buf );
-                return format::traits< boost::posix_time::ptime, format::time >::size;
+            case format::half_t:
+                format::traits< comma::uint16 >::to_bin( float_to_half( boost::lexical_cast< float >( s ) ), buf );
+                return sizeof( comma::uint16 );
+            case format::time:
+                format::traits< comma::time, format::time >::to_bin( comma::time::from_iso_string( s ), buf );
+                return format::traits< comma::time, format::time >::size;
             case format::long_time: // TODO: quick and dirty: use serialization traits
                 format::traits< boost::posix_time::ptime, format::long_time >::to_bin( boost::posix_time::from_iso_string( s ), buf );
                 return format::traits< boost::posix_time::ptime, format::long_time >::size;
@@ -286,9 +427,12 @@ static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, format:
         case format::char_t: return bin_to_csv< char >( oss, buf, precision );
         case format::float_t: return bin_to_csv< float >( oss, buf, precision );
         case format::double_t: return bin_to_csv< double >( oss, buf, precision );
+        case format::half_t:
+            withPrecision( oss, half_to_float( format::traits< comma::uint16 >::from_bin( buf ) ), precision );
+            return sizeof( comma::uint16 );
         case format::time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf, sizeof( comma::uint64 ) ) );
-            return format::traits< boost::posix_time::ptime, format::time >::size;
+            oss << format::traits< comma::time, format::time >::from_bin( buf ).to_iso_string();
+            return format::traits< comma::time, format::time >::size;
         case format::long_time:
             oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf, sizeof( comma::uint64 ) + sizeof( comma::uint32 ) ) );
             return format::traits< boost::posix_time::ptime, format::long_time >::size;
@@ -299,6 +443,21 @@ static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, format:
     }
 }
 
+static std::size_t csv_to_bin( char* buf, const std::string& s, const format::element& e )
+{
+    if( !e.scaled() ) { return csv_to_bin( buf, s, e.type, e.size ); }
+    try { scaled_to_bin( boost::lexical_cast< double >( s ), buf, e ); }
+    catch( std::exception& ex ) { COMMA_THROW( comma::exception, "for [" << s << "]: " << ex.what() ); }
+    return e.size;
+}
+
+static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, const format::element& e, const boost::optional< unsigned int >& precision )
+{
+    if( !e.scaled() ) { return bin_to_csv( oss, buf, e.type, e.size, precision ); }
+    withPrecision( oss, scaled_from_bin( buf, e ), precision );
+    return e.size;
+}
+
 } // namespace impl {
 
 void format::csv_to_bin( std::ostream& os, const std::string& csv, char delimiter ) const
@@ -310,14 +469,39 @@ void format::csv_to_bin( std::ostream& os, const std::string& csv, char delimite
 void format::csv_to_bin( std::ostream& os, const std::vector< std::string >& v ) const
 {
     if( v.size() != count_ ) { COMMA_THROW( comma::exception, "expected csv string with " << count_ << " elements, got [" << comma::join( v, ',' ) << "]" ); }
+    if( variable_size_ )
+    {
+        std::vector< std::size_t > lengths( count_ );
+        for( unsigned int i = 0; i < count_; ++i ) { lengths[i] = v[i].length(); }
+        std::vector< element > fields;
+        std::vector< char > buf( offsets( lengths, fields ) );
+        for( unsigned int i = 0; i < count_; ++i )
+        {
+            if( fields[i].type != format::variable_string )
+            {
+                impl::csv_to_bin( &buf[0] + fields[i].offset, v[i], fields[i] );
+                if( fields[i].swapped() ) { impl::byte_swap( &buf[0] + fields[i].offset, fields[i].type ); }
+                continue;
+            }
+            typedef traits< std::string, format::variable_string >::length_type length_type;
+            *reinterpret_cast< length_type* >( &buf[0] + fields[i].offset - sizeof( length_type ) ) = static_cast< length_type >( fields[i].size );
+            traits< std::string, format::variable_string >::to_bin( v[i], &buf[0] + fields[i].offset, fields[i].size );
+        }
+        os.write( &buf[0], buf.size() );
+        return;
+    }
     std::vector< char > buf( size_ ); //char buf[ size_ ]; // stupid Windows
     char* p = &buf[0];
-    unsigned int offsetIndex = 0u;
-    unsigned int count = 0u;
-    for( unsigned int i = 0; i < v.size(); ++i, ++count )
+    unsigned int i = 0;
+    for( unsigned int e = 0; e < elements_.size(); ++e )
     {
-        if( count >= elements_[ offsetIndex ].count ) { count = 0; ++offsetIndex; }
-        p += impl::csv_to_bin( p, v[i], elements_[ offsetIndex ].type, elements_[ offsetIndex ].size );
+        if( elements_[e].type == format::padding ) { p += elements_[e].count * elements_[e].size; continue; } // std::vector zeroes it
+        char* begin = p;
+        for( unsigned int count = 0; count < elements_[e].count; ++count, ++i )
+        {
+            p += impl::csv_to_bin( p, v[i], elements_[e] );
+        }
+        if( elements_[e].swapped() ) { impl::byte_swap( begin, elements_[e].type, elements_[e].count ); }
     }
     os.write( &buf[0], size_ );
 }
@@ -338,21 +522,50 @@ std::string format::csv_to_bin( const std::vector< std::string >& csv ) const
 
 std::string format::bin_to_csv( const std::string& bin, char delimiter, const boost::optional< unsigned int >& precision ) const
 {
-    if( bin.length() != size_ ) { COMMA_THROW( comma::exception, "expected binary string of size " << size_ << ", got " << bin.length() << " bytes" ); }
+    std::size_t size = this->size( bin.c_str(), bin.length() );
+    if( bin.length() != size ) { COMMA_THROW( comma::exception, "expected binary string of size " << size << ", got " << bin.length() << " bytes" ); }
     return bin_to_csv( bin.c_str(), delimiter, precision );
 }
 
 std::string format::bin_to_csv( const char* buf, char delimiter, const boost::optional< unsigned int >& precision ) const
 {
     std::ostringstream oss;
+    if( variable_size_ )
+    {
+        std::vector< element > fields;
+        offsets( buf, fields );
+        for( unsigned int i = 0; i < fields.size(); ++i )
+        {
+            if( i > 0 ) { oss << delimiter; }
+            if( fields[i].type == format::variable_string ) { oss << traits< std::string, format::variable_string >::from_bin( buf + fields[i].offset, fields[i].size ); }
+            else if( fields[i].swapped() ) { char b[16]; ::memcpy( b, buf + fields[i].offset, fields[i].size ); impl::byte_swap( b, fields[i].type ); impl::bin_to_csv( oss, b, fields[i], precision ); }
+            else { impl::bin_to_csv( oss, buf + fields[i].offset, fields[i], precision ); }
+        }
+        return oss.str();
+    }
     const char* p = buf;
-    unsigned int offsetIndex = 0u; // index in elements_
-    unsigned int count = 0u;
-    for( unsigned int i = 0u; i < count_; ++i, ++count )
+    bool first = true;
+    std::vector< char > swapped;
+    for( unsigned int e = 0; e < elements_.size(); ++e )
     {
-        if( i > 0 ) { oss << delimiter; }
-        if( count >= elements_[ offsetIndex ].count ) { count = 0; ++offsetIndex; }
-        p += impl::bin_to_csv( oss, p, elements_[ offsetIndex ].type, elements_[ offsetIndex ].size, precision );
+        if( elements_[e].type == format::padding ) { p += elements_[e].count * elements_[e].size; continue; }
+        if( elements_[e].swapped() ) // quick and dirty: swap a copy of the element in bulk
+        {
+            swapped.assign( p, p + elements_[e].count * elements_[e].size );
+            impl::byte_swap( &swapped[0], elements_[e].type, elements_[e].count );
+            for( unsigned int count = 0; count < elements_[e].count; ++count )
+            {
+                if( first ) { first = false; } else { oss << delimiter; }
+                impl::bin_to_csv( oss, &swapped[0] + count * elements_[e].size, elements_[e], precision );
+            }
+            p += elements_[e].count * elements_[e].size;
+            continue;
+        }
+        for( unsigned int count = 0; count < elements_[e].count; ++count )
+        {
+            if( first ) { first = false; } else { oss << delimiter; }
+            p += impl::bin_to_csv( oss, p, elements_[e], precision );
+        }
     }
     return oss.str();
 }
@@ -362,9 +575,11 @@ const std::vector< format::element >& format::elements() const { return elements
 std::pair< unsigned int, unsigned int > format::index( std::size_t ind ) const
 {
     unsigned int count = 0;
-    for( unsigned int i = 0; i < elements_.size(); count += elements_[i].count, ++i )
+    for( unsigned int i = 0; i < elements_.size(); ++i )
     {
+        if( elements_[i].type == format::padding ) { continue; }
         if( ind < count + elements_[i].count ) { return std::make_pair( i, ind - count ); }
+        count += elements_[i].count;
     }
     COMMA_THROW( comma::exception, "expected index less than " << count << "; got " << ind );
 }
@@ -372,10 +587,10 @@ std::pair< unsigned int, unsigned int > format::index( std::size_t ind ) const
 format::element format::offset( std::size_t ind ) const
 {
     std::pair< unsigned int, unsigned int > i = index( ind );
-    return element( elements_[ i.first ].offset + elements_[ i.first ].size * i.second
-                  , 1
-                  , elements_[ i.first ].size
-                  , elements_[ i.first ].type );
+    element e = elements_[ i.first ];
+    e.offset += e.size * i.second;
+    e.count = 1;
+    return e;
 }
 
 boost::posix_time::ptime format::traits< boost::posix_time::ptime, format::long_time >::from_bin( const char* buf, std::size_t size )
@@ -426,6 +641,29 @@ void format::traits< boost::posix_time::ptime, format::time >::to_bin( const boo
     
 }
 
+// same encoding as for boost::posix_time::ptime above: seconds rounded towards zero,
+// nanoseconds within the second of the same sign as seconds (i.e. negative before epoch)
+comma::time format::traits< comma::time, format::long_time >::from_bin( const char* buf, std::size_t size )
+{
+    (void)size;
+    comma::int64 seconds = *reinterpret_cast< const comma::int64* >( buf );
+    comma::int32 nanoseconds = *reinterpret_cast< const comma::int32* >( buf + sizeof( comma::int64 ) );
+    comma::int64 microseconds = seconds * 1000000 + nanoseconds / 1000;
+    comma::int32 remainder = nanoseconds % 1000;
+    if( remainder < 0 ) { --microseconds; remainder += 1000; }
+    return comma::time( microseconds, remainder );
+}
+
+void format::traits< comma::time, format::long_time >::to_bin( const comma::time& t, char* buf, std::size_t size )
+{
+    (void)size;
+    comma::int64 seconds = t.microseconds() / 1000000;
+    comma::int32 nanoseconds = static_cast< comma::int32 >( t.microseconds() % 1000000 ) * 1000 + static_cast< comma::int32 >( t.nanoseconds() );
+    if( seconds < 0 && nanoseconds > 0 ) { ++seconds; nanoseconds -= 1000000000; }
+    *reinterpret_cast< comma::int64* >( buf ) = seconds;
+    *reinterpret_cast< comma::int32* >( buf + sizeof( comma::int64 ) ) = nanoseconds;
+}
+
 std::string format::traits< std::string, format::fixed_string >::from_bin( const char* buf, std::size_t size )
 {
     return buf[ size - 1 ] == 0 ? std::string( buf ) : std::string( buf, size );
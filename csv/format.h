@@ -22,6 +22,7 @@
 #define COMMA_CSV_APPLICATIONS_FORMAT_HEADER_GUARD_
 
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <set>
 #include <string>
@@ -30,6 +31,7 @@
 #include <boost/type_traits.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <comma/base/exception.h>
+#include <comma/base/time.h>
 #include <comma/base/types.h>
 #include <comma/string/split.h>
 #include <comma/visiting/apply.h>
@@ -48,9 +50,19 @@ class format
 {
     public:
         /// types (implement more, as we need them)
-        /// note: currently string type is for fixed size string only
-        ///       a variable size string is tricky and we may never implement it for csv
-        enum types_enum { char_t, int8, uint8, int16, uint16, int32, uint32, int64, uint64, float_t, double_t, time, long_time, fixed_string };
+        /// note: variable size string is stored as 32-bit unsigned length followed by the string bytes;
+        ///       formats containing variable size strings have variable record size (see is_variable_size())
+        /// note: padding is a number of bytes that are never decoded or encoded;
+        ///       it does not count as a field and does not appear in csv
+        /// note: half_t is ieee 754 half precision float; it has no c++ counterpart and is converted from and to float
+        enum types_enum { char_t, int8, uint8, int16, uint16, int32, uint32, int64, uint64, float_t, double_t, time, long_time, fixed_string, padding, variable_string, half_t };
+
+        /// byte order of numeric types: host byte order, unless explicitly
+        /// given as little or big endian, e.g. "<ui" or ">d"
+        enum byte_order_enum { native, little_endian, big_endian };
+
+        /// return byte order of the host
+        static byte_order_enum host_byte_order();
 
         /// type to enum
         template < typename T > struct type_to_enum {};
@@ -70,12 +82,19 @@ class format
         /// struct containing offsets
         struct element
         {
-            element() : offset( 0 ), count( 0 ), size( 0 ) {}
-            element( std::size_t o, std::size_t c, std::size_t s, types_enum type ) : offset( o ), count( c ), size( s ), type( type ) {}
+            element() : offset( 0 ), count( 0 ), size( 0 ), byte_order( native ), scale( 1 ), value_offset( 0 ) {}
+            element( std::size_t o, std::size_t c, std::size_t s, types_enum type, byte_order_enum byte_order = native ) : offset( o ), count( c ), size( s ), type( type ), byte_order( byte_order ), scale( 1 ), value_offset( 0 ) {}
             std::size_t offset; /// offset of the 1st element
             std::size_t count;  /// number of elements; e.g. as in "3d" size will be count * size, i.e count * sizeof(double)
             std::size_t size;   /// element size; e.g. as in "3d" size will be count * size, i.e count * sizeof(double)
             types_enum type; /// element type
+            byte_order_enum byte_order; /// element byte order
+            double scale; /// for scaled integers, e.g. "uw*0.001": value = integer * scale + value_offset
+            double value_offset; /// for scaled integers, e.g. "w*0.01+-20"
+            /// return true, if element is a scaled integer, which decodes to and encodes from double
+            bool scaled() const { return scale != 1 || value_offset != 0; }
+            /// return true, if element bytes need to be swapped to get the value in host byte order
+            bool swapped() const { return byte_order != native && byte_order != host_byte_order(); }
         };
 
         /// constructor
@@ -91,8 +110,29 @@ class format
         std::pair< unsigned int, unsigned int > index( std::size_t i ) const;
         
         /// return binary buffer size
+        /// for variable size formats, return minimum record size, i.e. with all the variable size strings empty
         std::size_t size() const;
 
+        /// return true, if format contains variable size strings
+        bool is_variable_size() const;
+
+        /// return size of the record in the buffer, if the first given number of bytes contain the whole record;
+        /// otherwise return the lower bound of the record size, i.e. at least that many bytes need to be read before calling it again
+        /// (for fixed size formats, same as size())
+        /// throw, if the record would be longer than max_record_size, e.g. because of corrupt string lengths
+        std::size_t size( const char* buf, std::size_t available ) const;
+
+        /// maximum size of a variable size record: a sanity bound, since readers allocate as much as the string lengths say
+        static const std::size_t max_record_size = 256 * 1024 * 1024;
+
+        /// get offsets and sizes of all the fields of a complete record in the buffer; return record size
+        /// for variable size strings the offset and size are of the string itself, excluding the length
+        std::size_t offsets( const char* buf, std::vector< element >& fields ) const;
+
+        /// get offsets and sizes of all the fields for given lengths of variable size strings; return record size
+        /// lengths are indexed by field; lengths for other fields are ignored
+        std::size_t offsets( const std::vector< std::size_t >& lengths, std::vector< element >& fields ) const;
+
         /// return number of fields
         std::size_t count() const;
 
@@ -144,6 +184,7 @@ class format
         std::size_t size_;
         std::size_t count_;
         std::size_t elements_number_; /// total number of elements
+        bool variable_size_;
         friend class impl::to_format;
         template < typename T > static std::string value_impl( const T& t );
 };
@@ -169,7 +210,8 @@ class to_format
             append( name );
             visiting::do_while<    !boost::is_fundamental< T >::value
                                 && !boost::is_same< T, std::string >::value
-                                && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                                && !boost::is_same< T, boost::posix_time::ptime >::value
+                                && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
             trim( name );
         }
         
@@ -218,6 +260,12 @@ class to_format
 
 } // namespace impl {
 
+inline format::byte_order_enum format::host_byte_order()
+{
+    static const comma::uint16 one = 1;
+    return *reinterpret_cast< const char* >( &one ) == 1 ? little_endian : big_endian;
+}
+
 template < typename T >
 inline std::string format::value( const T& t ) { return value( "", true, t ); }
 
@@ -242,6 +290,7 @@ template <> inline std::string format::value_impl< float >( const float& ) { ret
 template <> inline std::string format::value_impl< double >( const double& ) { return "d"; }
 template <> inline std::string format::value_impl< long double >( const long double& ) { return "d"; }
 template <> inline std::string format::value_impl< boost::posix_time::ptime >( const boost::posix_time::ptime& ) { return "t"; }
+template <> inline std::string format::value_impl< comma::time >( const comma::time& ) { return "t"; }
 template <> inline std::string format::value_impl< std::string >( const std::string& s )
 { // quick and dirty
     if( s.empty() ) { return "s"; } // variable size string, todo
@@ -328,6 +377,12 @@ template <> struct format::type_to_enum< boost::posix_time::ptime >
     static const char* as_string() { return "t"; }
 };
 
+template <> struct format::type_to_enum< comma::time >
+{
+    static const format::types_enum value = format::time;
+    static const char* as_string() { return "t"; }
+};
+
 template <> struct format::type_to_enum< std::string >
 {
     static const format::types_enum value = format::fixed_string;
@@ -352,6 +407,24 @@ template <> struct format::traits< boost::posix_time::ptime, format::time >
     static void to_bin( const boost::posix_time::ptime& t, char* buf, std::size_t size = 8 );
 };
 
+template <> struct format::traits< comma::time, format::long_time >
+{
+    static const types_enum type = format::long_time;
+    static const unsigned int size = sizeof( comma::uint64 ) + sizeof( comma::uint32 );
+    static const char* as_string() { return "lt"; }
+    static comma::time from_bin( const char* buf, std::size_t size = 12 );
+    static void to_bin( const comma::time& t, char* buf, std::size_t size = 12 );
+};
+
+template <> struct format::traits< comma::time, format::time >
+{
+    static const types_enum type = format::time;
+    static const unsigned int size = sizeof( comma::uint64 );
+    static const char* as_string() { return "t"; }
+    static comma::time from_bin( const char* buf, std::size_t size = 8 ) { (void)size; return comma::time( *reinterpret_cast< const comma::int64* >( buf ) ); }
+    static void to_bin( const comma::time& t, char* buf, std::size_t size = 8 ) { (void)size; *reinterpret_cast< comma::int64* >( buf ) = t.microseconds(); }
+};
+
 template <> struct format::traits< std::string, format::fixed_string >
 {
     static const types_enum type = format::fixed_string;
@@ -360,6 +433,16 @@ template <> struct format::traits< std::string, format::fixed_string >
     static void to_bin( const std::string& t, char* buf, std::size_t size );
 };
 
+template <> struct format::traits< std::string, format::variable_string >
+{
+    typedef comma::uint32 length_type; /// type of the length preceding the string
+    static const types_enum type = format::variable_string;
+    static const unsigned int size = sizeof( length_type ); /// size of empty string
+    static const char* as_string() { return "s"; }
+    static std::string from_bin( const char* buf, std::size_t size ) { return std::string( buf, size ); }
+    static void to_bin( const std::string& t, char* buf, std::size_t size ) { (void)size; if( !t.empty() ) { ::memcpy( buf, &t[0], t.length() ); } }
+};
+
 } } // namespace comma { namespace csv {
 
 #endif // #ifndef COMMA_CSV_APPLICATIONS_FORMAT_HEADER_GUARD_
@@ -27,6 +27,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/type_traits.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <comma/base/time.h>
 #include <comma/string/string.h>
 #include <comma/visiting/apply.h>
 #include <comma/visiting/visit.h>
@@ -65,7 +66,8 @@ class asciiVisitor
             append( name );
             visiting::do_while<    !boost::is_fundamental< T >::value
                                 && !boost::is_same< T, std::string >::value
-                                && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                                && !boost::is_same< T, boost::posix_time::ptime >::value
+                                && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
             trim( name );
         }
 
@@ -86,7 +86,8 @@ class binary_visitor
             append( name );
             visiting::do_while<    !boost::is_fundamental< T >::value
                                 && !boost::is_same< T, std::string >::value
-                                && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                                && !boost::is_same< T, boost::posix_time::ptime >::value
+                                && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
             trim( name );
         }
         
@@ -101,19 +102,26 @@ class binary_visitor
 			(void)key;
             std::map< std::string, std::size_t >::const_iterator it = map_.find( full_path_as_name_ ? xpath_.to_string() : xpath_.elements.back().to_string() );
             optional_element o;
+            boost::optional< std::size_t > index;
             if( map_.empty() || it != map_.end() )
             {
                 for( std::size_t i = 0; i < empty_.size(); ++i ) { empty_[i] = false; }
                 o = offset( t, it->second );
+                index = it->second;
             }
             offsets_.push_back( o );
+            indices_.push_back( index );
         }
         
         /// a convenience type
         typedef boost::optional< format::element > optional_element;
         
         /// return field offsets
+        /// for variable size formats, only valid up to the first variable size string
         const std::vector< optional_element >& offsets() const { return offsets_; }
+
+        /// return field indices in the format
+        const std::vector< boost::optional< std::size_t > >& indices() const { return indices_; }
         
         /// return flags, which are true for optional values that are present
         const std::deque< bool >& optional() const { return optional_; }
@@ -124,6 +132,7 @@ class binary_visitor
         bool full_path_as_name_;
         xpath xpath_;
         std::vector< optional_element > offsets_;
+        std::vector< boost::optional< std::size_t > > indices_;
         std::deque< bool > empty_;
         std::deque< bool > optional_;
         const xpath& append( std::size_t index ) { xpath_.elements.back().index = index; return xpath_; }
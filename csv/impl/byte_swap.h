@@ -0,0 +1,86 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_BYTESWAP_HEADER_GUARD_
+#define COMMA_CSV_IMPL_BYTESWAP_HEADER_GUARD_
+
+#include <string.h>
+#include <algorithm>
+#include <comma/base/types.h>
+#include <comma/csv/format.h>
+
+namespace comma { namespace csv { namespace impl {
+
+inline comma::uint16 byte_swap_16( comma::uint16 v ) { return static_cast< comma::uint16 >( ( v >> 8 ) | ( v << 8 ) ); }
+
+inline comma::uint32 byte_swap_32( comma::uint32 v )
+{
+    #ifdef __GNUC__
+    return __builtin_bswap32( v );
+    #else
+    return ( v >> 24 ) | ( ( v >> 8 ) & 0x0000ff00 ) | ( ( v << 8 ) & 0x00ff0000 ) | ( v << 24 );
+    #endif
+}
+
+inline comma::uint64 byte_swap_64( comma::uint64 v )
+{
+    #ifdef __GNUC__
+    return __builtin_bswap64( v );
+    #else
+    return ( comma::uint64( byte_swap_32( comma::uint32( v ) ) ) << 32 ) | byte_swap_32( comma::uint32( v >> 32 ) );
+    #endif
+}
+
+/// reverse byte order of count contiguous values of given size in place
+/// (loops over fixed-size words are simple enough for the compiler to vectorize)
+inline void byte_swap( char* buf, std::size_t size, std::size_t count )
+{
+    switch( size )
+    {
+        case 1:
+            break;
+        case 2:
+            for( std::size_t i = 0; i < count; ++i, buf += 2 ) { comma::uint16 v; ::memcpy( &v, buf, 2 ); v = byte_swap_16( v ); ::memcpy( buf, &v, 2 ); }
+            break;
+        case 4:
+            for( std::size_t i = 0; i < count; ++i, buf += 4 ) { comma::uint32 v; ::memcpy( &v, buf, 4 ); v = byte_swap_32( v ); ::memcpy( buf, &v, 4 ); }
+            break;
+        case 8:
+            for( std::size_t i = 0; i < count; ++i, buf += 8 ) { comma::uint64 v; ::memcpy( &v, buf, 8 ); v = byte_swap_64( v ); ::memcpy( buf, &v, 8 ); }
+            break;
+        default:
+            for( std::size_t i = 0; i < count; ++i, buf += size ) { std::reverse( buf, buf + size ); }
+    }
+}
+
+/// reverse byte order of count contiguous values of given type in place
+inline void byte_swap( char* buf, format::types_enum type, std::size_t count = 1 )
+{
+    if( type != format::long_time ) { byte_swap( buf, format::size_of( type ), count ); return; }
+    for( std::size_t i = 0; i < count; ++i, buf += sizeof( comma::int64 ) + sizeof( comma::int32 ) ) // seconds and nanoseconds are swapped separately
+    {
+        byte_swap( buf, sizeof( comma::int64 ), 1 );
+        byte_swap( buf + sizeof( comma::int64 ), sizeof( comma::int32 ), 1 );
+    }
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // #ifndef COMMA_CSV_IMPL_BYTESWAP_HEADER_GUARD_
@@ -22,6 +22,7 @@
 #define COMMA_CSV_IMPL_FROMASCII_HEADER_GUARD_
 
 #include <deque>
+#include <stdexcept>
 #include <vector>
 #include <boost/lexical_cast.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -30,6 +31,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/type_traits.hpp>
 #include <comma/base/exception.h>
+#include <comma/base/time.h>
 #include <comma/visiting/visit.h>
 #include <comma/visiting/while.h>
 
@@ -41,9 +43,12 @@ class from_ascii_
 {
     public:
         /// constructor
+        /// @param errors if not NULL, fields that fail to parse are left unchanged
+        ///               and counted in errors, rather than throwing
         from_ascii_( const std::vector< boost::optional< std::size_t > >& indices
                   , const std::deque< bool >& optional
-                  , const std::vector< std::string >& line );
+                  , const std::vector< std::string >& line
+                  , std::size_t* errors = NULL );
         
         /// apply
         template < typename K, typename T > void apply( const K& name, boost::optional< T >& value );
@@ -69,9 +74,11 @@ class from_ascii_
         const std::vector< std::string >& row_;
         std::size_t index_;
         std::size_t optional_index;
+        std::size_t* errors_;
         static void lexical_cast_( char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< char >( boost::lexical_cast< int >( s ) ); }
         static void lexical_cast_( unsigned char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< unsigned char >( boost::lexical_cast< unsigned int >( s ) ); }
         static void lexical_cast_( boost::posix_time::ptime& v, const std::string& s ) { v = boost::posix_time::from_iso_string( s ); }
+        static void lexical_cast_( comma::time& v, const std::string& s ) { v = comma::time::from_iso_string( s ); }
         static void lexical_cast_( std::string& v, const std::string& s ) { v = comma::strip( s, "\"" ); }
         static void lexical_cast_( bool& v, const std::string& s ) { v = static_cast< bool >( boost::lexical_cast< unsigned int >( s ) ); }
         template < typename T >
@@ -80,12 +87,14 @@ class from_ascii_
 
 inline from_ascii_::from_ascii_( const std::vector< boost::optional< std::size_t > >& indices
                            , const std::deque< bool >& optional
-                           , const std::vector< std::string >& line )
+                           , const std::vector< std::string >& line
+                           , std::size_t* errors )
     : indices_( indices )
     , optional_( optional )
     , row_( line )
     , index_( 0 )
     , optional_index( 0 )
+    , errors_( errors )
 {
 }
 
@@ -118,7 +127,8 @@ inline void from_ascii_::apply( const K& name, T& value )
 {
     visiting::do_while<    !boost::is_fundamental< T >::value
                         && !boost::is_same< T, std::string >::value
-                        && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                        && !boost::is_same< T, boost::posix_time::ptime >::value
+                        && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
 }
 
 template < typename K, typename T >
@@ -131,9 +141,16 @@ inline void from_ascii_::apply_final( const K& key, T& value )
     if( indices_[ index_ ] )
     {
         std::size_t i = *indices_[ index_ ];
-        if( i >= row_.size() ) { COMMA_THROW( comma::exception, "got column index " << i << ", for " << row_.size() << " column(s) in line: \"" << join( row_, ',' ) << "\"" ); }
-        const std::string& s = row_[i];
-        if( !s.empty() ) { lexical_cast_( value, s ); }
+        if( i >= row_.size() )
+        {
+            if( !errors_ ) { COMMA_THROW( comma::exception, "got column index " << i << ", for " << row_.size() << " column(s) in line: \"" << join( row_, ',' ) << "\"" ); }
+            ++*errors_;
+        }
+        else if( !row_[i].empty() )
+        {
+            if( !errors_ ) { lexical_cast_( value, row_[i] ); }
+            else { try { lexical_cast_( value, row_[i] ); } catch( boost::bad_lexical_cast& ) { ++*errors_; } catch( std::out_of_range& ) { ++*errors_; } } // bad values only, e.g. boost date errors are out_of_range
+        }
     }
     ++index_;
 }
@@ -23,7 +23,9 @@
 
 #include <string.h>
 #include <deque>
+#include <stdexcept>
 #include <vector>
+#include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
@@ -32,6 +34,9 @@
 #include <comma/csv/format.h>
 #include <comma/visiting/visit.h>
 #include <comma/visiting/while.h>
+#include "./byte_swap.h"
+#include "./half.h"
+#include "./scaled.h"
 #include "./static_cast.h"
 
 namespace comma { namespace csv { namespace impl {
@@ -42,9 +47,12 @@ class frobinary_
 {
     public:
         /// constructor
+        /// @param errors if not NULL, fields with values that fail to convert are left unchanged
+        ///               and counted in errors, rather than throwing; type mismatches still throw
         frobinary_( const std::vector< boost::optional< format::element > >& offsets
                   , const std::deque< bool >& optional
-                  , const char* buf );
+                  , const char* buf
+                  , std::size_t* errors = NULL );
         
         /// apply
         template < typename K, typename T > void apply( const K& name, boost::optional< T >& value );
@@ -70,6 +78,8 @@ class frobinary_
         std::size_t optional_index;
         const char* buf_;
         std::size_t index_;
+        std::size_t* errors_;
+        template < typename T > void get_( T& value, const format::element& e ) const;
 //         static void copy( boost::posix_time::ptime& v, const char* buf, std::size_t )
 //         {
 //             int64 seconds;
@@ -88,12 +98,14 @@ class frobinary_
 
 inline frobinary_::frobinary_( const std::vector< boost::optional< format::element > >& offsets
                                , const std::deque< bool >& optional
-                               , const char* buf )
+                               , const char* buf
+                               , std::size_t* errors )
     : offsets_( offsets )
     , optional_( optional )
     , optional_index( 0 )
     , buf_( buf )
     , index_( 0 )
+    , errors_( errors )
 {
 }
 
@@ -126,7 +138,8 @@ inline void frobinary_::apply( const K& name, T& value )
 {
     visiting::do_while<    !boost::is_fundamental< T >::value
                         && !boost::is_same< T, std::string >::value
-                        && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                        && !boost::is_same< T, boost::posix_time::ptime >::value
+                        && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
 }
 
 template < typename K, typename T >
@@ -138,37 +151,53 @@ inline void frobinary_::apply_final( const K&, T& value )
     //if( offsets_[ index_ ] ) { copy( value, buf_ + offsets_[ index_ ]->offset, offsets_[ index_ ]->size ); }
     if( offsets_[ index_ ] )
     {
-        const char* buf = buf_ + offsets_[ index_ ]->offset;
-        std::size_t size = offsets_[ index_ ]->size;
-        format::types_enum type = offsets_[ index_ ]->type;
-        if( type == format::traits< T >::type ) // quick path
-        {
-            value = format::traits< T >::from_bin( buf, size ); // copy( value, buf, size );
-        }
-        else
-        {
-            switch( type )
-            {
-                case format::int8: value = static_cast_impl< T >::value( format::traits< char >::from_bin( buf ) ); break;
-                case format::uint8: value = static_cast_impl< T >::value( format::traits< unsigned char >::from_bin( buf ) ); break;
-                case format::int16: value = static_cast_impl< T >::value( format::traits< comma::int16 >::from_bin( buf ) ); break;
-                case format::uint16: value = static_cast_impl< T >::value( format::traits< comma::uint16 >::from_bin( buf ) ); break;
-                case format::int32: value = static_cast_impl< T >::value( format::traits< comma::int32 >::from_bin( buf ) ); break;
-                case format::uint32: value = static_cast_impl< T >::value( format::traits< comma::uint32 >::from_bin( buf ) ); break;
-                case format::int64: value = static_cast_impl< T >::value( format::traits< comma::int64 >::from_bin( buf ) ); break;
-                case format::uint64: value = static_cast_impl< T >::value( format::traits< comma::uint64 >::from_bin( buf ) ); break;
-                case format::char_t: value = static_cast_impl< T >::value( format::traits< char >::from_bin( buf ) ); break;
-                case format::float_t: value = static_cast_impl< T >::value( format::traits< float >::from_bin( buf ) ); break;
-                case format::double_t: value = static_cast_impl< T >::value( format::traits< double >::from_bin( buf ) ); break;
-                case format::time: value = static_cast_impl< T >::value( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf ) ); break;
-                case format::long_time: value = static_cast_impl< T >::value( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf ) ); break;
-                case format::fixed_string: value = static_cast_impl< T >::value( format::traits< std::string >::from_bin( buf, size ) ); break;
-            };
-        }
+        if( !errors_ ) { get_( value, *offsets_[ index_ ] ); }
+        else { try { get_( value, *offsets_[ index_ ] ); } catch( boost::bad_lexical_cast& ) { ++*errors_; } catch( std::out_of_range& ) { ++*errors_; } } // bad values only; type mismatches still throw
     }
     ++index_;
 }
 
+template < typename T >
+inline void frobinary_::get_( T& value, const format::element& e ) const
+{
+    const char* buf = buf_ + e.offset;
+    std::size_t size = e.size;
+    format::types_enum type = e.type;
+    char swapped[16]; // big enough for any numeric type or time
+    if( e.swapped() ) { ::memcpy( swapped, buf, size ); byte_swap( swapped, type ); buf = swapped; }
+    if( e.scaled() )
+    {
+        value = static_cast_impl< T >::value( scaled_from_bin( buf, e ) );
+    }
+    else if( type == format::traits< T >::type ) // quick path
+    {
+        value = format::traits< T >::from_bin( buf, size ); // copy( value, buf, size );
+    }
+    else
+    {
+        switch( type )
+        {
+            case format::int8: value = static_cast_impl< T >::value( format::traits< char >::from_bin( buf ) ); break;
+            case format::uint8: value = static_cast_impl< T >::value( format::traits< unsigned char >::from_bin( buf ) ); break;
+            case format::int16: value = static_cast_impl< T >::value( format::traits< comma::int16 >::from_bin( buf ) ); break;
+            case format::uint16: value = static_cast_impl< T >::value( format::traits< comma::uint16 >::from_bin( buf ) ); break;
+            case format::int32: value = static_cast_impl< T >::value( format::traits< comma::int32 >::from_bin( buf ) ); break;
+            case format::uint32: value = static_cast_impl< T >::value( format::traits< comma::uint32 >::from_bin( buf ) ); break;
+            case format::int64: value = static_cast_impl< T >::value( format::traits< comma::int64 >::from_bin( buf ) ); break;
+            case format::uint64: value = static_cast_impl< T >::value( format::traits< comma::uint64 >::from_bin( buf ) ); break;
+            case format::char_t: value = static_cast_impl< T >::value( format::traits< char >::from_bin( buf ) ); break;
+            case format::float_t: value = static_cast_impl< T >::value( format::traits< float >::from_bin( buf ) ); break;
+            case format::double_t: value = static_cast_impl< T >::value( format::traits< double >::from_bin( buf ) ); break;
+            case format::time: value = static_cast_impl< T >::value( format::traits< comma::time, format::time >::from_bin( buf ) ); break;
+            case format::long_time: value = static_cast_impl< T >::value( format::traits< comma::time, format::long_time >::from_bin( buf ) ); break;
+            case format::fixed_string: value = static_cast_impl< T >::value( format::traits< std::string >::from_bin( buf, size ) ); break;
+            case format::padding: break; // never here, since padding is not a field
+            case format::half_t: value = static_cast_impl< T >::value( half_to_float( format::traits< comma::uint16 >::from_bin( buf ) ) ); break;
+            case format::variable_string: value = static_cast_impl< T >::value( format::traits< std::string, format::variable_string >::from_bin( buf, size ) ); break;
+        };
+    }
+}
+
 } } } // namespace comma { namespace csv { namespace impl {
 
 #endif // #ifndef COMMA_CSV_IMPL_FROMBINARY_HEADER_GUARD_
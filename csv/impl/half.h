@@ -0,0 +1,85 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_HALF_HEADER_GUARD_
+#define COMMA_CSV_IMPL_HALF_HEADER_GUARD_
+
+#include <string.h>
+#include <comma/base/types.h>
+
+namespace comma { namespace csv { namespace impl {
+
+/// convert ieee 754 half precision float (binary16) to float
+inline float half_to_float( comma::uint16 h )
+{
+    comma::uint32 sign = comma::uint32( h & 0x8000 ) << 16;
+    comma::uint32 exponent = ( h >> 10 ) & 0x1f;
+    comma::uint32 mantissa = h & 0x3ff;
+    comma::uint32 x;
+    if( exponent == 0x1f ) { x = sign | 0x7f800000 | ( mantissa << 13 ); } // infinity or nan
+    else if( exponent != 0 ) { x = sign | ( ( exponent + 127 - 15 ) << 23 ) | ( mantissa << 13 ); }
+    else if( mantissa == 0 ) { x = sign; }
+    else // subnormal: normalize
+    {
+        exponent = 127 - 15 + 1;
+        for( ; !( mantissa & 0x400 ); mantissa <<= 1, --exponent );
+        x = sign | ( exponent << 23 ) | ( ( mantissa & 0x3ff ) << 13 );
+    }
+    float f;
+    ::memcpy( &f, &x, sizeof( float ) );
+    return f;
+}
+
+/// convert float to ieee 754 half precision float (binary16), rounding to nearest even
+inline comma::uint16 float_to_half( float f )
+{
+    comma::uint32 x;
+    ::memcpy( &x, &f, sizeof( float ) );
+    comma::uint32 sign = ( x >> 16 ) & 0x8000;
+    comma::uint32 exponent = ( x >> 23 ) & 0xff;
+    comma::uint32 mantissa = x & 0x7fffff;
+    if( exponent == 0xff ) { return static_cast< comma::uint16 >( sign | 0x7c00 | ( mantissa ? 0x200 : 0 ) ); } // infinity or nan
+    int e = int( exponent ) - 127 + 15;
+    if( e >= 31 ) { return static_cast< comma::uint16 >( sign | 0x7c00 ); } // too big: infinity
+    comma::uint32 half;
+    comma::uint32 rest;
+    comma::uint32 halfway;
+    if( e > 0 )
+    {
+        half = sign | ( comma::uint32( e ) << 10 ) | ( mantissa >> 13 );
+        rest = mantissa & 0x1fff;
+        halfway = 0x1000;
+    }
+    else // subnormal or zero
+    {
+        if( e < -10 ) { return static_cast< comma::uint16 >( sign ); }
+        unsigned int shift = 14 - e;
+        mantissa |= 0x800000;
+        half = sign | ( mantissa >> shift );
+        rest = mantissa & ( ( 1u << shift ) - 1 );
+        halfway = 1u << ( shift - 1 );
+    }
+    if( rest > halfway || ( rest == halfway && ( half & 1 ) ) ) { ++half; } // carry into exponent is correct rounding
+    return static_cast< comma::uint16 >( half );
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // #ifndef COMMA_CSV_IMPL_HALF_HEADER_GUARD_
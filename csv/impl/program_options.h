@@ -44,7 +44,8 @@ inline boost::program_options::options_description program_options::description(
         ( "binary,b", boost::program_options::value< std::string >(), "csv binary format" )
         ( "delimiter,d", boost::program_options::value< char >()->default_value( ',' ), "csv delimiter" )
         ( "full-xpath", "expect full xpaths as field names" )
-        ( "precision", boost::program_options::value< unsigned int >()->default_value( 6 ), "floating point precision" );
+        ( "precision", boost::program_options::value< unsigned int >()->default_value( 6 ), "floating point precision" )
+        ( "on-error", boost::program_options::value< std::string >()->default_value( "throw" ), "what to do with input records that fail to parse: throw, skip, or default" );
     return d;
 }
 
@@ -56,6 +57,7 @@ inline csv::options program_options::get( const boost::program_options::variable
     if( vm.count("precision") ) { csv.precision = vm[ "precision" ].as< unsigned int >(); }
     if( vm.count("binary") ) { csv.format( vm[ "binary" ].as< std::string >() ); }
     if( vm.count( "full-xpath" ) ) { csv.full_xpath = true; }
+    if( vm.count( "on-error" ) ) { csv.on_error = impl::on_error_from_string( vm[ "on-error" ].as< std::string >() ); }
     return csv;
 }
 
@@ -0,0 +1,83 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_SCALED_HEADER_GUARD_
+#define COMMA_CSV_IMPL_SCALED_HEADER_GUARD_
+
+#include <cmath>
+#include <limits>
+#include <comma/base/exception.h>
+#include <comma/base/types.h>
+#include <comma/csv/format.h>
+
+namespace comma { namespace csv { namespace impl {
+
+template < typename T >
+inline void integer_to_bin_( double value, char* buf )
+{
+    double rounded = value < 0 ? std::ceil( value - 0.5 ) : std::floor( value + 0.5 );
+    // max() + 1 is a power of two, exact as double; max() itself is not for 64-bit types and would round up to it
+    if( !( rounded >= double( std::numeric_limits< T >::min() ) && rounded < std::ldexp( 1.0, std::numeric_limits< T >::digits ) ) ) { COMMA_THROW( comma::exception, "value " << value << " out of range of " << format::type_to_enum< T >::as_string() ); }
+    format::traits< T >::to_bin( static_cast< T >( rounded ), buf );
+}
+
+/// return value of an integer field of a given type as double
+inline double integer_from_bin( const char* buf, format::types_enum type )
+{
+    switch( type )
+    {
+        case format::int8: return format::traits< char >::from_bin( buf );
+        case format::uint8: return format::traits< unsigned char >::from_bin( buf );
+        case format::int16: return format::traits< comma::int16 >::from_bin( buf );
+        case format::uint16: return format::traits< comma::uint16 >::from_bin( buf );
+        case format::int32: return format::traits< comma::int32 >::from_bin( buf );
+        case format::uint32: return format::traits< comma::uint32 >::from_bin( buf );
+        case format::int64: return double( format::traits< comma::int64 >::from_bin( buf ) );
+        case format::uint64: return double( format::traits< comma::uint64 >::from_bin( buf ) );
+        default: COMMA_THROW( comma::exception, "expected integer type, got " << format::to_format( type ) );
+    }
+}
+
+/// round value and write it as integer of a given type; throw, if out of range
+inline void integer_to_bin( double value, char* buf, format::types_enum type )
+{
+    switch( type )
+    {
+        case format::int8: integer_to_bin_< char >( value, buf ); break;
+        case format::uint8: integer_to_bin_< unsigned char >( value, buf ); break;
+        case format::int16: integer_to_bin_< comma::int16 >( value, buf ); break;
+        case format::uint16: integer_to_bin_< comma::uint16 >( value, buf ); break;
+        case format::int32: integer_to_bin_< comma::int32 >( value, buf ); break;
+        case format::uint32: integer_to_bin_< comma::uint32 >( value, buf ); break;
+        case format::int64: integer_to_bin_< comma::int64 >( value, buf ); break;
+        case format::uint64: integer_to_bin_< comma::uint64 >( value, buf ); break;
+        default: COMMA_THROW( comma::exception, "expected integer type, got " << format::to_format( type ) );
+    }
+}
+
+/// return value of a scaled integer, i.e. integer * scale + offset
+inline double scaled_from_bin( const char* buf, const format::element& e ) { return integer_from_bin( buf, e.type ) * e.scale + e.value_offset; }
+
+/// write value as scaled integer, i.e. as rounded ( value - offset ) / scale
+inline void scaled_to_bin( double value, char* buf, const format::element& e ) { integer_to_bin( ( value - e.value_offset ) / e.scale, buf, e.type ); }
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // #ifndef COMMA_CSV_IMPL_SCALED_HEADER_GUARD_
@@ -23,6 +23,7 @@
 
 #include <string.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <comma/base/time.h>
 
 namespace comma { namespace csv { namespace impl {
 
@@ -30,6 +31,7 @@ template < typename T > struct static_cast_impl
 {
     static const T value( const std::string& s ) { COMMA_THROW( comma::exception, "cannot cast string " << s << " to given type" ); }
     static const T value( const boost::posix_time::ptime& s ) { COMMA_THROW( comma::exception, "cannot cast time " << boost::posix_time::to_iso_string( s ) << " to given type" ); }
+    static const T value( const comma::time& s ) { COMMA_THROW( comma::exception, "cannot cast time " << s.to_iso_string() << " to given type" ); }
     static const T& value( const T& t ) { return t; }
     template < typename S > static T value( const S& s ) { return static_cast< T >( s ); }
 };
@@ -43,9 +45,17 @@ template <> struct static_cast_impl< std::string >
 template <> struct static_cast_impl< boost::posix_time::ptime >
 {
     static const boost::posix_time::ptime& value( const boost::posix_time::ptime& t ) { return t; }
+    static boost::posix_time::ptime value( const comma::time& t ) { return t.to_ptime(); }
     template < typename S > static boost::posix_time::ptime value( const S& s ) { COMMA_THROW( comma::exception, "cannot cast " << s << " to time" ); }
 };
 
+template <> struct static_cast_impl< comma::time >
+{
+    static const comma::time& value( const comma::time& t ) { return t; }
+    static comma::time value( const boost::posix_time::ptime& t ) { return comma::time( t ); }
+    template < typename S > static comma::time value( const S& s ) { COMMA_THROW( comma::exception, "cannot cast " << s << " to time" ); }
+};
+
 } } } // namespace comma { namespace csv { namespace impl {
 
 #endif // #ifndef COMMA_CSV_IMPL_STATICCAST_HEADER_GUARD_
@@ -27,6 +27,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/type_traits.hpp>
+#include <comma/base/time.h>
 #include <comma/visiting/visit.h>
 #include <comma/visiting/while.h>
 
@@ -70,6 +71,7 @@ class to_ascii
         std::size_t index_;
         boost::optional< unsigned int > precision_;
         std::string as_string_( const boost::posix_time::ptime& v ) { return to_iso_string( v ); }
+        std::string as_string_( const comma::time& v ) { return v.to_iso_string(); }
         std::string as_string_( const std::string& v ) { return std::string( "\"" ) + v + "\""; } // todo: escape/unescape
         // todo: better output semantics for char/unsigned char
         std::string as_string_( const char& v ) { std::ostringstream oss; oss << static_cast< int >( v ); return oss.str(); }
@@ -114,7 +116,8 @@ inline void to_ascii::apply( const K& name, const T& value )
 {
     visiting::do_while<    !boost::is_fundamental< T >::value
                         && !boost::is_same< T, std::string >::value
-                        && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                        && !boost::is_same< T, boost::posix_time::ptime >::value
+                        && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
 }
 
 template < typename K, typename T >
@@ -31,6 +31,9 @@
 #include <comma/csv/format.h>
 #include <comma/visiting/visit.h>
 #include <comma/visiting/while.h>
+#include "./byte_swap.h"
+#include "./half.h"
+#include "./scaled.h"
 #include "./static_cast.h"
 
 namespace comma { namespace csv { namespace impl {
@@ -118,7 +121,8 @@ inline void to_binary::apply( const K& name, const T& value )
 {
     visiting::do_while<    !boost::is_fundamental< T >::value
                      && !boost::is_same< T, std::string >::value
-                     && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                     && !boost::is_same< T, boost::posix_time::ptime >::value
+                     && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
 }
 
 template < typename K, typename T >
@@ -133,7 +137,11 @@ inline void to_binary::apply_final( const K&, const T& value )
         char* buf = buf_ + offsets_[ index_ ]->offset;
         std::size_t size = offsets_[ index_ ]->size;
         format::types_enum type = offsets_[ index_ ]->type;
-        if( type == format::traits< T >::type ) // quick path
+        if( offsets_[ index_ ]->scaled() )
+        {
+            scaled_to_bin( static_cast_impl< double >::value( value ), buf, *offsets_[ index_ ] );
+        }
+        else if( type == format::traits< T >::type ) // quick path
         {
             format::traits< T >::to_bin( value, buf, size ); //copy( buf, value, size );
         }
@@ -152,15 +160,77 @@ inline void to_binary::apply_final( const K&, const T& value )
                 case format::char_t: format::traits< char >::to_bin( static_cast_impl< char >::value( value ), buf ); break;
                 case format::float_t: format::traits< float >::to_bin( static_cast_impl< float >::value( value ), buf ); break;
                 case format::double_t: format::traits< double >::to_bin( static_cast_impl< double >::value( value ), buf ); break;
-                case format::time: format::traits< boost::posix_time::ptime, format::time >::to_bin( static_cast_impl< boost::posix_time::ptime >::value( value ), buf ); break;
-                case format::long_time: format::traits< boost::posix_time::ptime, format::long_time >::to_bin( static_cast_impl< boost::posix_time::ptime >::value( value ), buf ); break;
+                case format::time: format::traits< comma::time, format::time >::to_bin( static_cast_impl< comma::time >::value( value ), buf ); break;
+                case format::long_time: format::traits< comma::time, format::long_time >::to_bin( static_cast_impl< comma::time >::value( value ), buf ); break;
                 case format::fixed_string: format::traits< std::string >::to_bin( static_cast_impl< std::string >::value( value ), buf, size ); break;
+                case format::padding: break; // never here, since padding is not a field
+                case format::half_t: format::traits< comma::uint16 >::to_bin( float_to_half( static_cast_impl< float >::value( value ) ), buf ); break;
+                case format::variable_string: format::traits< std::string, format::variable_string >::to_bin( static_cast_impl< std::string >::value( value ), buf, size ); break;
             };
         }
+        if( offsets_[ index_ ]->swapped() ) { byte_swap( buf, type ); }
     }
     ++index_;
 }
 
+/// visitor collecting lengths of variable size strings of a struct,
+/// so that the layout of a variable size record can be worked out before writing it
+class to_binary_lengths
+{
+    public:
+        /// constructor
+        to_binary_lengths( const std::vector< boost::optional< format::element > >& offsets
+                         , const std::vector< boost::optional< std::size_t > >& indices
+                         , std::vector< std::size_t >& lengths );
+
+        /// apply
+        template < typename K, typename T > void apply( const K& name, const boost::optional< T >& value ) { if( value ) { apply( name, *value ); } }
+
+        /// apply
+        template < typename K, typename T > void apply( const K& name, const boost::scoped_ptr< T >& value ) { if( value ) { apply( name, *value ); } }
+
+        /// apply
+        template < typename K, typename T > void apply( const K& name, const boost::shared_ptr< T >& value ) { if( value ) { apply( name, *value ); } }
+
+        /// apply
+        template < typename K, typename T >
+        void apply( const K& name, const T& value )
+        {
+            visiting::do_while<    !boost::is_fundamental< T >::value
+                                && !boost::is_same< T, std::string >::value
+                                && !boost::is_same< T, boost::posix_time::ptime >::value
+                                && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
+        }
+
+        /// apply to non-leaf elements
+        template < typename K, typename T >
+        void apply_next( const K& name, const T& value ) { comma::visiting::visit( name, value, *this ); }
+
+        /// apply to leaf elements
+        template < typename K, typename T >
+        void apply_final( const K&, const T& value )
+        {
+            if( offsets_[ index_ ] && offsets_[ index_ ]->type == format::variable_string ) { lengths_[ *indices_[ index_ ] ] = static_cast_impl< std::string >::value( value ).length(); }
+            ++index_;
+        }
+
+    private:
+        const std::vector< boost::optional< format::element > >& offsets_;
+        const std::vector< boost::optional< std::size_t > >& indices_;
+        std::vector< std::size_t >& lengths_;
+        std::size_t index_;
+};
+
+inline to_binary_lengths::to_binary_lengths( const std::vector< boost::optional< format::element > >& offsets
+                                           , const std::vector< boost::optional< std::size_t > >& indices
+                                           , std::vector< std::size_t >& lengths )
+    : offsets_( offsets )
+    , indices_( indices )
+    , lengths_( lengths )
+    , index_( 0 )
+{
+}
+
 } } } // namespace comma { namespace csv { namespace impl {
 
 #endif // #ifndef COMMA_CSV_IMPL_TOBINARY_HEADER_GUARD_
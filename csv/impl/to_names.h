@@ -27,6 +27,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/type_traits.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <comma/base/time.h>
 #include <comma/visiting/traits.h>
 #include <comma/visiting/visit.h>
 #include <comma/visiting/while.h>
@@ -111,7 +112,8 @@ inline void to_names::apply( const K& name, const T& value )
 {
     visiting::do_while<    !boost::is_fundamental< T >::value
                      && !boost::is_same< T, std::string >::value
-                     && !boost::is_same< T, boost::posix_time::ptime >::value >::visit( name, value, *this );
+                     && !boost::is_same< T, boost::posix_time::ptime >::value
+                     && !boost::is_same< T, comma::time >::value >::visit( name, value, *this );
 }
 
 template < typename K, typename T >
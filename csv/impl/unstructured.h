@@ -108,6 +108,7 @@ struct unstructured
                     //break;
                 case comma::csv::format::float_t:
                 case comma::csv::format::double_t:
+                case comma::csv::format::half_t:
                     v[i] = "d[" + boost::lexical_cast< std::string >( p.first.doubles.size() ) + "]";
                     p.first.doubles.resize( p.first.doubles.size() + 1 );
                     p.first.doubles.back() = 0;
@@ -118,9 +119,12 @@ struct unstructured
                     p.first.timestamps.resize( p.first.timestamps.size() + 1 );
                     break;
                 case comma::csv::format::fixed_string:
+                case comma::csv::format::variable_string:
                     v[i] = "s[" + boost::lexical_cast< std::string >( p.first.strings.size() ) + "]";
                     p.first.strings.resize( p.first.strings.size() + 1 );
                     break;
+                case comma::csv::format::padding: // never here, since padding is not a field
+                    break;
             }
         } 
         p.second.fields = comma::join( v, ',' );
@@ -147,7 +151,7 @@ struct unstructured
                 }
                 catch ( ... ) // way quick and dirty
                 {
-                    f += "s[1024]";
+                    f += "s";
                 }
             }
         }
@@ -24,6 +24,7 @@
 #include <sstream>
 #include <boost/program_options.hpp>
 #include <comma/application/command_line_options.h>
+#include <comma/base/exception.h>
 #include <comma/csv/format.h>
 #include <comma/string/string.h>
 #include <comma/visiting/traits.h>
@@ -62,6 +63,14 @@ class options
         /// precision
         unsigned int precision;
 
+        /// what to do with input records that fail to parse
+        enum on_error_enum { on_error_throw     // throw exception (default)
+                           , on_error_skip      // skip record and count it
+                           , on_error_default }; // substitute fields that fail to parse with defaults and count the record
+
+        /// what to do with input records that fail to parse
+        on_error_enum on_error;
+
         /// return format
         const csv::format& format() const { return *format_; }
         
@@ -86,6 +95,14 @@ class options
 
 namespace impl {
 
+inline static options::on_error_enum on_error_from_string( const std::string& s )
+{
+    if( s == "throw" ) { return options::on_error_throw; }
+    if( s == "skip" ) { return options::on_error_skip; }
+    if( s == "default" ) { return options::on_error_default; }
+    COMMA_THROW( comma::exception, "expected on-error policy: throw, skip, or default; got \"" << s << "\"" );
+}
+
 inline static void init( comma::csv::options& csvoptions, const comma::command_line_options& options, const std::string& defaultFields )
 {
     csvoptions.full_xpath = options.exists( "--full-xpath" );
@@ -100,11 +117,12 @@ inline static void init( comma::csv::options& csvoptions, const comma::command_l
     }
     csvoptions.precision = options.value< unsigned int >( "--precision", 6 );
     csvoptions.delimiter = options.exists( "--delimiter" ) ? options.value( "--delimiter", ',' ) : options.value( "-d", ',' );
+    csvoptions.on_error = on_error_from_string( options.value< std::string >( "--on-error", "throw" ) );
 }
 
 } // namespace impl {
 
-inline options::options() : full_xpath( false ), delimiter( ',' ), precision( 6 ) {}
+inline options::options() : full_xpath( false ), delimiter( ',' ), precision( 6 ), on_error( on_error_throw ) {}
     
 inline options::options( int argc, char** argv, const std::string& defaultFields )
 {
@@ -124,6 +142,10 @@ inline std::string options::usage()
     oss << "    --fields,-f <names> : field names, e.g. t,,x,y,z" << std::endl;
     oss << "    --full-xpath : expect full xpaths as field names" << std::endl;
     oss << "    --precision <precision> : floating point precision; default: 6" << std::endl;
+    oss << "    --on-error <policy> : what to do with input records that fail to parse; default: throw" << std::endl;
+    oss << "        throw: exit with error" << std::endl;
+    oss << "        skip: skip record" << std::endl;
+    oss << "        default: substitute fields that fail to parse with default values" << std::endl;
     oss << format::usage();
     return oss.str();
 }
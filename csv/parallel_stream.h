@@ -0,0 +1,381 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_PARALLEL_STREAM_H_
+#define COMMA_CSV_PARALLEL_STREAM_H_
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <comma/base/exception.h>
+#include <comma/csv/ascii.h>
+#include <comma/csv/binary.h>
+#include <comma/csv/options.h>
+#include <comma/string/string.h>
+
+namespace comma { namespace csv {
+
+/// parallel record processing: a reading thread reads raw records (ascii lines
+/// or binary records) in batches, a pool of worker threads parses them, applies
+/// a functor and serialises the results, and the calling thread writes the
+/// results in the order of input
+///
+/// the functor signature is bool f( const Input& input, Output& output );
+/// it returns false, if the record should be dropped; each worker thread
+/// gets its own copy of the functor, but the functor still must not modify
+/// any shared state without synchronisation
+///
+/// usage:
+///     comma::csv::parallel_stream< input_t, output_t > stream( std::cin, input_csv, std::cout, output_csv );
+///     stream.run( my_functor() );
+template < typename Input, typename Output >
+class parallel_stream : public boost::noncopyable
+{
+    public:
+        /// what to output for each record, for which the functor returned true
+        enum what_enum { result         // output only
+                       , input          // input record as is, i.e. filter
+                       , input_and_result }; // input record followed by output
+
+        /// constructor
+        /// @param threads number of worker threads; 0: number of hardware threads
+        /// @param batch_size number of records per batch passed to a worker thread
+        parallel_stream( std::istream& is
+                       , const csv::options& input_options
+                       , std::ostream& os
+                       , const csv::options& output_options
+                       , what_enum what = result
+                       , unsigned int threads = 0
+                       , std::size_t batch_size = 1024
+                       , const Input& input_sample = Input()
+                       , const Output& output_sample = Output() );
+
+        /// read input until end of stream, process it, and write the output;
+        /// throw, if reading, processing, or writing failed
+        /// @note on failure, the reading thread may remain blocked on input;
+        ///       it will be detached and will exit when input ends
+        template < typename F >
+        void run( F f );
+
+        /// return number of records read so far
+        std::size_t count() const;
+
+        /// return number of worker threads
+        unsigned int threads() const { return threads_; }
+
+    private:
+        struct batch
+        {
+            std::size_t sequence;
+            std::vector< std::string > lines; // ascii records
+            std::vector< char > records; // binary records
+            std::vector< std::size_t > offsets; // binary record offsets
+            std::string output;
+            std::size_t size() const { return records.empty() ? lines.size() : offsets.size(); }
+        };
+        typedef boost::shared_ptr< batch > batch_ptr;
+
+        // state shared with the reading thread, which may outlive the stream on failure
+        struct state
+        {
+            boost::mutex mutex;
+            boost::condition_variable condition;
+            std::deque< batch_ptr > todo;
+            std::map< std::size_t, batch_ptr > done;
+            std::size_t read;
+            std::size_t written;
+            std::size_t count;
+            bool eof;
+            bool stop;
+            std::string error;
+            state() : read( 0 ), written( 0 ), count( 0 ), eof( false ), stop( false ) {}
+            void fail( const std::string& what );
+        };
+
+        std::istream& is_;
+        const csv::options input_options_;
+        std::ostream& os_;
+        const csv::options output_options_;
+        const what_enum what_;
+        const unsigned int threads_;
+        const std::size_t batch_size_;
+        const Input input_sample_;
+        const Output output_sample_;
+        boost::shared_ptr< state > state_;
+
+        static void read_( boost::shared_ptr< state > s, std::istream* is, csv::options options, std::size_t batch_size, std::size_t capacity );
+        static bool read_batch_( std::istream& is, const csv::options& options, const csv::format& format, std::size_t batch_size, batch& b );
+        template < typename F > void work_( F f );
+};
+
+template < typename Input, typename Output >
+inline parallel_stream< Input, Output >::parallel_stream( std::istream& is
+                                                        , const csv::options& input_options
+                                                        , std::ostream& os
+                                                        , const csv::options& output_options
+                                                        , what_enum what
+                                                        , unsigned int threads
+                                                        , std::size_t batch_size
+                                                        , const Input& input_sample
+                                                        , const Output& output_sample )
+    : is_( is )
+    , input_options_( input_options )
+    , os_( os )
+    , output_options_( output_options )
+    , what_( what )
+    , threads_( threads > 0 ? threads : boost::thread::hardware_concurrency() > 0 ? boost::thread::hardware_concurrency() : 1 )
+    , batch_size_( batch_size )
+    , input_sample_( input_sample )
+    , output_sample_( output_sample )
+{
+    if( batch_size_ == 0 ) { COMMA_THROW( comma::exception, "expected positive batch size" ); }
+    if( what_ != result && input_options_.binary() != output_options_.binary() ) { COMMA_THROW( comma::exception, "when outputting input records, expected input and output both binary or both ascii" ); }
+    // make sure options are valid before starting threads
+    if( input_options_.binary() ) { csv::binary< Input > b( input_options_, input_sample_ ); } else { csv::ascii< Input > a( input_options_, input_sample_ ); }
+    if( output_options_.binary() ) { csv::binary< Output > b( output_options_, output_sample_ ); } else { csv::ascii< Output > a( output_options_, output_sample_ ); }
+}
+
+template < typename Input, typename Output >
+inline std::size_t parallel_stream< Input, Output >::count() const
+{
+    if( !state_ ) { return 0; }
+    boost::mutex::scoped_lock lock( state_->mutex );
+    return state_->count;
+}
+
+template < typename Input, typename Output >
+inline void parallel_stream< Input, Output >::state::fail( const std::string& what )
+{
+    boost::mutex::scoped_lock lock( mutex );
+    if( error.empty() ) { error = what; }
+    stop = true;
+    condition.notify_all();
+}
+
+template < typename Input, typename Output >
+template < typename F >
+inline void parallel_stream< Input, Output >::run( F f )
+{
+    state_.reset( new state );
+    boost::shared_ptr< state > s = state_;
+    boost::thread reader( boost::bind( &parallel_stream::read_, s, &is_, input_options_, batch_size_, std::size_t( threads_ ) * 4 ) );
+    boost::thread_group workers;
+    for( unsigned int i = 0; i < threads_; ++i ) { workers.create_thread( boost::bind( &parallel_stream::template work_< F >, this, f ) ); }
+    try
+    {
+        while( true )
+        {
+            batch_ptr b;
+            {
+                boost::mutex::scoped_lock lock( s->mutex );
+                while( !s->stop && s->done.find( s->written ) == s->done.end() && !( s->eof && s->written == s->read ) ) { s->condition.wait( lock ); }
+                if( s->stop || s->done.find( s->written ) == s->done.end() ) { break; }
+                b = s->done[ s->written ];
+                s->done.erase( s->written );
+            }
+            os_.write( &b->output[0], b->output.size() );
+            os_.flush();
+            if( !os_.good() ) { COMMA_THROW( comma::exception, "failed to write output" ); }
+            boost::mutex::scoped_lock lock( s->mutex );
+            ++s->written;
+            s->condition.notify_all();
+        }
+    }
+    catch( std::exception& ex ) { s->fail( ex.what() ); }
+    catch( ... ) { s->fail( "unknown exception" ); }
+    workers.join_all();
+    bool failed;
+    {
+        boost::mutex::scoped_lock lock( s->mutex );
+        failed = s->stop;
+    }
+    if( failed ) { reader.detach(); COMMA_THROW( comma::exception, s->error ); }
+    reader.join();
+}
+
+template < typename Input, typename Output >
+inline void parallel_stream< Input, Output >::read_( boost::shared_ptr< state > s, std::istream* is, csv::options options, std::size_t batch_size, std::size_t capacity )
+{
+    try
+    {
+        csv::format format = options.binary() ? options.format() : csv::format();
+        while( true )
+        {
+            batch_ptr b( new batch );
+            bool more = read_batch_( *is, options, format, batch_size, *b );
+            boost::mutex::scoped_lock lock( s->mutex );
+            while( !s->stop && s->read - s->written >= capacity ) { s->condition.wait( lock ); }
+            if( s->stop ) { return; }
+            if( b->size() > 0 )
+            {
+                b->sequence = s->read++;
+                s->count += b->size();
+                s->todo.push_back( b );
+            }
+            if( !more ) { s->eof = true; }
+            s->condition.notify_all();
+            if( !more ) { return; }
+        }
+    }
+    catch( std::exception& ex ) { s->fail( ex.what() ); }
+    catch( ... ) { s->fail( "unknown exception" ); }
+}
+
+template < typename Input, typename Output >
+inline bool parallel_stream< Input, Output >::read_batch_( std::istream& is, const csv::options& options, const csv::format& format, std::size_t batch_size, batch& b )
+{
+    if( !options.binary() )
+    {
+        b.lines.reserve( batch_size );
+        while( b.lines.size() < batch_size )
+        {
+            if( !is.good() || is.eof() ) { return false; }
+            std::string line;
+            std::getline( is, line );
+            if( !line.empty() && *line.rbegin() == '\r' ) { line.erase( line.length() - 1 ); } // windows... sigh...
+            if( line.empty() ) { continue; }
+            b.lines.push_back( line );
+        }
+        return true;
+    }
+    if( !format.is_variable_size() ) // read the whole batch at once
+    {
+        b.records.resize( format.size() * batch_size );
+        is.read( &b.records[0], b.records.size() );
+        std::size_t size = is.gcount();
+        if( size % format.size() != 0 ) { COMMA_THROW( comma::exception, "expected at least " << format.size() << " bytes; got " << size % format.size() ); }
+        b.records.resize( size );
+        for( std::size_t offset = 0; offset < size; offset += format.size() ) { b.offsets.push_back( offset ); }
+        return size == format.size() * batch_size && is.good();
+    }
+    while( b.offsets.size() < batch_size )
+    {
+        std::size_t begin = b.records.size();
+        std::size_t available = 0;
+        std::size_t size = format.size();
+        while( available < size ) // read the record piecewise, until its size is known
+        {
+            b.records.resize( begin + size );
+            is.read( &b.records[ begin + available ], size - available );
+            available += is.gcount();
+            if( available < size )
+            {
+                b.records.resize( begin );
+                if( available > 0 ) { COMMA_THROW( comma::exception, "expected at least " << size << " bytes; got " << available ); }
+                return false;
+            }
+            size = format.size( &b.records[ begin ], available );
+        }
+        b.offsets.push_back( begin );
+    }
+    return true;
+}
+
+template < typename Input, typename Output >
+template < typename F >
+inline void parallel_stream< Input, Output >::work_( F f )
+{
+    try
+    {
+        boost::scoped_ptr< csv::ascii< Input > > ascii_input;
+        boost::scoped_ptr< csv::binary< Input > > binary_input;
+        boost::scoped_ptr< csv::ascii< Output > > ascii_output;
+        boost::scoped_ptr< csv::binary< Output > > binary_output;
+        if( input_options_.binary() ) { binary_input.reset( new csv::binary< Input >( input_options_, input_sample_ ) ); }
+        else { ascii_input.reset( new csv::ascii< Input >( input_options_, input_sample_ ) ); }
+        if( output_options_.binary() ) { binary_output.reset( new csv::binary< Output >( output_options_, output_sample_ ) ); }
+        else { ascii_output.reset( new csv::ascii< Output >( output_options_, output_sample_ ) ); }
+        Input in( input_sample_ );
+        Output out( output_sample_ );
+        std::vector< std::string > values;
+        std::vector< char > buffer;
+        while( true )
+        {
+            batch_ptr b;
+            {
+                boost::mutex::scoped_lock lock( state_->mutex );
+                while( !state_->stop && state_->todo.empty() && !state_->eof ) { state_->condition.wait( lock ); }
+                if( state_->stop || state_->todo.empty() ) { return; }
+                b = state_->todo.front();
+                state_->todo.pop_front();
+            }
+            for( std::size_t i = 0; i < b->size(); ++i )
+            {
+                in = input_sample_;
+                const char* record = NULL;
+                std::size_t record_size = 0;
+                if( binary_input )
+                {
+                    record = &b->records[ b->offsets[i] ];
+                    record_size = ( i + 1 < b->offsets.size() ? b->offsets[ i + 1 ] : b->records.size() ) - b->offsets[i];
+                    binary_input->get( in, record );
+                }
+                else
+                {
+                    values = split( b->lines[i], ascii_input->delimiter() );
+                    ascii_input->get( in, values );
+                }
+                out = output_sample_;
+                if( !f( in, out ) ) { continue; }
+                if( what_ != result )
+                {
+                    if( binary_input ) { b->output.append( record, record_size ); }
+                    else { b->output += b->lines[i]; }
+                }
+                if( what_ != input )
+                {
+                    if( binary_output )
+                    {
+                        std::size_t size = binary_output->put( out, buffer );
+                        b->output.append( &buffer[0], size );
+                    }
+                    else
+                    {
+                        values.clear();
+                        ascii_output->put( out, values );
+                        if( what_ == input_and_result ) { b->output += ascii_output->delimiter(); }
+                        b->output += join( values, ascii_output->delimiter() );
+                    }
+                }
+                if( !binary_output ) { b->output += '\n'; }
+            }
+            std::vector< std::string >().swap( b->lines );
+            std::vector< char >().swap( b->records );
+            boost::mutex::scoped_lock lock( state_->mutex );
+            state_->done[ b->sequence ] = b;
+            state_->condition.notify_all();
+        }
+    }
+    catch( std::exception& ex ) { state_->fail( ex.what() ); }
+    catch( ... ) { state_->fail( "unknown exception" ); }
+}
+
+} } // namespace comma { namespace csv {
+
+#endif // COMMA_CSV_PARALLEL_STREAM_H_
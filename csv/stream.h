@@ -67,6 +67,18 @@ class ascii_input_stream : public boost::noncopyable
 
         /// return true, if read will not block
         bool ready() const { return false; }
+
+        /// set what to do with records that fail to parse
+        void on_error( options::on_error_enum e ) { on_error_ = e; }
+
+        /// set stream to write records that failed to parse to (skipped or defaulted); NULL: none
+        void rejects( std::ostream* os ) { rejects_ = os; }
+
+        /// return number of records skipped, since they failed to parse
+        std::size_t skipped() const { return skipped_; }
+
+        /// return number of records, in which fields that failed to parse were substituted with defaults
+        std::size_t defaulted() const { return defaulted_; }
     
     private:
         std::istream& is_;
@@ -75,6 +87,10 @@ class ascii_input_stream : public boost::noncopyable
         S result_;
         std::vector< std::string > line_;
         std::vector< std::string > fields_;
+        options::on_error_enum on_error_;
+        std::ostream* rejects_;
+        std::size_t skipped_;
+        std::size_t defaulted_;
 };
 
 /// ascii csv output stream 
@@ -140,6 +156,9 @@ class binary_input_stream : public boost::noncopyable
         /// return the last line read
         const char* last() const { return last_; }
     
+        /// return size of the last record read (for fixed size formats, always format().size())
+        std::size_t last_size() const { return last_size_; }
+    
         /// a helper: return the engine
         const csv::binary< S > binary() const { return binary_; }
 
@@ -151,6 +170,18 @@ class binary_input_stream : public boost::noncopyable
 
         /// return true, if read will not block
         bool ready() const;
+
+        /// set what to do with records that fail to parse
+        void on_error( options::on_error_enum e ) { on_error_ = e; }
+
+        /// set stream to write records that failed to parse to (skipped or defaulted); NULL: none
+        void rejects( std::ostream* os ) { rejects_ = os; }
+
+        /// return number of records skipped, since they failed to parse
+        std::size_t skipped() const { return skipped_; }
+
+        /// return number of records, in which fields that failed to parse were substituted with defaults
+        std::size_t defaulted() const { return defaulted_; }
     
     private:
         std::istream& is_;
@@ -163,8 +194,15 @@ class binary_input_stream : public boost::noncopyable
         const char* end_;
         char* cur_;
         char* last_;
+        std::size_t last_size_;
         std::size_t offset_;
         std::vector< std::string > fields_;
+        options::on_error_enum on_error_;
+        std::ostream* rejects_;
+        std::size_t skipped_;
+        std::size_t defaulted_;
+        const S* read_variable_size_();
+        bool get_( const char* buf, std::size_t size );
 };
 
 /// binary csv output stream 
@@ -236,6 +274,9 @@ class input_stream : public boost::noncopyable
         binary_input_stream< S >& binary() { return *binary_; }
         bool is_binary() const { return binary_; }
         bool ready() const { return binary_ ? binary_->ready() : ascii_->ready(); }
+        void rejects( std::ostream* os ) { if( ascii_ ) { ascii_->rejects( os ); } else { binary_->rejects( os ); } }
+        std::size_t skipped() const { return ascii_ ? ascii_->skipped() : binary_->skipped(); }
+        std::size_t defaulted() const { return ascii_ ? ascii_->defaulted() : binary_->defaulted(); }
     
     private:
         boost::scoped_ptr< ascii_input_stream< S > > ascii_;
@@ -290,6 +331,10 @@ inline ascii_input_stream< S >::ascii_input_stream( std::istream& is, const std:
     , default_( sample )
     , result_( sample )
     , fields_( split( column_names, delimiter ) )
+    , on_error_( options::on_error_throw )
+    , rejects_( NULL )
+    , skipped_( 0 )
+    , defaulted_( 0 )
 {
 }
 
@@ -300,8 +345,11 @@ inline ascii_input_stream< S >::ascii_input_stream(std::istream& is, const optio
     , default_( sample )
     , result_( sample )
     , fields_( split( o.fields, o.delimiter ) )
+    , on_error_( o.on_error )
+    , rejects_( NULL )
+    , skipped_( 0 )
+    , defaulted_( 0 )
 {
-
 }
 
 
@@ -316,10 +364,12 @@ inline const S* ascii_input_stream< S >::read()
         if( !s.empty() && *s.rbegin() == '\r' ) { s = s.substr( 0, s.length() - 1 ); } // windows... sigh...
         if( s.empty() ) { continue; }
         result_ = default_;
-        line_ = split
-( s, ascii_.delimiter() );
-        ascii_.get( result_, line_ );
-        return &result_;
+        line_ = split( s, ascii_.delimiter() );
+        if( on_error_ == options::on_error_throw ) { ascii_.get( result_, line_ ); return &result_; }
+        if( ascii_.get_tolerant( result_, line_ ) == 0 ) { return &result_; }
+        if( rejects_ ) { *rejects_ << s << std::endl; }
+        if( on_error_ == options::on_error_default ) { ++defaulted_; return &result_; }
+        ++skipped_;
     }
     return NULL;
 }
@@ -388,9 +438,13 @@ inline binary_input_stream< S >::binary_input_stream( std::istream& is, const st
     , end_( begin_ + size_ )
     , cur_( begin_ )
     , last_( begin_ )
+    , last_size_( 0 )
     , offset_( 0 )
-    , fields_( split
-( column_names, ',' ) )
+    , fields_( split( column_names, ',' ) )
+    , on_error_( options::on_error_throw )
+    , rejects_( NULL )
+    , skipped_( 0 )
+    , defaulted_( 0 )
 {
     #ifdef WIN32
     if( &is == &std::cin ) { _setmode( _fileno( stdin ), _O_BINARY ); }
@@ -409,10 +463,14 @@ inline binary_input_stream< S >::binary_input_stream( std::istream& is, const op
     , end_( begin_ + size_ )
     , cur_( begin_ )
     , last_( begin_ )
+    , last_size_( 0 )
     , offset_( 0 )
     , fields_( split( o.fields, ',' ) )
+    , on_error_( o.on_error )
+    , rejects_( NULL )
+    , skipped_( 0 )
+    , defaulted_( 0 )
 {
-    
     #ifdef WIN32
     if( &is == &std::cin ) { _setmode( _fileno( stdin ), _O_BINARY ); }
     #endif
@@ -427,17 +485,19 @@ inline bool binary_input_stream< S >::ready() const
 template < typename S >
 inline const S* binary_input_stream< S >::read()
 { 
+    if( binary_.format().is_variable_size() ) { return read_variable_size_(); }
     while( true ) // reading a big chunk for better performance
     {
         if( ready() )
         {
-            result_ = default_;
-            binary_.get( result_, cur_ );
+            bool ok = get_( cur_, binary_.format().size() );
             last_ = cur_;
+            last_size_ = binary_.format().size();
             cur_ += binary_.format().size();
             offset_ -= binary_.format().size();
             if( cur_ >= end_ ) { cur_ = begin_; offset_ = 0; }
-            return &result_;
+            if( ok ) { return &result_; }
+            continue;
         }
         bool bad = is_.eof() || !is_.good() || is_.bad() || is_.fail();
         if( offset_ > 0 && bad ) { COMMA_THROW( comma::exception, "expected at least " << binary_.format().size() << " bytes; got " << offset_ ); }
@@ -475,6 +535,43 @@ inline const S* binary_input_stream< S >::read()
     }
 }
 
+template < typename S >
+inline const S* binary_input_stream< S >::read_variable_size_()
+{
+    // read the record piecewise: the lengths of variable size strings tell how many more bytes to read
+    while( true )
+    {
+        std::size_t offset = 0;
+        std::size_t size = binary_.format().size();
+        while( true )
+        {
+            if( buf_.size() < size ) { buf_.resize( size ); begin_ = cur_ = last_ = &buf_[0]; end_ = begin_ + buf_.size(); }
+            is_.read( &buf_[0] + offset, size - offset ); // blocks till full size bytes read
+            std::streamsize count = is_.gcount();
+            if( count <= 0 && offset == 0 ) { return NULL; }
+            if( std::size_t( count ) < size - offset ) { COMMA_THROW( comma::exception, "expected at least " << size << " bytes; got " << ( offset + count ) ); }
+            offset = size;
+            size = binary_.format().size( &buf_[0], offset );
+            if( size == offset ) { break; }
+        }
+        last_ = &buf_[0];
+        last_size_ = size;
+        if( get_( &buf_[0], size ) ) { return &result_; }
+    }
+}
+
+template < typename S >
+inline bool binary_input_stream< S >::get_( const char* buf, std::size_t size )
+{
+    result_ = default_;
+    if( on_error_ == options::on_error_throw ) { binary_.get( result_, buf ); return true; }
+    if( binary_.get_tolerant( result_, buf ) == 0 ) { return true; }
+    if( rejects_ ) { rejects_->write( buf, size ); }
+    if( on_error_ == options::on_error_skip ) { ++skipped_; return false; }
+    ++defaulted_;
+    return true;
+}
+
 template < typename S >
 inline binary_output_stream< S >::binary_output_stream( std::ostream& os, const std::string& format, const std::string& column_names, bool full_path_as_name, const S& sample )
     : m_os( os )
@@ -522,6 +619,7 @@ inline void binary_output_stream< S >::flush()
 template < typename S >
 inline void binary_output_stream< S >::write( const S& s )
 {
+    if( binary_.format().is_variable_size() ) { std::size_t size = binary_.put( s, buf_ ); m_os.write( &buf_[0], size ); return; }
     binary_.put( s, &buf_[0] );
     m_os.write( &buf_[0], binary_.format().size() );
 //     binary_.put( s, cur_ );
@@ -532,6 +630,7 @@ inline void binary_output_stream< S >::write( const S& s )
 template < typename S >
 inline void binary_output_stream< S >::write( const S& s, const char* buf )
 {
+    if( binary_.format().is_variable_size() ) { std::size_t size = binary_.put( s, buf, buf_ ); m_os.write( &buf_[0], size ); return; }
     ::memcpy( &buf_[0], buf, binary_.format().size() );
     write( s );    
 //     ::memcpy( cur_, buf, binary_.format().size() );
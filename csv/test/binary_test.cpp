@@ -18,6 +18,7 @@
 
 #include <gtest/gtest.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <comma/base/time.h>
 #include <comma/csv/binary.h>
 #include <comma/csv/format.h>
 #include <comma/string/string.h>
@@ -69,6 +70,13 @@ struct large_struct
     unsigned int id;
 };
 
+struct timestamped
+{
+    comma::time t;
+    int a;
+    timestamped() : a( 0 ) {}
+};
+
 struct containers
 {
     boost::array< int, 4 > array;
@@ -168,6 +176,21 @@ template <> struct traits< comma::csv::binary_test::large_struct >
     }
 };
 
+template <> struct traits< comma::csv::binary_test::timestamped >
+{
+    template < typename Key, class Visitor > static void visit( const Key&, const comma::csv::binary_test::timestamped& p, Visitor& v )
+    {
+        v.apply( "t", p.t );
+        v.apply( "a", p.a );
+    }
+
+    template < typename Key, class Visitor > static void visit( const Key&, comma::csv::binary_test::timestamped& p, Visitor& v )
+    {
+        v.apply( "t", p.t );
+        v.apply( "a", p.a );
+    }
+};
+
 template <> struct traits< comma::csv::binary_test::containers >
 {
     template < typename Key, class Visitor > static void visit( const Key&, const comma::csv::binary_test::containers& p, Visitor& v )
@@ -435,6 +458,107 @@ TEST( csv, binary_optional_element )
 //    // todo: more testing
 }
 
+TEST( csv, binary_time )
+{
+    comma::csv::binary_test::timestamped t;
+    t.t = comma::time::from_iso_string( "20110304T111111.123456789" );
+    t.a = 5;
+    {
+        comma::csv::binary< comma::csv::binary_test::timestamped > binary;
+        EXPECT_EQ( binary.format().string(), "t,i" );
+        char buf[12];
+        binary.put( t, buf );
+        EXPECT_EQ( binary.format().bin_to_csv( buf, ',' ), "20110304T111111.123456,5" );
+        comma::csv::binary_test::timestamped s;
+        binary.get( s, buf );
+        EXPECT_EQ( s.t, comma::time::from_iso_string( "20110304T111111.123456" ) );
+        EXPECT_EQ( s.a, 5 );
+    }
+    {
+        comma::csv::binary< comma::csv::binary_test::timestamped > binary( "lt,i" );
+        char buf[16];
+        binary.put( t, buf );
+        comma::csv::binary_test::timestamped s;
+        binary.get( s, buf );
+        EXPECT_EQ( s.t, t.t );
+        EXPECT_EQ( s.a, 5 );
+    }
+    {
+        typedef comma::csv::format::traits< comma::time, comma::csv::format::long_time > traits;
+        typedef comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time > ptime_traits;
+        const char* times[] = { "19691231T235959.5", "19691231T235959.999999", "19691231T235959", "19600101T000000.25", "19700101T000000.000001", "20110304T111111.123456" };
+        for( unsigned int i = 0; i < 6; ++i ) // same encoding as boost::posix_time::ptime
+        {
+            comma::csv::format f( "lt" );
+            comma::time u = comma::time::from_iso_string( times[i] );
+            char buf[12];
+            char expected[12];
+            traits::to_bin( u, buf );
+            ptime_traits::to_bin( boost::posix_time::from_iso_string( times[i] ), expected );
+            EXPECT_EQ( std::string( buf, 12 ), std::string( expected, 12 ) );
+            EXPECT_EQ( traits::from_bin( expected ), u );
+            EXPECT_EQ( f.bin_to_csv( buf ), boost::posix_time::to_iso_string( boost::posix_time::from_iso_string( times[i] ) ) );
+        }
+        comma::time u = comma::time::from_iso_string( "19691231T235959.000000001" );
+        char buf[12];
+        traits::to_bin( u, buf );
+        EXPECT_EQ( *reinterpret_cast< const comma::int64* >( buf ), 0 );
+        EXPECT_EQ( *reinterpret_cast< const comma::int32* >( buf + 8 ), -999999999 );
+        EXPECT_EQ( traits::from_bin( buf ), u );
+    }
+}
+
+TEST( csv, binary_byte_order )
+{
+    comma::csv::binary_test::timestamped t;
+    t.t = comma::time::from_iso_string( "20110304T111111.123456789" );
+    t.a = 0x01020304;
+    {
+        comma::csv::binary< comma::csv::binary_test::timestamped > binary( ">lt,>i" );
+        char buf[16];
+        binary.put( t, buf );
+        EXPECT_EQ( buf[12], 1 );
+        EXPECT_EQ( buf[15], 4 );
+        comma::csv::binary_test::timestamped s;
+        binary.get( s, buf );
+        EXPECT_EQ( s.t, t.t );
+        EXPECT_EQ( s.a, t.a );
+        EXPECT_EQ( binary.format().bin_to_csv( buf, ',' ), "20110304T111111.123456,16909060" );
+    }
+    {
+        comma::csv::binary< comma::csv::binary_test::timestamped > binary( "<t,<i" );
+        char buf[12];
+        binary.put( t, buf );
+        EXPECT_EQ( buf[8], 4 );
+        EXPECT_EQ( buf[11], 1 );
+        comma::csv::binary_test::timestamped s;
+        binary.get( s, buf );
+        EXPECT_EQ( s.a, t.a );
+    }
+}
+
+TEST( csv, binary_reduced_precision )
+{
+    comma::csv::binary_test::simple_struct p;
+    p.a = 1;
+    p.b = 12.3456;
+    p.c = 3;
+    p.t = boost::posix_time::from_iso_string( "20110304T111111" );
+    p.nested.x = 4;
+    p.nested.y = 1000;
+    comma::csv::binary< comma::csv::binary_test::simple_struct > binary( "i,uw*0.001,b,t,i,>h" );
+    EXPECT_EQ( binary.format().size(), 4u + 2u + 1u + 8u + 4u + 2u );
+    std::vector< char > buf( binary.format().size() );
+    binary.put( p, &buf[0] );
+    EXPECT_EQ( binary.format().bin_to_csv( &buf[0] ), "1,12.346,3,20110304T111111,4,1000" );
+    comma::csv::binary_test::simple_struct q;
+    binary.get( q, &buf[0] );
+    EXPECT_NEAR( q.b, 12.346, 1e-9 );
+    EXPECT_EQ( q.nested.y, 1000 );
+    p.b = 70;
+    try { binary.put( p, &buf[0] ); EXPECT_TRUE( false ); } catch( ... ) {}
+}
+
 TEST( csv, binary_containers )
 {
     {
@@ -19,6 +19,7 @@
 #include <gtest/gtest.h>
 #include <limits>
 #include "boost/date_time/posix_time/posix_time.hpp"
+#include <comma/base/time.h>
 #include <comma/csv/format.h>
 #include <comma/csv/options.h>
 #include <comma/csv/impl/unstructured.h>
@@ -105,7 +106,10 @@ TEST( csv, format )
         EXPECT_EQ( f.index( 5 ).second, 2u );
     }    
     {
-        try { comma::csv::format f( "%s" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+        comma::csv::format f( "%s" );
+        EXPECT_TRUE( f.is_variable_size() );
+        EXPECT_EQ( f.size(), 4u );
+        EXPECT_EQ( f.count(), 1u );
     }
     {
         comma::csv::format f( "%s[4]%2s[8]%10ui" );
@@ -136,6 +140,175 @@ TEST( csv, format )
     }    
 }
 
+TEST( csv, format_time )
+{
+    {
+        const char* s[] = { "20100621T182601", "20100621T182601.012300", "19691231T235959.999999", "20400229T000000.000001", "not-a-date-time" };
+        for( unsigned int i = 0; i < 5; ++i )
+        {
+            EXPECT_EQ( comma::time::from_iso_string( s[i] ).to_iso_string(), s[i] );
+            EXPECT_EQ( comma::time::from_iso_string( s[i] ).to_ptime(), boost::posix_time::from_iso_string( s[i] ) );
+            EXPECT_EQ( comma::time( boost::posix_time::from_iso_string( s[i] ) ), comma::time::from_iso_string( s[i] ) );
+        }
+    }
+    {
+        comma::time t = comma::time::from_iso_string( "20100621T182601.123456789" );
+        EXPECT_EQ( t.nanoseconds(), 789u );
+        EXPECT_EQ( t.to_iso_string(), "20100621T182601.123456789" );
+        EXPECT_EQ( t - comma::time::from_iso_string( "20100621T182600.123456" ), 1000000 );
+        EXPECT_TRUE( comma::time::from_iso_string( "20100621T182601.123456" ) < t );
+        EXPECT_EQ( t.seconds(), ( boost::posix_time::from_iso_string( "20100621T182601" ) - boost::posix_time::from_iso_string( "19700101T000000" ) ).total_seconds() );
+    }
+    {
+        EXPECT_THROW( comma::time::from_iso_string( "20110231T000000" ), std::exception );
+        EXPECT_THROW( comma::time::from_iso_string( "20110229T000000" ), std::exception );
+        EXPECT_THROW( comma::time::from_iso_string( "21000229T000000" ), std::exception );
+        EXPECT_THROW( comma::time::from_iso_string( "20110431T000000" ), std::exception );
+        EXPECT_EQ( comma::time::from_iso_string( "20000229T000000" ).to_iso_string(), "20000229T000000" );
+        EXPECT_EQ( comma::time::from_iso_string( "20120229T000000" ).to_iso_string(), "20120229T000000" );
+    }
+    {
+        comma::csv::format f( "%t" );
+        EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "not-a-date-time" ) ), "not-a-date-time" );
+        EXPECT_EQ( comma::csv::format::value< comma::time >(), "t" );
+    }
+}
+
+TEST( csv, format_padding )
+{
+    {
+        comma::csv::format f( "ui,x[3],2d,4x,ub" );
+        EXPECT_EQ( f.size(), 4u + 3u + 16u + 4u + 1u );
+        EXPECT_EQ( f.count(), 4u );
+        EXPECT_EQ( f.offset( 1 ).offset, 7u );
+        EXPECT_EQ( f.offset( 2 ).offset, 15u );
+        EXPECT_EQ( f.offset( 3 ).offset, 27u );
+        EXPECT_EQ( f.offset( 3 ).type, comma::csv::format::uint8 );
+        std::string b = f.csv_to_bin( "1,2.5,3.5,4" );
+        EXPECT_EQ( b.size(), f.size() );
+        EXPECT_EQ( b[4], 0 );
+        EXPECT_EQ( b[23], 0 );
+        EXPECT_EQ( f.bin_to_csv( b ), "1,2.5,3.5,4" );
+    }
+    {
+        comma::csv::format f( "x,d" );
+        EXPECT_EQ( f.size(), 9u );
+        EXPECT_EQ( f.count(), 1u );
+        EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "1.5" ) ), "1.5" );
+        EXPECT_EQ( comma::csv::format::to_format( comma::csv::format::padding, 8 ), "x[8]" );
+    }
+}
+
+TEST( csv, format_variable_string )
+{
+    {
+        comma::csv::format f( "ui,s,2s,d" );
+        EXPECT_TRUE( f.is_variable_size() );
+        EXPECT_EQ( f.count(), 5u );
+        EXPECT_EQ( f.size(), 4u + 4u + 8u + 8u );
+        std::string b = f.csv_to_bin( "1,hello,,world!,2.5" );
+        EXPECT_EQ( b.size(), f.size() + 5u + 6u );
+        EXPECT_EQ( f.size( b.c_str(), 4 ), f.size() );
+        EXPECT_EQ( f.size( b.c_str(), 8 ), f.size() + 5u );
+        EXPECT_EQ( f.size( b.c_str(), b.size() ), b.size() );
+        std::vector< comma::csv::format::element > fields;
+        EXPECT_EQ( f.offsets( b.c_str(), fields ), b.size() );
+        EXPECT_EQ( fields.size(), 5u );
+        EXPECT_EQ( fields[1].offset, 8u );
+        EXPECT_EQ( fields[1].size, 5u );
+        EXPECT_EQ( fields[2].size, 0u );
+        EXPECT_EQ( fields[3].offset, 21u );
+        EXPECT_EQ( fields[4].offset, 27u );
+        EXPECT_EQ( f.bin_to_csv( b ), "1,hello,,world!,2.5" );
+    }
+    {
+        comma::csv::format f( "d,s[4],x" );
+        EXPECT_FALSE( f.is_variable_size() );
+        EXPECT_EQ( f.size( "", 0 ), f.size() );
+        EXPECT_EQ( comma::csv::format::to_format( comma::csv::format::variable_string ), "s" );
+        EXPECT_EQ( comma::csv::format::value< std::string >(), "s" );
+    }
+}
+
+TEST( csv, format_byte_order )
+{
+    {
+        comma::csv::format f( ">ui,<uw,2>d,>t,d" );
+        EXPECT_EQ( f.size(), 4u + 2u + 16u + 8u + 8u );
+        EXPECT_EQ( f.offset( 0 ).byte_order, comma::csv::format::big_endian );
+        EXPECT_EQ( f.offset( 1 ).byte_order, comma::csv::format::little_endian );
+        EXPECT_EQ( f.offset( 3 ).byte_order, comma::csv::format::big_endian );
+        EXPECT_EQ( f.offset( 5 ).byte_order, comma::csv::format::native );
+        EXPECT_FALSE( f.offset( 5 ).swapped() );
+        EXPECT_NE( f.offset( 0 ).swapped(), f.offset( 1 ).swapped() );
+        std::string b = f.csv_to_bin( "258,258,1.5,-2.5,20120101T000000,3.5" );
+        EXPECT_EQ( b[0], 0 );
+        EXPECT_EQ( b[2], 1 );
+        EXPECT_EQ( b[3], 2 );
+        EXPECT_EQ( b[4], 2 );
+        EXPECT_EQ( b[5], 1 );
+        EXPECT_EQ( f.bin_to_csv( b ), "258,258,1.5,-2.5,20120101T000000,3.5" );
+    }
+    {
+        comma::csv::format f( ">ui,s" );
+        EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "16909060,hello" ) ), "16909060,hello" );
+        EXPECT_EQ( f.csv_to_bin( "16909060,hello" ).substr( 0, 4 ), std::string( "\x01\x02\x03\x04" ) );
+    }
+    {
+        try { comma::csv::format f( ">s[4]" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+        try { comma::csv::format f( ">x" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+        try { comma::csv::format f( "><d" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+    }
+}
+
+TEST( csv, format_reduced_precision )
+{
+    {
+        comma::csv::format f( "h,2h" );
+        EXPECT_EQ( f.size(), 6u );
+        EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "1.5,-0.0009765625,65504" ) ), "1.5,-0.000976562,65504" );
+        EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "0.1,100000,5.960464477539063e-08" ) ), "0.0999756,inf,5.96046e-08" );
+        EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "2049,2051,0" ) ), "2048,2052,0" ); // rounding to nearest even
+    }
+    {
+        comma::csv::format f( "uw*0.001,w*0.01+-20,2ub*0.5,ui" );
+        EXPECT_EQ( f.size(), 2u + 2u + 2u + 4u );
+        EXPECT_TRUE( f.offset( 0 ).scaled() );
+        EXPECT_EQ( f.offset( 1 ).value_offset, -20 );
+        EXPECT_TRUE( f.offset( 3 ).scaled() );
+        EXPECT_FALSE( f.offset( 4 ).scaled() );
+        std::string b = f.csv_to_bin( "12.3456,-20.5,1.2,2,7" );
+        EXPECT_EQ( *reinterpret_cast< const comma::uint16* >( &b[0] ), 12346 );
+        EXPECT_EQ( *reinterpret_cast< const comma::int16* >( &b[2] ), -50 );
+        EXPECT_EQ( f.bin_to_csv( b ), "12.346,-20.5,1,2,7" );
+        try { f.csv_to_bin( "70,0,0,0,0" ); EXPECT_TRUE( false ); } catch( ... ) {}
+    }
+    {
+        comma::csv::format f( ">w*0.5+1" );
+        std::string b = f.csv_to_bin( "3" );
+        EXPECT_EQ( b[0], 0 );
+        EXPECT_EQ( b[1], 4 );
+        EXPECT_EQ( f.bin_to_csv( b ), "3" );
+    }
+    {
+        comma::csv::format f( "l*2,ul*2" );
+        std::string b = f.csv_to_bin( "18446744073709549568,36893488147419099136" ); // halves are largest doubles below 2^63 and 2^64
+        EXPECT_EQ( *reinterpret_cast< const comma::int64* >( &b[0] ), 9223372036854774784LL );
+        EXPECT_EQ( *reinterpret_cast< const comma::uint64* >( &b[8] ), 18446744073709549568ULL );
+        try { f.csv_to_bin( "18446744073709551615,0" ); EXPECT_TRUE( false ); } catch( ... ) {}
+        try { f.csv_to_bin( "0,36893488147419103231" ); EXPECT_TRUE( false ); } catch( ... ) {}
+        try { f.csv_to_bin( "-18446744073709555712,0" ); EXPECT_TRUE( false ); } catch( ... ) {}
+        b = f.csv_to_bin( "-18446744073709551616,0" );
+        EXPECT_EQ( *reinterpret_cast< const comma::int64* >( &b[0] ), std::numeric_limits< comma::int64 >::min() );
+    }
+    {
+        try { comma::csv::format f( "d*0.1" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+        try { comma::csv::format f( "w*" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+        try { comma::csv::format f( "w*0" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+        try { comma::csv::format f( "w*0.1+" ); EXPECT_TRUE( false ); } catch ( ... ) {}
+    }
+}
+
 TEST( csv, format_add )
 {
     {
@@ -249,11 +422,11 @@ TEST( csv, format_with_fields )
 TEST( csv, unstructured )
 {
     EXPECT_EQ( "d,d,d,d", comma::csv::impl::unstructured::guess_format( "1,2,3,4" ).string() );
-    EXPECT_EQ( "d,d,t,s[1024]", comma::csv::impl::unstructured::guess_format( "1,2.1,20121212T000000,blah" ).string() );
+    EXPECT_EQ( "d,d,t,s", comma::csv::impl::unstructured::guess_format( "1,2.1,20121212T000000,blah" ).string() );
     comma::csv::options csv;
     csv.fields = "a,,,b,,,c";
     csv.delimiter = ',';
-    EXPECT_EQ( "d,s[1024],s[1024],s[1024],s[1024],s[1024],t", comma::csv::impl::unstructured::guess_format( "1,,,blah,,,20121212T000000" ).string() );
+    EXPECT_EQ( "d,s,s,s,s,s,t", comma::csv::impl::unstructured::guess_format( "1,,,blah,,,20121212T000000" ).string() );
     EXPECT_EQ( 1, comma::csv::impl::unstructured::make( csv, "1,,,blah,,,20121212T000000" ).first.doubles.size() );
     EXPECT_EQ( 1, comma::csv::impl::unstructured::make( csv, "1,,,blah,,,20121212T000000" ).first.strings.size() );
     EXPECT_EQ( 1, comma::csv::impl::unstructured::make( csv, "1,,,blah,,,20121212T000000" ).first.timestamps.size() );
@@ -22,6 +22,7 @@
 #include <boost/array.hpp>
 //#include <google/profiler.h>
 #include <comma/base/types.h>
+#include <comma/csv/parallel_stream.h>
 #include <comma/csv/stream.h>
 
 namespace comma { namespace csv { namespace test {
@@ -34,6 +35,14 @@ struct test_struct
     test_struct( comma::uint32 x, comma::uint32 y ) : x( x ), y( y ) {}
 };
 
+struct named_struct
+{
+    std::string name;
+    comma::uint32 x;
+    named_struct() : x( 0 ) {}
+    named_struct( const std::string& name, comma::uint32 x ) : name( name ), x( x ) {}
+};
+
 } } } // namespace comma { namespace csv { namespace test {
 
 namespace comma { namespace visiting {
@@ -55,6 +64,23 @@ template <> struct traits< comma::csv::test::test_struct >
     }    
 };
 
+template <> struct traits< comma::csv::test::named_struct >
+{
+    template < typename Key, class Visitor >
+    static void visit( const Key&, const comma::csv::test::named_struct& p, Visitor& v )
+    {
+        v.apply( "name", p.name );
+        v.apply( "x", p.x );
+    }
+    
+    template < typename Key, class Visitor >
+    static void visit( const Key&, comma::csv::test::named_struct& p, Visitor& v )
+    {
+        v.apply( "name", p.name );
+        v.apply( "x", p.x );
+    }
+};
+
 } } // namespace comma { namespace visiting {
 
 namespace comma { namespace csv { namespace test {
@@ -88,5 +114,182 @@ TEST( csv, stream )
 //	std::cerr << "ProfileStream(): stop" << std::endl;
 }
 
+TEST( csv, stream_variable_size )
+{
+    std::ostringstream oss;
+    {
+        comma::csv::binary_output_stream< named_struct > ostream( oss );
+        EXPECT_EQ( ostream.binary().format().string(), "s,ui" );
+        ostream.write( named_struct( "hello", 1 ) );
+        ostream.write( named_struct( "", 2 ) );
+        ostream.write( named_struct( "world!", 3 ) );
+    }
+    EXPECT_EQ( oss.str().size(), 3 * 8u + 5u + 6u );
+    {
+        std::istringstream iss( oss.str() );
+        comma::csv::binary_input_stream< named_struct > istream( iss, "s,ui" );
+        const named_struct* p = istream.read();
+        ASSERT_TRUE( p != NULL );
+        EXPECT_EQ( p->name, "hello" );
+        EXPECT_EQ( p->x, 1u );
+        EXPECT_EQ( istream.last_size(), 13u );
+        p = istream.read();
+        ASSERT_TRUE( p != NULL );
+        EXPECT_EQ( p->name, "" );
+        EXPECT_EQ( p->x, 2u );
+        p = istream.read();
+        ASSERT_TRUE( p != NULL );
+        EXPECT_EQ( p->name, "world!" );
+        EXPECT_EQ( p->x, 3u );
+        EXPECT_TRUE( istream.read() == NULL );
+    }
+    {
+        std::istringstream iss( oss.str() );
+        comma::csv::binary_input_stream< named_struct > istream( iss, "s,ui" );
+        std::ostringstream os;
+        comma::csv::binary_output_stream< named_struct > ostream( os, "s,ui", "name" );
+        istream.read();
+        ostream.write( named_struct( "hi", 5 ), istream.last() );
+        ostream.flush();
+        comma::csv::format f( "s,ui" );
+        EXPECT_EQ( f.bin_to_csv( os.str() ), "hi,1" );
+    }
+    {
+        std::string corrupted = oss.str();
+        *reinterpret_cast< comma::uint32* >( &corrupted[0] ) = 0xfffffff0;
+        std::istringstream iss( corrupted );
+        comma::csv::binary_input_stream< named_struct > istream( iss, "s,ui" );
+        EXPECT_THROW( istream.read(), comma::exception );
+    }
+}
+
+
+TEST( csv, stream_on_error )
+{
+    const std::string input = "1,2\nx,3\n4\n5,6\n";
+    comma::csv::options csv;
+    csv.fields = "x,y";
+    {
+        std::istringstream iss( input );
+        comma::csv::ascii_input_stream< test_struct > istream( iss, csv );
+        EXPECT_TRUE( istream.read() != NULL );
+        EXPECT_THROW( istream.read(), std::exception );
+    }
+    {
+        std::istringstream iss( input );
+        std::ostringstream rejects;
+        csv.on_error = comma::csv::options::on_error_skip;
+        comma::csv::ascii_input_stream< test_struct > istream( iss, csv );
+        istream.rejects( &rejects );
+        const test_struct* t = istream.read();
+        EXPECT_EQ( 1, t->x );
+        EXPECT_EQ( 2, t->y );
+        t = istream.read();
+        EXPECT_EQ( 5, t->x );
+        EXPECT_EQ( 6, t->y );
+        EXPECT_TRUE( istream.read() == NULL );
+        EXPECT_EQ( 2, istream.skipped() );
+        EXPECT_EQ( 0, istream.defaulted() );
+        EXPECT_EQ( "x,3\n4\n", rejects.str() );
+    }
+    {
+        std::istringstream iss( input );
+        csv.on_error = comma::csv::options::on_error_default;
+        comma::csv::ascii_input_stream< test_struct > istream( iss, csv, test_struct( 7, 8 ) );
+        const test_struct* t = istream.read();
+        EXPECT_EQ( 1, t->x );
+        EXPECT_EQ( 2, t->y );
+        t = istream.read();
+        EXPECT_EQ( 7, t->x );
+        EXPECT_EQ( 3, t->y );
+        t = istream.read();
+        EXPECT_EQ( 4, t->x );
+        EXPECT_EQ( 8, t->y );
+        t = istream.read();
+        EXPECT_EQ( 5, t->x );
+        EXPECT_EQ( 6, t->y );
+        EXPECT_TRUE( istream.read() == NULL );
+        EXPECT_EQ( 0, istream.skipped() );
+        EXPECT_EQ( 2, istream.defaulted() );
+    }
+    std::string binary; // x is a string, which cannot be converted to test_struct::x: a type mismatch, not bad data
+    for( comma::uint32 i = 0; i < 2; ++i ) { binary += "abcd"; binary.append( reinterpret_cast< const char* >( &i ), 4 ); }
+    comma::csv::options options;
+    options.fields = "x,y";
+    options.format( "s[4],ui" );
+    comma::csv::options::on_error_enum policies[] = { comma::csv::options::on_error_throw, comma::csv::options::on_error_skip, comma::csv::options::on_error_default };
+    for( unsigned int i = 0; i < 3; ++i )
+    {
+        std::istringstream iss( binary );
+        options.on_error = policies[i];
+        comma::csv::binary_input_stream< test_struct > istream( iss, options );
+        EXPECT_THROW( istream.read(), comma::exception );
+    }
+}
+
+struct sum_even
+{
+    bool operator()( const test_struct& in, test_struct& out ) const
+    {
+        if( in.x % 2 ) { return false; }
+        out.x = in.x + in.y;
+        out.y = in.x * in.y;
+        return true;
+    }
+};
+
+TEST( csv, parallel_stream )
+{
+    const unsigned int size = 10000;
+    std::ostringstream ascii;
+    std::string binary;
+    std::ostringstream expected_ascii;
+    std::ostringstream expected_filtered;
+    std::string expected_binary;
+    for( comma::uint32 i = 0; i < size; ++i )
+    {
+        ascii << i << ',' << ( i * 3 ) << std::endl;
+        test_struct t( i, i * 3 );
+        binary.append( reinterpret_cast< const char* >( &t ), sizeof( t ) );
+        if( i % 2 ) { continue; }
+        test_struct r( i * 4, i * i * 3 );
+        expected_ascii << r.x << ',' << r.y << std::endl;
+        expected_filtered << i << ',' << ( i * 3 ) << ',' << r.x << ',' << r.y << std::endl;
+        expected_binary.append( reinterpret_cast< const char* >( &r ), sizeof( r ) );
+    }
+    comma::csv::options csv;
+    {
+        std::istringstream iss( ascii.str() );
+        std::ostringstream oss;
+        comma::csv::parallel_stream< test_struct, test_struct > stream( iss, csv, oss, csv, comma::csv::parallel_stream< test_struct, test_struct >::result, 4, 100 );
+        stream.run( sum_even() );
+        EXPECT_EQ( size, stream.count() );
+        EXPECT_EQ( expected_ascii.str(), oss.str() );
+    }
+    {
+        std::istringstream iss( ascii.str() );
+        std::ostringstream oss;
+        comma::csv::parallel_stream< test_struct, test_struct > stream( iss, csv, oss, csv, comma::csv::parallel_stream< test_struct, test_struct >::input_and_result, 3, 7 );
+        stream.run( sum_even() );
+        EXPECT_EQ( expected_filtered.str(), oss.str() );
+    }
+    {
+        comma::csv::options binary_csv;
+        binary_csv.format( "2ui" );
+        std::istringstream iss( binary );
+        std::ostringstream oss;
+        comma::csv::parallel_stream< test_struct, test_struct > stream( iss, binary_csv, oss, binary_csv, comma::csv::parallel_stream< test_struct, test_struct >::result, 4, 33 );
+        stream.run( sum_even() );
+        EXPECT_EQ( size, stream.count() );
+        EXPECT_TRUE( expected_binary == oss.str() );
+    }
+    {
+        std::istringstream iss( "1,2\n3,4\nblah,5\n" );
+        std::ostringstream oss;
+        comma::csv::parallel_stream< test_struct, test_struct > stream( iss, csv, oss, csv, comma::csv::parallel_stream< test_struct, test_struct >::result, 2, 1 );
+        EXPECT_THROW( stream.run( sum_even() ), std::exception );
+    }
+}
+
 } } } // namespace comma { namespace csv { namespace test {
 
@@ -0,0 +1,110 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+
+#ifndef COMMA_MATH_HYPERLOGLOG_H_
+#define COMMA_MATH_HYPERLOGLOG_H_
+
+#include <cmath>
+#include <vector>
+#include <comma/base/exception.h>
+#include <comma/base/types.h>
+
+namespace comma { namespace math {
+
+/// approximate number of distinct values in bounded memory
+/// (hyperloglog: flajolet, fusy, gandouet, meunier, 2007)
+///
+/// values are pushed as 64-bit hashes; the first p bits of a hash select one of 2^p registers,
+/// which keeps the maximum position of the first set bit in the remaining bits
+///
+/// memory is 2^p bytes; the relative standard error is roughly 1.04 / sqrt( 2^p ),
+/// e.g. for p = 12, 4096 bytes and 1.6%
+class hyperloglog
+{
+    public:
+        /// constructor
+        /// @param precision number of bits selecting a register, 4 to 18
+        hyperloglog( unsigned int precision = 12 );
+
+        /// add value by its hash, e.g. hyperloglog::hash( buf, size )
+        void push( comma::uint64 hash );
+
+        /// return estimated number of distinct values
+        comma::uint64 estimate() const;
+
+        /// return precision
+        unsigned int precision() const { return precision_; }
+
+        /// return well-mixed 64-bit hash of given bytes (fnv-1a followed by murmur3 finalizer)
+        static comma::uint64 hash( const char* buf, std::size_t size );
+
+    private:
+        unsigned int precision_;
+        std::vector< unsigned char > registers_;
+};
+
+inline hyperloglog::hyperloglog( unsigned int precision )
+    : precision_( precision )
+{
+    if( precision_ < 4 || precision_ > 18 ) { COMMA_THROW( comma::exception, "expected precision from 4 to 18, got " << precision ); }
+    registers_.resize( std::size_t( 1 ) << precision_, 0 );
+}
+
+inline void hyperloglog::push( comma::uint64 hash )
+{
+    std::size_t index = hash >> ( 64 - precision_ );
+    comma::uint64 w = hash << precision_;
+    unsigned char rank = 1;
+    for( unsigned int max = 64 - precision_ + 1; rank < max && !( w & 0x8000000000000000ULL ); w <<= 1 ) { ++rank; }
+    if( registers_[index] < rank ) { registers_[index] = rank; }
+}
+
+inline comma::uint64 hyperloglog::estimate() const
+{
+    const double m = double( registers_.size() );
+    double sum = 0;
+    std::size_t zeros = 0;
+    for( std::size_t i = 0; i < registers_.size(); ++i )
+    {
+        sum += std::ldexp( 1.0, -int( registers_[i] ) );
+        if( registers_[i] == 0 ) { ++zeros; }
+    }
+    double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / ( 1 + 1.079 / m );
+    double e = alpha * m * m / sum;
+    if( e <= 2.5 * m && zeros > 0 ) { e = m * std::log( m / zeros ); } // small range correction: linear counting
+    return comma::uint64( e + 0.5 );
+}
+
+inline comma::uint64 hyperloglog::hash( const char* buf, std::size_t size )
+{
+    comma::uint64 h = 14695981039346656037ULL;
+    for( std::size_t i = 0; i < size; ++i ) { h ^= static_cast< unsigned char >( buf[i] ); h *= 1099511628211ULL; }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+} } // namespace comma { namespace math {
+
+#endif // COMMA_MATH_HYPERLOGLOG_H_
@@ -0,0 +1,192 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_MATH_QUANTILE_SKETCH_H_
+#define COMMA_MATH_QUANTILE_SKETCH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+#include <comma/base/exception.h>
+#include <comma/base/types.h>
+
+namespace comma { namespace math {
+
+/// streaming quantiles in bounded memory (kll sketch: karnin, lang, liberty, 2016)
+///
+/// values are kept in levels of compactors; a value at level h stands for 2^h input values;
+/// when a level overflows, it gets sorted and every other value is promoted to the next level
+///
+/// memory is O( k ) values (roughly 3 * k); the rank error is roughly 1.7 / k,
+/// e.g. for k = 200, the value returned for p = 0.5 is between the 49th and 51st percentile
+/// of the input; minimum and maximum are always exact
+///
+/// if k is 0, all values are stored and quantiles are exact
+template < typename T >
+class quantile_sketch
+{
+    public:
+        /// constructor
+        /// @param k accuracy parameter; 0: exact, i.e. store all values
+        quantile_sketch( std::size_t k = 200 );
+
+        /// add value
+        void push( const T& t );
+
+        /// return value, such that at least fraction p of input values are less or equal to it
+        /// (the nearest rank definition, i.e. the result is always one of input values)
+        /// @param p fraction, 0 <= p <= 1; 0: minimum, 1: maximum
+        T quantile( double p ) const;
+
+        /// return estimated number of input values less than each of given points
+        /// @param points points in ascending order, e.g. histogram bin edges
+        template < typename S >
+        std::vector< comma::uint64 > ranks( const std::vector< S >& points ) const;
+
+        /// return number of input values
+        comma::uint64 size() const { return size_; }
+
+        /// return true, if no values have been pushed
+        bool empty() const { return size_ == 0; }
+
+        /// return number of values actually stored
+        std::size_t stored() const;
+
+    private:
+        std::size_t k_;
+        comma::uint64 size_;
+        std::vector< std::vector< T > > levels_;
+        boost::optional< T > min_;
+        boost::optional< T > max_;
+        comma::uint32 random_;
+        std::size_t capacity_( std::size_t level ) const;
+        void compact_();
+        bool coin_();
+};
+
+template < typename T >
+inline quantile_sketch< T >::quantile_sketch( std::size_t k )
+    : k_( k )
+    , size_( 0 )
+    , levels_( 1 )
+    , random_( 2463534242u )
+{
+    if( k_ == 1 ) { COMMA_THROW( comma::exception, "expected sketch size 0 (exact) or at least 2, got 1" ); }
+}
+
+template < typename T >
+inline void quantile_sketch< T >::push( const T& t )
+{
+    if( !min_ || t < *min_ ) { min_ = t; }
+    if( !max_ || *max_ < t ) { max_ = t; }
+    ++size_;
+    levels_[0].push_back( t );
+    if( k_ > 0 && levels_[0].size() >= capacity_( 0 ) ) { compact_(); }
+}
+
+template < typename T >
+inline std::size_t quantile_sketch< T >::capacity_( std::size_t level ) const
+{
+    // capacities decrease geometrically by 2/3 from the top level down
+    std::size_t depth = levels_.size() - 1 - level;
+    std::size_t c = static_cast< std::size_t >( std::ceil( k_ * std::pow( 2.0 / 3, double( depth ) ) ) );
+    return c < 2 ? 2 : c;
+}
+
+template < typename T >
+inline bool quantile_sketch< T >::coin_() // xorshift, to avoid bias and global state of std::rand()
+{
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    return random_ & 1;
+}
+
+template < typename T >
+inline void quantile_sketch< T >::compact_()
+{
+    for( std::size_t h = 0; h < levels_.size(); ++h )
+    {
+        if( levels_[h].size() < capacity_( h ) ) { continue; }
+        if( h + 1 == levels_.size() ) { levels_.push_back( std::vector< T >() ); }
+        std::vector< T >& level = levels_[h];
+        std::sort( level.begin(), level.end() );
+        std::size_t begin = level.size() % 2; // if odd, the smallest value stays at this level
+        for( std::size_t i = begin + ( coin_() ? 1 : 0 ); i < level.size(); i += 2 ) { levels_[ h + 1 ].push_back( level[i] ); }
+        level.resize( begin );
+    }
+}
+
+template < typename T >
+inline std::size_t quantile_sketch< T >::stored() const
+{
+    std::size_t n = 0;
+    for( std::size_t h = 0; h < levels_.size(); ++h ) { n += levels_[h].size(); }
+    return n;
+}
+
+template < typename T >
+inline T quantile_sketch< T >::quantile( double p ) const
+{
+    if( size_ == 0 ) { COMMA_THROW( comma::exception, "quantile of empty sketch requested" ); }
+    if( !( p >= 0 && p <= 1 ) ) { COMMA_THROW( comma::exception, "expected fraction between 0 and 1, got " << p ); }
+    if( p == 0 ) { return *min_; }
+    if( p == 1 ) { return *max_; }
+    std::vector< std::pair< T, comma::uint64 > > weighted;
+    weighted.reserve( stored() );
+    for( std::size_t h = 0; h < levels_.size(); ++h )
+    {
+        for( std::size_t i = 0; i < levels_[h].size(); ++i ) { weighted.push_back( std::make_pair( levels_[h][i], comma::uint64( 1 ) << h ) ); }
+    }
+    std::sort( weighted.begin(), weighted.end() );
+    comma::uint64 total = 0;
+    for( std::size_t i = 0; i < weighted.size(); ++i ) { total += weighted[i].second; }
+    double rank = p * total;
+    comma::uint64 sum = 0;
+    for( std::size_t i = 0; i < weighted.size(); ++i )
+    {
+        sum += weighted[i].second;
+        if( double( sum ) >= rank ) { return weighted[i].first; }
+    }
+    return *max_;
+}
+
+template < typename T >
+template < typename S >
+inline std::vector< comma::uint64 > quantile_sketch< T >::ranks( const std::vector< S >& points ) const
+{
+    std::vector< comma::uint64 > r( points.size() + 1, 0 );
+    for( std::size_t h = 0; h < levels_.size(); ++h )
+    {
+        for( std::size_t i = 0; i < levels_[h].size(); ++i ) // value counts towards all points greater than it
+        {
+            r[ std::upper_bound( points.begin(), points.end(), levels_[h][i] ) - points.begin() ] += comma::uint64( 1 ) << h;
+        }
+    }
+    for( std::size_t i = 1; i < r.size(); ++i ) { r[i] += r[ i - 1 ]; }
+    r.pop_back();
+    return r;
+}
+
+} } // namespace comma { namespace math {
+
+#endif // COMMA_MATH_QUANTILE_SKETCH_H_
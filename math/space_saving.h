@@ -0,0 +1,102 @@
+// This file is part of comma, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+/// @author vsevolod vlaskine
+
+
+#ifndef COMMA_MATH_SPACE_SAVING_H_
+#define COMMA_MATH_SPACE_SAVING_H_
+
+#include <algorithm>
+#include <vector>
+#include <comma/base/exception.h>
+#include <comma/base/types.h>
+
+namespace comma { namespace math {
+
+/// most frequent values in bounded memory (space-saving: metwally, agrawal, el abbadi, 2005)
+///
+/// keeps k counters; a value not counted yet replaces the value with the smallest count
+/// and inherits that count as its maximum overestimation (error)
+///
+/// any value occurring more than n / k times in n values is guaranteed to be kept;
+/// push is O( k ), thus meant for small k, e.g. tens of values
+template < typename T >
+class space_saving
+{
+    public:
+        struct entry
+        {
+            T value;
+            comma::uint64 count; /// upper bound of the number of occurrences
+            comma::uint64 error; /// count minus error is the lower bound
+            entry() : count( 0 ), error( 0 ) {}
+            entry( const T& value, comma::uint64 count, comma::uint64 error ) : value( value ), count( count ), error( error ) {}
+        };
+
+        /// constructor
+        /// @param k number of counters
+        space_saving( std::size_t k );
+
+        /// add value
+        void push( const T& t );
+
+        /// return counted values in descending order of count
+        std::vector< entry > top() const;
+
+        /// return number of counters
+        std::size_t capacity() const { return k_; }
+
+    private:
+        std::size_t k_;
+        std::vector< entry > entries_;
+        static bool greater_( const entry& lhs, const entry& rhs ) { return lhs.count > rhs.count; }
+};
+
+template < typename T >
+inline space_saving< T >::space_saving( std::size_t k )
+    : k_( k )
+{
+    if( k_ == 0 ) { COMMA_THROW( comma::exception, "expected positive number of counters" ); }
+    entries_.reserve( k_ );
+}
+
+template < typename T >
+inline void space_saving< T >::push( const T& t )
+{
+    std::size_t min = 0;
+    for( std::size_t i = 0; i < entries_.size(); ++i )
+    {
+        if( entries_[i].value == t ) { ++entries_[i].count; return; }
+        if( entries_[i].count < entries_[min].count ) { min = i; }
+    }
+    if( entries_.size() < k_ ) { entries_.push_back( entry( t, 1, 0 ) ); return; }
+    entries_[min] = entry( t, entries_[min].count + 1, entries_[min].count );
+}
+
+template < typename T >
+inline std::vector< typename space_saving< T >::entry > space_saving< T >::top() const
+{
+    std::vector< entry > v = entries_;
+    std::stable_sort( v.begin(), v.end(), greater_ );
+    return v;
+}
+
+} } // namespace comma { namespace math {
+
+#endif // COMMA_MATH_SPACE_SAVING_H_
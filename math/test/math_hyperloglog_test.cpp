@@ -0,0 +1,39 @@
+// This file is part of comma, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include <comma/math/hyperloglog.h>
+
+namespace comma { namespace math {
+
+TEST( hyperloglog, estimate )
+{
+    EXPECT_THROW( hyperloglog( 3 ), comma::exception );
+    EXPECT_THROW( hyperloglog( 19 ), comma::exception );
+    hyperloglog h( 12 );
+    EXPECT_EQ( 0u, h.estimate() );
+    for( int k = 0; k < 3; ++k ) // duplicates do not count
+    {
+        for( comma::uint32 i = 0; i < 100; ++i ) { h.push( hyperloglog::hash( reinterpret_cast< const char* >( &i ), sizeof( i ) ) ); }
+    }
+    EXPECT_NEAR( 100, double( h.estimate() ), 3 );
+    for( comma::uint32 i = 100; i < 100000; ++i ) { h.push( hyperloglog::hash( reinterpret_cast< const char* >( &i ), sizeof( i ) ) ); }
+    EXPECT_NEAR( 100000, double( h.estimate() ), 100000 * 0.05 );
+}
+
+} } // namespace comma { namespace math {
@@ -0,0 +1,81 @@
+// This file is part of comma, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <comma/math/quantile_sketch.h>
+
+namespace comma { namespace math {
+
+TEST( quantile_sketch, exact )
+{
+    quantile_sketch< int > sketch( 0 );
+    EXPECT_THROW( sketch.quantile( 0.5 ), comma::exception );
+    for( int i = 10; i > 0; --i ) { sketch.push( i ); }
+    EXPECT_EQ( 10u, sketch.size() );
+    EXPECT_EQ( 10u, sketch.stored() );
+    EXPECT_EQ( 1, sketch.quantile( 0 ) );
+    EXPECT_EQ( 1, sketch.quantile( 0.1 ) );
+    EXPECT_EQ( 2, sketch.quantile( 0.11 ) );
+    EXPECT_EQ( 5, sketch.quantile( 0.5 ) );
+    EXPECT_EQ( 9, sketch.quantile( 0.9 ) );
+    EXPECT_EQ( 10, sketch.quantile( 0.95 ) );
+    EXPECT_EQ( 10, sketch.quantile( 1 ) );
+    EXPECT_THROW( sketch.quantile( 1.5 ), comma::exception );
+}
+
+TEST( quantile_sketch, approximate )
+{
+    const int size = 1000000;
+    std::vector< int > values( size );
+    for( int i = 0; i < size; ++i ) { values[i] = ( comma::int64( i ) * 7919 ) % size; } // permutation, since 7919 is prime
+    quantile_sketch< int > sketch( 200 );
+    for( int i = 0; i < size; ++i ) { sketch.push( values[i] ); }
+    EXPECT_EQ( comma::uint64( size ), sketch.size() );
+    EXPECT_LT( sketch.stored(), 1000u );
+    EXPECT_EQ( 0, sketch.quantile( 0 ) );
+    EXPECT_EQ( size - 1, sketch.quantile( 1 ) );
+    const double p[] = { 0.01, 0.25, 0.5, 0.75, 0.99 };
+    for( unsigned int i = 0; i < 5; ++i ) { EXPECT_NEAR( p[i] * size, sketch.quantile( p[i] ), 0.02 * size ); }
+}
+
+TEST( quantile_sketch, ranks )
+{
+    quantile_sketch< int > exact( 0 );
+    for( int i = 0; i < 10; ++i ) { exact.push( i ); }
+    std::vector< double > points;
+    points.push_back( -1 );
+    points.push_back( 2.5 );
+    points.push_back( 9 );
+    points.push_back( 20 );
+    std::vector< comma::uint64 > r = exact.ranks( points );
+    ASSERT_EQ( 4u, r.size() );
+    EXPECT_EQ( 0u, r[0] );
+    EXPECT_EQ( 3u, r[1] );
+    EXPECT_EQ( 9u, r[2] );
+    EXPECT_EQ( 10u, r[3] );
+    const int size = 100000;
+    quantile_sketch< int > sketch( 200 );
+    for( int i = 0; i < size; ++i ) { sketch.push( ( comma::int64( i ) * 7919 ) % size ); }
+    std::vector< int > quartiles;
+    for( int i = 1; i < 4; ++i ) { quartiles.push_back( size / 4 * i ); }
+    r = sketch.ranks( quartiles );
+    for( int i = 0; i < 3; ++i ) { EXPECT_NEAR( quartiles[i], double( r[i] ), 0.02 * size ); }
+}
+
+} } // namespace comma { namespace math {
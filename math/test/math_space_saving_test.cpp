@@ -0,0 +1,53 @@
+// This file is part of comma, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// comma is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// comma is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with comma. If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+#include <gtest/gtest.h>
+#include <comma/math/space_saving.h>
+
+namespace comma { namespace math {
+
+TEST( space_saving, top )
+{
+    EXPECT_THROW( space_saving< int >( 0 ), comma::exception );
+    space_saving< std::string > s( 3 );
+    EXPECT_TRUE( s.top().empty() );
+    s.push( "a" );
+    s.push( "b" );
+    s.push( "a" );
+    std::vector< space_saving< std::string >::entry > top = s.top();
+    ASSERT_EQ( 2u, top.size() );
+    EXPECT_EQ( "a", top[0].value );
+    EXPECT_EQ( 2u, top[0].count );
+    EXPECT_EQ( "b", top[1].value );
+    EXPECT_EQ( 1u, top[1].count );
+}
+
+TEST( space_saving, heavy_hitters )
+{
+    space_saving< int > s( 10 );
+    for( int i = 0; i < 10000; ++i ) { s.push( i % 3 == 0 ? 7 : i % 5 == 0 ? 11 : 1000 + i ); } // 7: 1/3, 11: 2/15, the rest are unique
+    std::vector< space_saving< int >::entry > top = s.top();
+    ASSERT_EQ( 10u, top.size() );
+    EXPECT_EQ( 7, top[0].value );
+    EXPECT_EQ( 11, top[1].value );
+    EXPECT_GE( top[0].count, 3334u );
+    EXPECT_LE( top[0].count - top[0].error, 3334u );
+}
+
+} } // namespace comma { namespace math {
@@ -28,6 +28,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/type_traits.hpp>
+#include <comma/base/time.h>
 #include <comma/base/types.h>
 #include <comma/string/string.h>
 #include <comma/visiting/while.h>
@@ -74,6 +75,7 @@ private:
     std::deque< bool > m_empty;
     static void lexical_cast( bool& v, const std::string& s ) { v = s == "" || boost::lexical_cast< bool >( s ); }
     static void lexical_cast( boost::posix_time::ptime& v, const std::string& s ) { v = boost::posix_time::from_iso_string( s ); }
+    static void lexical_cast( comma::time& v, const std::string& s ) { v = comma::time::from_iso_string( s ); }
     static void lexical_cast( boost::posix_time::time_duration& v, const std::string& s )
     {
         std::vector< std::string > t = comma::split( s, '.' );
@@ -127,6 +129,7 @@ inline void from_name_value::apply( const K& name, T& value )
     m_xpath /= xpath::element( name );
     visiting::do_while<    !boost::is_fundamental< T >::value
                         && !boost::is_same< T, boost::posix_time::ptime >::value
+                        && !boost::is_same< T, comma::time >::value
                         && !boost::is_same< T, boost::posix_time::time_duration >::value
                         && !boost::is_same< T, std::string >::value >::visit( name, value, *this );
     m_xpath = m_xpath.head();